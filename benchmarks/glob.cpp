@@ -0,0 +1,146 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <fnmatch.h>
+
+#include <reaver/exception.h>
+#include <reaver/logger.h>
+
+#include "despayre/runtime/glob.h"
+
+namespace
+{
+    // a source tree of `directories` directories, ten deep at most, with a few sources and headers in each
+    void generate_tree(const boost::filesystem::path & root, std::size_t directories)
+    {
+        for (std::size_t i = 0; i < directories; ++i)
+        {
+            auto directory = root;
+            for (auto n = i; n; n /= 10)
+            {
+                directory /= "d" + std::to_string(n % 10);
+            }
+
+            boost::filesystem::create_directories(directory);
+            for (auto file : { "a.cpp", "b.cpp", "c.cpp", "a.h", "b.h" })
+            {
+                std::ofstream{ (directory / file).string() };
+            }
+        }
+    }
+
+    // what glob used to do: a serial walk, matching every path against the whole pattern
+    std::size_t serial_glob(const std::string & pattern)
+    {
+        std::vector<boost::filesystem::path> ret;
+        for (boost::filesystem::recursive_directory_iterator it{ "." }, end; it != end; ++it)
+        {
+            auto path = it->path().string().substr(2);
+            if (boost::filesystem::is_regular_file(it->status()) && fnmatch(pattern.c_str(), path.c_str(), 0) == 0)
+            {
+                ret.push_back(it->path());
+            }
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret.size();
+    }
+
+    template<typename F>
+    std::chrono::duration<double> best_of_three(F && f)
+    {
+        std::chrono::duration<double> best = std::chrono::duration<double>::max();
+        for (auto run = 0; run < 3; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+        }
+        return best;
+    }
+}
+
+// usage: despayre-bench-glob [thousands of directories]
+// the caches are warm after the first run; drop them between runs (as root) to see cold cache numbers
+int main(int argc, char ** argv) try
+{
+    using namespace reaver::despayre;
+
+    std::size_t directories = (argc > 1 ? std::stoull(argv[1]) : 10) * 1000;
+    const std::string pattern = "**/*.cpp";
+
+    auto previous = boost::filesystem::current_path();
+    auto root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    generate_tree(root, directories);
+    boost::filesystem::current_path(root);
+
+    std::size_t matches = 0;
+    auto serial = best_of_three([&]{ matches = serial_glob(pattern); });
+    reaver::logger::dlog() << "glob: " << matches << " matches in " << directories << " directories, serial walk: " << static_cast<std::size_t>(serial.count() * 1000) << " ms.";
+
+    for (std::size_t threads = 1; threads <= std::max(std::thread::hardware_concurrency(), 1u); threads *= 2)
+    {
+        auto parallel = best_of_three([&]{ matches = match_glob(pattern, threads).matches.size(); });
+        reaver::logger::dlog() << "glob: " << matches << " matches in " << directories << " directories, " << threads << " threads: " << static_cast<std::size_t>(parallel.count() * 1000) << " ms.";
+    }
+
+    // the removal of a subtree, walked separately and removed from the matches, or left out of the walk
+    std::vector<std::string> excluded;
+    for (auto i = 1; i < 10; i += 2)
+    {
+        excluded.push_back("d" + std::to_string(i) + "/**/*.cpp");
+    }
+
+    auto separate = best_of_three([&]{
+        auto all = match_glob(pattern).matches;
+        for (auto && pattern : excluded)
+        {
+            auto removed = match_glob(pattern).matches;
+            std::vector<boost::filesystem::path> result;
+            std::set_difference(all.begin(), all.end(), removed.begin(), removed.end(), std::back_inserter(result));
+            all = std::move(result);
+        }
+        matches = all.size();
+    });
+    reaver::logger::dlog() << "glob: " << matches << " matches left after removing half of the tree, walked separately: " << static_cast<std::size_t>(separate.count() * 1000) << " ms.";
+
+    auto pushed_down = best_of_three([&]{ matches = match_glob(glob_query{ pattern, excluded }).matches.size(); });
+    reaver::logger::dlog() << "glob: " << matches << " matches left after removing half of the tree, left out of the walk: " << static_cast<std::size_t>(pushed_down.count() * 1000) << " ms.";
+
+    boost::filesystem::current_path(previous);
+    boost::filesystem::remove_all(root);
+}
+catch (reaver::exception & ex)
+{
+    ex.print(reaver::logger::default_logger());
+    return 2;
+}
+catch (std::exception & ex)
+{
+    reaver::logger::dlog(reaver::logger::fatal) << ex.what();
+    return 1;
+}
@@ -0,0 +1,132 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include <reaver/logger.h>
+
+#include "despayre/parser/lexer.h"
+
+namespace
+{
+    // looks like a generated buildfile: lots of short assignments, globs, comments and indented argument lists
+    std::string generate_buildfile(std::size_t size)
+    {
+        std::string ret;
+        ret.reserve(size + 256);
+
+        for (std::size_t i = 0; ret.size() < size; ++i)
+        {
+            auto module = "module_" + std::to_string(i);
+
+            ret += "// sources of " + module + ", generated\n";
+            ret += module + ".sources = glob(\"src/" + module + "/**/*.cpp\") - files(\"src/" + module + "/disabled.cpp\")\n";
+            ret += module + ".flags = \"-Wall -Wextra -I./include/" + module + " -DMODULE_NAME=\\\"" + module + "\\\"\"\n";
+            ret += module + ".library = shared_library(\n        \"" + module + "\",\n        " + module + ".sources\n    )\n\n";
+        }
+
+        return ret;
+    }
+
+    // a buildfile that is mostly documentation, where the lexer spends its time skipping comments
+    std::string generate_commented_buildfile(std::size_t size)
+    {
+        std::string ret;
+        ret.reserve(size + 512);
+
+        for (std::size_t i = 0; ret.size() < size; ++i)
+        {
+            auto module = "module_" + std::to_string(i);
+
+            ret += "/*\n * " + module + " bundles the sources found under src/" + module + ", except for the disabled ones.\n";
+            ret += " * its flags are kept in one place, so that every target built from it agrees on them.\n */\n";
+            ret += "// the library is shared, as most of the tools link against it\n";
+            ret += "// see the documentation of shared_library() for what it does with the sources\n";
+            ret += module + ".library = shared_library(\"" + module + "\", glob(\"src/" + module + "/*.cpp\"))\n\n";
+        }
+
+        return ret;
+    }
+
+    const char * name(reaver::despayre::scan_implementation implementation)
+    {
+        switch (implementation)
+        {
+            case reaver::despayre::scan_implementation::scalar:
+                return "scalar";
+            case reaver::despayre::scan_implementation::sse2:
+                return "sse2";
+            case reaver::despayre::scan_implementation::avx2:
+                return "avx2";
+        }
+
+        return "unknown";
+    }
+}
+
+// usage: despayre-bench-lexer [megabytes]
+int main(int argc, char ** argv) try
+{
+    using namespace reaver::despayre;
+
+    std::size_t megabytes = argc > 1 ? std::stoull(argv[1]) : 64;
+
+    for (auto commented : { false, true })
+    {
+        auto buildfile = commented ? generate_commented_buildfile(megabytes << 20) : generate_buildfile(megabytes << 20);
+
+        for (auto implementation : { scan_implementation::scalar, scan_implementation::sse2, scan_implementation::avx2 })
+        {
+            auto scan = get_scanner(implementation);
+            if (!scan)
+            {
+                continue;
+            }
+
+            // the best of a few runs, to keep page faults of the first one out of the picture
+            std::chrono::duration<double> best = std::chrono::duration<double>::max();
+            std::size_t token_count = 0;
+            for (auto run = 0; run < 5; ++run)
+            {
+                auto start = std::chrono::steady_clock::now();
+                token_count = tokenize(buildfile, *scan).size();
+                best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+            }
+
+            reaver::logger::dlog() << "lexer (" << name(implementation) << (commented ? ", comments" : "") << "): "
+                << static_cast<std::size_t>(buildfile.size() / best.count() / (1 << 20))
+                << " MB/s, " << token_count << " tokens in " << static_cast<std::size_t>(best.count() * 1000) << " ms.";
+        }
+    }
+}
+catch (reaver::exception & ex)
+{
+    ex.print(reaver::logger::default_logger());
+    return 2;
+}
+catch (std::exception & ex)
+{
+    reaver::logger::dlog(reaver::logger::fatal) << ex.what();
+    return 1;
+}
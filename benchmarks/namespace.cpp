@@ -0,0 +1,171 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include <reaver/logger.h>
+
+#include "despayre/parser/parser.h"
+#include "despayre/semantics/symbol_map.h"
+
+namespace
+{
+    using value = std::shared_ptr<int>;
+
+    // the tables namespaces used before: keyed by the name itself, and then by its symbol
+    struct string_table
+    {
+        void add(const std::u32string & name, value val)
+        {
+            map.emplace(name, std::move(val));
+        }
+
+        const value * find(const std::u32string & name, reaver::despayre::symbol) const
+        {
+            auto it = map.find(name);
+            return it == map.end() ? nullptr : &it->second;
+        }
+
+        std::unordered_map<std::u32string, value> map;
+    };
+
+    struct hashed_symbol_table
+    {
+        void add(const std::u32string & name, value val)
+        {
+            map.emplace(reaver::despayre::intern(name), std::move(val));
+        }
+
+        const value * find(const std::u32string &, reaver::despayre::symbol name) const
+        {
+            auto it = map.find(name);
+            return it == map.end() ? nullptr : &it->second;
+        }
+
+        std::unordered_map<reaver::despayre::symbol, value> map;
+    };
+
+    struct flat_symbol_table
+    {
+        void add(const std::u32string & name, value val)
+        {
+            map.emplace(reaver::despayre::intern(name), std::move(val));
+        }
+
+        const value * find(const std::u32string &, reaver::despayre::symbol name) const
+        {
+            return map.find(name);
+        }
+
+        reaver::despayre::symbol_map<value> map;
+    };
+
+    // member names like the ones in buildfiles; the same names are used by every table, so they share symbols
+    std::vector<std::u32string> member_names(std::size_t count)
+    {
+        const char32_t * stems[] = { U"flags", U"ldflags", U"sources", U"version", U"library", U"gcc", U"clang", U"headers" };
+
+        std::vector<std::u32string> ret;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::u32string name = stems[i % 8];
+            if (i >= 8)
+            {
+                name += U"_" + reaver::despayre::utf32(std::to_string(i / 8));
+            }
+            ret.push_back(std::move(name));
+        }
+        return ret;
+    }
+
+    // nanoseconds per lookup of a member, looking the members up in a shuffled order
+    template<typename Table>
+    double measure(const std::vector<std::u32string> & names, std::size_t lookups)
+    {
+        Table table;
+        for (std::size_t i = 0; i < names.size(); ++i)
+        {
+            table.add(names[i], std::make_shared<int>(i));
+        }
+
+        std::vector<std::pair<std::u32string, reaver::despayre::symbol>> order;
+        for (auto && name : names)
+        {
+            order.emplace_back(name, reaver::despayre::intern(name));
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937{ 42 });
+
+        std::chrono::duration<double> best = std::chrono::duration<double>::max();
+        for (auto run = 0; run < 5; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::size_t next = 0;
+            for (std::size_t i = 0; i < lookups; ++i)
+            {
+                auto & name = order[next];
+                auto found = table.find(name.first, name.second);
+                // keeps the compiler from hoisting the lookups out of the loop
+                asm volatile("" : : "r"(found) : "memory");
+
+                if (++next == order.size())
+                {
+                    next = 0;
+                }
+            }
+            best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+        }
+
+        return best.count() * 1e9 / lookups;
+    }
+}
+
+// usage: despayre-bench-namespace [millions of lookups]
+int main(int argc, char ** argv) try
+{
+    std::size_t lookups = (argc > 1 ? std::stoull(argv[1]) : 10) * 1000000;
+
+    // a plugin's options, a nested namespace of a module, a big module, and the top level of a generated buildfile
+    for (auto size : { 4, 8, 32, 2000 })
+    {
+        auto names = member_names(size);
+
+        reaver::logger::dlog() << "namespace of " << size << " members: "
+            << "u32string hash " << measure<string_table>(names, lookups) << " ns, "
+            << "symbol hash " << measure<hashed_symbol_table>(names, lookups) << " ns, "
+            << "symbol_map " << measure<flat_symbol_table>(names, lookups) << " ns per lookup.";
+    }
+}
+catch (reaver::exception & ex)
+{
+    ex.print(reaver::logger::default_logger());
+    return 2;
+}
+catch (std::exception & ex)
+{
+    reaver::logger::dlog(reaver::logger::fatal) << ex.what();
+    return 1;
+}
@@ -0,0 +1,97 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include <reaver/logger.h>
+
+#include "despayre/semantics/semantics.h"
+
+namespace
+{
+    // five variables per module, referring to things defined later, like generated buildfiles tend to
+    // the aliases form a single chain of references through all the modules, and every executable takes one of its links
+    std::string generate_buildfile(std::size_t modules)
+    {
+        std::string ret;
+
+        for (std::size_t i = 0; i < modules; ++i)
+        {
+            auto module = "module_" + std::to_string(i);
+            auto next = "module_" + std::to_string(i + 1);
+
+            ret += module + ".name = \"" + module + "\"\n";
+            ret += module + ".flags = common.flags + \" -DMODULE_" + std::to_string(i) + "\"\n";
+            ret += module + ".sources = files(\"src/" + module + ".cpp\", \"src/" + module + "_impl.cpp\")\n";
+            ret += module + ".alias = " + next + ".alias\n";
+            ret += module + ".binary = executable(" + module + ".name, " + module + ".alias)\n";
+        }
+
+        ret += "module_" + std::to_string(modules) + ".alias = files(\"src/main.cpp\")\n";
+        ret += "common.flags = \"-O2\"\n";
+
+        return ret;
+    }
+}
+
+// usage: despayre-bench-semantics [thousands of modules]
+int main(int argc, char ** argv) try
+{
+    using namespace reaver::despayre;
+
+    std::size_t modules = (argc > 1 ? std::stoull(argv[1]) : 20) * 1000;
+    auto buildfile = generate_buildfile(modules);
+
+    std::chrono::duration<double> best = std::chrono::duration<double>::max();
+    for (auto run = 0; run < 3; ++run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto ctx = analyze(token_stream{ buildfile });
+        best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+    }
+
+    reaver::logger::dlog() << "semantics: " << modules * 5 << " variables analyzed in " << static_cast<std::size_t>(best.count() * 1000) << " ms.";
+
+    // only what the first binary needs: its own variables, and the chain of aliases
+    best = std::chrono::duration<double>::max();
+    for (auto run = 0; run < 3; ++run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto ctx = analyze(token_stream{ buildfile }, evaluation::lazy);
+        force(ctx, ctx.variables->get_property(U"module_0")->get_property(U"binary"));
+        best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+    }
+
+    reaver::logger::dlog() << "semantics: " << modules * 5 << " variables analyzed lazily, and one target forced, in " << static_cast<std::size_t>(best.count() * 1000) << " ms.";
+}
+catch (reaver::exception & ex)
+{
+    ex.print(reaver::logger::default_logger());
+    return 2;
+}
+catch (std::exception & ex)
+{
+    reaver::logger::dlog(reaver::logger::fatal) << ex.what();
+    return 1;
+}
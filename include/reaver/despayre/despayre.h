@@ -24,6 +24,8 @@
 
 #include <string>
 #include <fstream>
+#include <mutex>
+#include <condition_variable>
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
@@ -31,47 +33,142 @@
 #include <reaver/optional.h>
 
 #include "parser/parser.h"
+#include "parser/source.h"
 #include "semantics/semantics.h"
 #include "semantics/target.h"
+#include "semantics/snapshot.h"
+#include "runtime/glob.h"
+#include "runtime/hash.h"
 
 namespace reaver
 {
     namespace despayre { inline namespace _v1
     {
+        // blocks until the future is ready; rethrows the exception if the future failed
+        inline void wait(future<> build_future)
+        {
+            std::mutex lock;
+            std::condition_variable condition;
+            bool done = false;
+            std::exception_ptr error;
+
+            auto signal = [&](std::exception_ptr ex) {
+                std::lock_guard<std::mutex> guard{ lock };
+                error = ex;
+                done = true;
+                condition.notify_all();
+            };
+
+            build_future.then([&]{ signal(nullptr); });
+            build_future.on_error([&](std::exception_ptr ex) { signal(ex); });
+
+            std::unique_lock<std::mutex> guard{ lock };
+            condition.wait(guard, [&]{ return done; });
+
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
         class despayre
         {
         public:
-            despayre(boost::filesystem::path buildfile_path, boost::filesystem::path cwd = boost::filesystem::current_path()) : despayre{ _load_file(buildfile_path), std::move(buildfile_path), std::move(cwd) }
+            despayre(boost::filesystem::path buildfile_path, boost::filesystem::path cwd = boost::filesystem::current_path(), evaluation mode = evaluation::eager, std::vector<boost::filesystem::path> output_directories = {})
+                : despayre{ source_buffer::map_file(buildfile_path), std::move(buildfile_path), std::move(cwd), mode, std::move(output_directories) }
             {
             }
 
-            despayre(std::u32string buildfile_contents, boost::filesystem::path buildfile_path, boost::filesystem::path cwd = boost::filesystem::current_path()) : _buildfile_path{ std::move(buildfile_path) }, _working_directory{ std::move(cwd) }, _buildfile{ std::move(buildfile_contents) }
+            // with lazy evaluation, only the parts of the buildfile the targets that are built need are ever analyzed
+            // the globs skip the output directories, and whatever .despayreignore in the working directory lists
+            despayre(source_buffer buildfile, boost::filesystem::path buildfile_path, boost::filesystem::path cwd = boost::filesystem::current_path(), evaluation mode = evaluation::eager, std::vector<boost::filesystem::path> output_directories = {})
+                : _buildfile_path{ std::move(buildfile_path) }, _working_directory{ std::move(cwd) }, _buildfile{ std::move(buildfile) }
             {
-                _parse_tree = parse(tokenize(_buildfile, _buildfile_path));
-                _semantic_context = analyze(_parse_tree);
+                _semantic_context = analyze(token_stream{ _buildfile.contents(), _buildfile_path.string() }, mode, _glob_options(_working_directory, output_directories));
+            }
+
+            // reuses the graph stored in the snapshot when it's still valid for the buildfile; otherwise analyzes it and stores the result
+            // a lazily analyzed graph is never stored, since most of it is still thunks, but a stored one is still reused
+            static despayre load(boost::filesystem::path buildfile_path, const boost::filesystem::path & snapshot_path, boost::filesystem::path cwd = boost::filesystem::current_path(), evaluation mode = evaluation::eager)
+            {
+                auto buildfile = source_buffer::map_file(buildfile_path);
+                // the ignored directories decide what the globs match just as much as the buildfile does
+                auto ignore_file = cwd / ".despayreignore";
+                auto buildfile_hash = hash_bytes(buildfile.contents().data(), buildfile.contents().size(), boost::filesystem::exists(ignore_file) ? hash_file(ignore_file) : 0);
+
+                std::vector<boost::filesystem::path> output_directories;
+                if (!snapshot_path.parent_path().empty())
+                {
+                    output_directories.push_back(snapshot_path.parent_path());
+                }
+
+                if (auto snapshot = load_snapshot(snapshot_path, buildfile_hash, _glob_options(cwd, output_directories)))
+                {
+                    return { std::move(buildfile_path), std::move(cwd), std::move(*snapshot) };
+                }
+
+                if (mode == evaluation::lazy)
+                {
+                    return { std::move(buildfile), std::move(buildfile_path), std::move(cwd), mode, std::move(output_directories) };
+                }
+
+                // created before analysis, so that the globs see the directory as it'll stay
+                boost::system::error_code error;
+                boost::filesystem::create_directories(snapshot_path.parent_path(), error);
+
+                despayre ret{ std::move(buildfile), std::move(buildfile_path), std::move(cwd), evaluation::eager, std::move(output_directories) };
+                if (!save_snapshot(ret._semantic_context, snapshot_path, buildfile_hash))
+                {
+                    boost::filesystem::remove(snapshot_path, error);
+                }
+                return ret;
             }
 
-            // TODO: this also should return a future
-            // not block like a dumb temporary implementation that it is
-            void build(std::string target_name, std::string output_dir)
+            // the returned future is ready once the target and all its dependencies are built
+            // every pending job holds on to the runtime context, so the future is answered even when nothing else refers to the context anymore
+            // (like the one made here, once a later build replaces it as the last context)
+            future<> build(std::string target_name, std::string output_dir, runtime_options options = {})
             {
-                std::u32string converted = boost::locale::conv::utf_to_utf<char32_t>(target_name);
+                return build(std::move(target_name), make_context(std::move(output_dir), std::move(options)));
+            }
 
+            // contexts can be reused for later builds, which keeps their caches (like the build log) warm
+            context_ptr make_context(std::string output_dir, runtime_options options = {}) const
+            {
+                auto ctx = make_runtime_context(boost::filesystem::current_path() / output_dir, std::move(options));
+                for (const auto & init : _semantic_context.plugin_initializers)
+                {
+                    init.initializer(ctx, init.context);
+                }
+
+                return ctx;
+            }
+
+            // throws when there's no such target; forces whatever the target needs when the buildfile was analyzed lazily
+            std::shared_ptr<target> find_target(const std::string & target_name)
+            {
                 std::shared_ptr<target> target;
-                if (_semantic_context.targets.find(converted) != _semantic_context.targets.end())
+                auto it = _semantic_context.targets.find(intern(target_name));
+                if (it != _semantic_context.targets.end())
                 {
-                    target = _semantic_context.targets.at(converted);
+                    target = it->second;
                 }
                 else
                 {
-                    std::vector<std::u32string> identifiers;
+                    std::vector<std::string> identifiers;
                     // need a better split
-                    boost::algorithm::split(identifiers, converted, boost::is_any_of(U"."));
+                    boost::algorithm::split(identifiers, target_name, boost::is_any_of("."));
 
                     auto variable = _semantic_context.variables;
                     for (auto i = 0ull; i < identifiers.size() && variable; ++i)
                     {
-                        variable = variable->get_property(identifiers[i]);
+                        force(_semantic_context, variable);
+                        variable = variable->get_property(intern(identifiers[i]));
+                    }
+
+                    if (variable)
+                    {
+                        force(_semantic_context, variable);
                     }
 
                     if (variable && variable->type()->is_target_type)
@@ -86,11 +183,15 @@ namespace reaver
                     throw exception{ logger::fatal } << "could not find the requested target `" << target_name << "`.";
                 }
 
-                auto ctx = make_runtime_context(boost::filesystem::current_path() / output_dir);
-                for (const auto & init : _semantic_context.plugin_initializers)
-                {
-                    init.initializer(ctx, init.context);
-                }
+                return target;
+            }
+
+            future<> build(std::string target_name, context_ptr ctx)
+            {
+                auto target = find_target(target_name);
+
+                ctx->start_build();
+                _last_context = ctx;
 
                 // count all the target to be built
                 // do it twice so lazy targets can get it right
@@ -116,14 +217,19 @@ namespace reaver
 
                 visit(target);
 
-                if (!target->built(ctx))
-                {
-                    auto future = target->build(ctx);
-                    while (!future.try_get())
-                    {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    }
-                }
+                return target->build(ctx);
+            }
+
+            // the directories the globs looked at so far, with their modification times back then
+            const std::map<boost::filesystem::path, std::int64_t> & globbed_directories() const
+            {
+                return *_semantic_context.globbed_directories;
+            }
+
+            // the runtime context of the most recent call to build; mostly useful for its statistics
+            const context_ptr & last_context() const
+            {
+                return _last_context;
             }
 
         private:
@@ -131,18 +237,24 @@ namespace reaver
             boost::filesystem::path _working_directory;
             boost::filesystem::path _output_directory = boost::filesystem::current_path() / "build-output";
 
-            std::u32string _buildfile;
-            std::vector<assignment> _parse_tree;
+            source_buffer _buildfile;
 
             semantic_context _semantic_context;
+            context_ptr _last_context;
 
-            static std::u32string _load_file(const boost::filesystem::path & buildfile_path)
+            static glob_options _glob_options(const boost::filesystem::path & cwd, const std::vector<boost::filesystem::path> & output_directories)
             {
-                std::ifstream input{ buildfile_path.string() };
-                std::string buffer_utf8{ std::istreambuf_iterator<char>{ input.rdbuf() }, std::istreambuf_iterator<char>{} };
-                std::u32string input_content = boost::locale::conv::utf_to_utf<char32_t>(buffer_utf8);
+                glob_options options;
+                options.ignored = read_ignore_file(cwd / ".despayreignore");
+                for (auto && output : output_directories)
+                {
+                    options.output_directories.push_back(boost::filesystem::absolute(output, cwd));
+                }
+                return options;
+            }
 
-                return input_content;
+            despayre(boost::filesystem::path buildfile_path, boost::filesystem::path cwd, semantic_context ctx) : _buildfile_path{ std::move(buildfile_path) }, _working_directory{ std::move(cwd) }, _semantic_context{ std::move(ctx) }
+            {
             }
         };
     }}
@@ -0,0 +1,163 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // a view of a contiguous array; used for lists of children of nodes living in an arena
+        template<typename T>
+        class span
+        {
+        public:
+            span() = default;
+
+            span(T * data, std::size_t size) : _data{ data }, _size{ size }
+            {
+            }
+
+            T * begin() const
+            {
+                return _data;
+            }
+
+            T * end() const
+            {
+                return _data + _size;
+            }
+
+            std::size_t size() const
+            {
+                return _size;
+            }
+
+            bool empty() const
+            {
+                return _size == 0;
+            }
+
+            T & operator[](std::size_t index) const
+            {
+                return _data[index];
+            }
+
+            T & front() const
+            {
+                return _data[0];
+            }
+
+            T & back() const
+            {
+                return _data[_size - 1];
+            }
+
+        private:
+            T * _data = nullptr;
+            std::size_t _size = 0;
+        };
+
+        // a bump pointer allocator; everything allocated from it is freed at once, by reset() or the destructor
+        // destructors of the objects are never run, so it's only meant for objects that own nothing outside of the arena
+        class arena
+        {
+        public:
+            arena() = default;
+            arena(const arena &) = delete;
+            arena & operator=(const arena &) = delete;
+            arena(arena && other) noexcept : _blocks{ std::move(other._blocks) }, _current{ std::exchange(other._current, nullptr) }, _end{ std::exchange(other._end, nullptr) }
+            {
+            }
+
+            arena & operator=(arena && other) noexcept
+            {
+                _blocks = std::move(other._blocks);
+                _current = std::exchange(other._current, nullptr);
+                _end = std::exchange(other._end, nullptr);
+                return *this;
+            }
+
+            void * allocate(std::size_t size, std::size_t alignment)
+            {
+                auto current = reinterpret_cast<std::uintptr_t>(_current);
+                auto aligned = (current + alignment - 1) & ~(alignment - 1);
+
+                if (!_current || aligned + size > reinterpret_cast<std::uintptr_t>(_end))
+                {
+                    return _allocate_block(size, alignment);
+                }
+
+                _current = reinterpret_cast<char *>(aligned + size);
+                return reinterpret_cast<void *>(aligned);
+            }
+
+            template<typename T, typename... Args>
+            T * make(Args &&... args)
+            {
+                return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            }
+
+            template<typename T, typename Iterator>
+            span<T> copy(Iterator begin, Iterator end)
+            {
+                auto size = static_cast<std::size_t>(std::distance(begin, end));
+                if (size == 0)
+                {
+                    return {};
+                }
+
+                auto data = static_cast<std::remove_const_t<T> *>(allocate(sizeof(T) * size, alignof(T)));
+                std::uninitialized_copy(begin, end, data);
+                return { data, size };
+            }
+
+            // frees everything allocated so far, but keeps the largest block for the allocations to come
+            void reset();
+
+            // the number of bytes of blocks currently held
+            std::size_t capacity() const;
+
+        private:
+            struct _block
+            {
+                std::unique_ptr<char[]> data;
+                std::size_t size;
+            };
+
+            std::vector<_block> _blocks;
+            char * _current = nullptr;
+            char * _end = nullptr;
+
+            void * _allocate_block(std::size_t size, std::size_t alignment);
+        };
+    }}
+}
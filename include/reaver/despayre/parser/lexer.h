@@ -22,26 +22,28 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <array>
-#include <unordered_map>
 #include <vector>
 #include <experimental/string_view>
 
-#include <boost/filesystem.hpp>
-
 #include <reaver/exception.h>
+#include <reaver/optional.h>
+
+#include "scan.h"
+#include "symbol.h"
 
 namespace reaver
 {
     namespace despayre { inline namespace _v1
     {
+        // offsets are in bytes of the UTF-8 buildfile, columns in code points
         struct position
         {
-            std::size_t offset = 0;
-            std::size_t line = 1;
-            std::size_t column = 1;
-            std::string file;
+            std::uint32_t offset = 0;
+            std::uint32_t line = 1;
+            std::uint32_t column = 1;
 
             std::size_t operator-(const position & rhs) const
             {
@@ -99,6 +101,23 @@ namespace reaver
             return os << r.start().line << ":" << r.start().column << " (" << r.start().offset << ")";
         }
 
+        // a range in a buildfile, as diagnostics print it; positions don't carry the name of their file, so it's kept once, by whoever reports them
+        struct file_range
+        {
+            const std::string & file;
+            const range_type & range;
+        };
+
+        inline std::ostream & operator<<(std::ostream & os, const file_range & r)
+        {
+            if (!r.file.empty())
+            {
+                os << r.file << ":";
+            }
+
+            return os << r.range;
+        }
+
         enum class token_type
         {
             identifier,
@@ -120,41 +139,107 @@ namespace reaver
         }
 
         extern std::array<std::string, +token_type::count> token_types;
-        extern const std::unordered_map<char32_t, token_type> symbols1;
-        extern const std::unordered_map<char32_t, std::unordered_map<char32_t, token_type>> symbols2;
 
+        // indexed by byte; token_type::count for bytes that don't start a single character symbol
+        struct symbol_table
+        {
+            token_type types[256];
+
+            constexpr token_type operator[](unsigned char c) const
+            {
+                return types[c];
+            }
+        };
+
+        constexpr symbol_table make_symbol_table()
+        {
+            symbol_table ret{};
+            for (auto & type : ret.types)
+            {
+                type = token_type::count;
+            }
+
+            ret.types[static_cast<unsigned char>('.')] = token_type::dot;
+            ret.types[static_cast<unsigned char>(',')] = token_type::comma;
+            ret.types[static_cast<unsigned char>('+')] = token_type::plus;
+            ret.types[static_cast<unsigned char>('-')] = token_type::minus;
+            ret.types[static_cast<unsigned char>('=')] = token_type::equals;
+            ret.types[static_cast<unsigned char>('(')] = token_type::open_paren;
+            ret.types[static_cast<unsigned char>(')')] = token_type::close_paren;
+
+            return ret;
+        }
+
+        constexpr symbol_table symbols = make_symbol_table();
+
+        // the string is a view into the buildfile, which has to outlive the token
+        // for string literals, it's the contents between the quotes, with escape sequences left as they were
+        // identifiers are interned as they are lexed; the name of any other token is the empty symbol
         struct token
         {
-            token(token_type type, std::u32string string, range_type range) : type{ type }, string{ std::move(string) }, range{ std::move(range) }
+            token(token_type type, std::experimental::string_view string, range_type range)
+                : type{ type }, name{ type == token_type::identifier ? intern(string) : symbol{} }, string{ string }, range{ std::move(range) }
             {
             }
 
             token_type type;
-            std::u32string string;
+            symbol name;
+            std::experimental::string_view string;
             range_type range;
         };
 
-        std::vector<token> tokenize(const std::experimental::u32string_view buildfile, const boost::filesystem::path & filename);
+        // lexes the buildfile lazily, one token per call to next(); none marks the end of the buildfile
+        // throws for buildfiles of 4 GiB or more, as those don't fit in a position
+        class token_stream
+        {
+        public:
+            token_stream(std::experimental::string_view buildfile, const scanner & scan = default_scanner()) : token_stream{ buildfile, {}, scan }
+            {
+            }
+
+            // the file name is only used in diagnostics
+            token_stream(std::experimental::string_view buildfile, std::string file, const scanner & scan = default_scanner());
+
+            reaver::optional<token> next();
+
+            const std::string & file() const
+            {
+                return _file;
+            }
+
+        private:
+            void _move_to(std::size_t offset);
+
+            std::experimental::string_view _buildfile;
+            std::string _file;
+            scanner _scan;
+            // the position of the next byte to look at
+            position _position;
+        };
+
+        std::vector<token> tokenize(std::experimental::string_view buildfile, const scanner & scan = default_scanner());
 
         class unterminated_comment : public reaver::exception
         {
         public:
-            unterminated_comment(range_type r) : exception{ logger::error }, range{ std::move(r) }
+            unterminated_comment(std::string f, range_type r) : exception{ logger::error }, file{ std::move(f) }, range{ std::move(r) }
             {
-                *this << "unterminated comment at " << range;
+                *this << "unterminated comment at " << file_range{ file, range };
             }
 
+            std::string file;
             range_type range;
         };
 
         class unterminated_string : public reaver::exception
         {
         public:
-            unterminated_string(range_type r) : exception{ logger::error }, range{ std::move(r) }
+            unterminated_string(std::string f, range_type r) : exception{ logger::error }, file{ std::move(f) }, range{ std::move(r) }
             {
-                *this << "unterminated string at " << range;
+                *this << "unterminated string at " << file_range{ file, range };
             }
 
+            std::string file;
             range_type range;
         };
     }}
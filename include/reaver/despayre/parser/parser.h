@@ -23,6 +23,7 @@
 #pragma once
 
 #include <vector>
+#include <functional>
 
 #include <boost/locale.hpp>
 
@@ -30,132 +31,75 @@
 #include <reaver/optional.h>
 
 #include "lexer.h"
+#include "arena.h"
 
 namespace reaver
 {
     namespace despayre { inline namespace _v1
     {
-        struct context
-        {
-            std::vector<token>::iterator begin;
-            std::vector<token>::iterator end;
-        };
-
         inline std::string utf8(std::experimental::u32string_view other)
         {
             return boost::locale::conv::utf_to_utf<char>(std::begin(other), std::end(other));
         }
 
+        inline std::u32string utf32(std::experimental::string_view other)
+        {
+            return boost::locale::conv::utf_to_utf<char32_t>(other.data(), other.data() + other.size());
+        }
+
         class expectation_failure : public exception
         {
         public:
-            expectation_failure(token_type expected, std::experimental::u32string_view actual, range_type & r) : exception{ logger::fatal }
+            expectation_failure(const std::string & file, token_type expected, std::experimental::string_view actual, range_type & r) : exception{ logger::fatal }
             {
-                *this << r << ": expected `" << token_types[+expected] << "`, got `" << utf8(actual) << "`";
+                *this << file_range{ file, r } << ": expected `" << token_types[+expected] << "`, got `" << actual.to_string() << "`";
             }
 
-            expectation_failure(std::experimental::string_view str, std::experimental::u32string_view actual, range_type & r) : exception{ logger::fatal }
+            expectation_failure(const std::string & file, std::experimental::string_view str, std::experimental::string_view actual, range_type & r) : exception{ logger::fatal }
             {
-                *this <<  r << ": expected " << str << ", got `" << utf8(actual) << "`";
+                *this << file_range{ file, r } << ": expected " << str << ", got `" << actual.to_string() << "`";
             }
 
-            expectation_failure(token_type expected) : exception{ logger::fatal }
+            expectation_failure(const std::string & file, token_type expected) : exception{ logger::fatal }
             {
-                *this << "expected `" << token_types[+expected] << "`, got end of file";
+                *this << _file_prefix(file) << "expected `" << token_types[+expected] << "`, got end of file";
             }
 
-            expectation_failure(std::experimental::string_view str) : exception{ logger::fatal }
+            expectation_failure(const std::string & file, std::experimental::string_view str) : exception{ logger::fatal }
             {
-                *this << "expected `" << str << "`, got end of file";
+                *this << _file_prefix(file) << "expected `" << str << "`, got end of file";
             }
-        };
 
-        inline token expect(context & ctx, token_type expected)
-        {
-            if (ctx.begin == ctx.end)
+        private:
+            static std::string _file_prefix(const std::string & file)
             {
-                throw expectation_failure{ expected };
+                return file.empty() ? file : file + ": ";
             }
-
-            if (ctx.begin->type != expected)
-            {
-                throw expectation_failure{ expected, ctx.begin->string, ctx.begin->range };
-            }
-
-            return std::move(*ctx.begin++);
-        }
-
-        inline reaver::optional<token &> peek(context & ctx)
-        {
-            if (ctx.begin != ctx.end)
-            {
-                return { *ctx.begin };
-            }
-
-            return reaver::none;
-        }
-
-        inline reaver::optional<token &> peek(context & ctx, token_type expected)
-        {
-            if (ctx.begin != ctx.end && ctx.begin->type == expected)
-            {
-                return { *ctx.begin };
-            }
-
-            return reaver::none;
-        }
+        };
 
         struct string_node
         {
-            range_type range;
-            token value;
-
-            bool operator==(const string_node & other) const
-            {
-                return value.string == other.value.string;
-            }
+            std::uint32_t token;
         };
 
-        string_node parse_string(context & ctx);
-
         struct identifier
         {
-            range_type range;
-            token value;
-
-            bool operator==(const identifier & other) const
-            {
-                return value.string == other.value.string;
-            }
+            std::uint32_t token;
         };
 
-        identifier parse_identifier(context & ctx);
-
         struct id_expression
         {
             range_type range;
-            std::vector<identifier> identifiers;
-
-            bool operator==(const id_expression & other) const
-            {
-                return identifiers == other.identifiers;
-            }
+            span<const identifier> identifiers;
         };
 
-        id_expression parse_id_expression(context & ctx);
-
         struct expression;
 
         struct instantiation
         {
             range_type range;
             id_expression type_name;
-            std::vector<expression> arguments;
-
-            bool operator==(const instantiation & other) const
-            {
-                return type_name == other.type_name && arguments == other.arguments;
-            }
+            span<const expression> arguments;
         };
 
         using simple_expression = variant<
@@ -175,45 +119,153 @@ namespace reaver
             range_type range;
             operation_type operation;
             simple_expression operand;
-
-            bool operator==(const struct operation & other) const
-            {
-                return operation == other.operation && operand == other.operand;
-            }
         };
 
-        std::vector<operation> parse_operations(context & ctx);
-
         struct expression
         {
             range_type range;
             simple_expression base;
-            std::vector<operation> operations;
-
-            bool operator==(const expression & other) const
-            {
-                return base == other.base && operations == other.operations;
-            }
+            span<const operation> operations;
         };
 
-        simple_expression parse_simple_expression(context & ctx);
-        expression parse_expression(context & ctx);
-
         struct assignment
         {
             range_type range;
             id_expression lhs;
             expression rhs;
+        };
+
+        inline const range_type & range_of(const std::vector<token> & tokens, const string_node & node)
+        {
+            return tokens[node.token].range;
+        }
 
-            bool operator==(const assignment & other) const
+        inline const range_type & range_of(const std::vector<token> &, const id_expression & node)
+        {
+            return node.range;
+        }
+
+        inline const range_type & range_of(const std::vector<token> &, const instantiation & node)
+        {
+            return node.range;
+        }
+
+        // the nodes live in an arena owned by the caller of parse; they refer to tokens by their index in `tokens`
+        struct parse_tree
+        {
+            std::vector<token> tokens;
+            span<const assignment> assignments;
+
+            const token & operator[](std::uint32_t index) const
             {
-                return lhs == other.lhs && rhs == other.rhs;
+                return tokens[index];
             }
         };
 
-        assignment parse_assignment(context & ctx);
+        // the file name is only used in diagnostics
+        parse_tree parse(std::vector<token> tokens, arena & nodes, std::string file = {});
+
+        // parses the assignments one by one, as the tokens are lexed, and hands each of them to the consumer
+        // the assignment, and the tokens it refers to, are only valid until the consumer returns; the arena is reset after every assignment
+        void parse(token_stream tokens, arena & nodes, const std::function<void (const std::vector<token> &, const assignment &)> & consumer);
+
+        struct context
+        {
+            context(std::vector<token> tokens, arena & nodes, std::string file, token_stream * stream = nullptr) : tokens{ std::move(tokens) }, nodes{ nodes }, file{ std::move(file) }, stream{ stream }
+            {
+            }
+
+            // when parsing a stream, this only holds the tokens of the current assignment, and the lookahead past it
+            std::vector<token> tokens;
+            std::size_t current = 0;
+            arena & nodes;
+            const std::string file;
+            token_stream * stream;
+
+            // children of lists of unknown length are collected on these, and copied into the arena once the list ends
+            // they're stacks, as lists nest; the scratch space is reused, so parsing only allocates when they grow
+            std::vector<identifier> identifiers;
+            std::vector<expression> expressions;
+            std::vector<operation> operations;
+        };
+
+        // makes sure the token at ctx.current has been lexed; false at the end of input
+        // this can reallocate ctx.tokens, so tokens returned by peek are only valid until the next peek or expect
+        inline bool fill(context & ctx)
+        {
+            if (ctx.current != ctx.tokens.size())
+            {
+                return true;
+            }
+
+            if (!ctx.stream)
+            {
+                return false;
+            }
+
+            auto token = ctx.stream->next();
+            if (!token)
+            {
+                return false;
+            }
+
+            ctx.tokens.push_back(std::move(*token));
+            return true;
+        }
 
-        std::vector<assignment> parse(std::vector<token> tokens);
+        inline std::uint32_t expect(context & ctx, token_type expected)
+        {
+            if (!fill(ctx))
+            {
+                throw expectation_failure{ ctx.file, expected };
+            }
+
+            auto & token = ctx.tokens[ctx.current];
+            if (token.type != expected)
+            {
+                auto range = token.range;
+                throw expectation_failure{ ctx.file, expected, token.string, range };
+            }
+
+            return ctx.current++;
+        }
+
+        inline reaver::optional<const token &> peek(context & ctx)
+        {
+            if (fill(ctx))
+            {
+                return { ctx.tokens[ctx.current] };
+            }
+
+            return reaver::none;
+        }
+
+        inline reaver::optional<const token &> peek(context & ctx, token_type expected)
+        {
+            if (fill(ctx) && ctx.tokens[ctx.current].type == expected)
+            {
+                return { ctx.tokens[ctx.current] };
+            }
+
+            return reaver::none;
+        }
+
+        // copies the elements above `mark` off a scratch stack into the arena
+        template<typename T>
+        span<const T> pop_list(context & ctx, std::vector<T> & stack, std::size_t mark)
+        {
+            auto ret = ctx.nodes.copy<const T>(stack.begin() + mark, stack.end());
+            stack.erase(stack.begin() + mark, stack.end());
+            return ret;
+        }
+
+        string_node parse_string(context & ctx);
+        identifier parse_identifier(context & ctx);
+        id_expression parse_id_expression(context & ctx);
+        span<const operation> parse_operations(context & ctx);
+        simple_expression parse_simple_expression(context & ctx);
+        expression parse_expression(context & ctx);
+        assignment parse_assignment(context & ctx);
     }}
 }
 
@@ -0,0 +1,65 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstddef>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // what moving over a range of a buildfile does to a line and column
+        struct line_advance
+        {
+            std::size_t newlines = 0;
+            // the code points after the last newline, or in the whole range when there's none
+            std::size_t code_points = 0;
+        };
+
+        // the byte scanning primitives behind the lexer's fast paths
+        // the find and skip ones return the offset of the first byte at or after `from` that stops the scan, or `size` when there's none
+        struct scanner
+        {
+            // stops at anything that isn't a space, tab, carriage return or newline
+            std::size_t (*skip_white_space)(const char * data, std::size_t size, std::size_t from);
+            // stops at a quote, a backslash or a newline; those are all the bytes a string literal's body cares about
+            std::size_t (*find_string_special)(const char * data, std::size_t size, std::size_t from);
+            // stops at `c`; for the ends of comments
+            std::size_t (*find_byte)(const char * data, std::size_t size, std::size_t from, char c);
+            // counts over [from, to), which the other primitives have already skipped
+            line_advance (*advance)(const char * data, std::size_t from, std::size_t to);
+        };
+
+        enum class scan_implementation
+        {
+            scalar,
+            sse2,
+            avx2
+        };
+
+        // nullptr when the machine (or the build) doesn't support the implementation
+        const scanner * get_scanner(scan_implementation implementation);
+        // the fastest implementation the machine supports
+        const scanner & default_scanner();
+    }}
+}
@@ -0,0 +1,68 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <experimental/string_view>
+
+#include <boost/filesystem.hpp>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // the UTF-8 contents of a buildfile; tokens are views into it, so it has to outlive them
+        // files are memory mapped rather than read, so lexing works straight off the page cache
+        class source_buffer
+        {
+        public:
+            source_buffer() = default;
+            explicit source_buffer(std::string contents);
+
+            source_buffer(const source_buffer &) = delete;
+            source_buffer & operator=(const source_buffer &) = delete;
+            source_buffer(source_buffer && other) noexcept;
+            source_buffer & operator=(source_buffer && other) noexcept;
+            ~source_buffer();
+
+            // throws when the file can't be read
+            static source_buffer map_file(const boost::filesystem::path & path);
+
+            std::experimental::string_view contents() const
+            {
+                return { _data, _size };
+            }
+
+        private:
+            const char * _data = nullptr;
+            std::size_t _size = 0;
+            bool _mapped = false;
+            // keeps the data of a buffer that isn't backed by a file at a stable address
+            std::unique_ptr<std::string> _owned;
+
+            void _release();
+        };
+    }}
+}
@@ -0,0 +1,91 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <experimental/string_view>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        class symbol;
+
+        symbol intern(std::experimental::string_view name);
+        symbol intern(std::experimental::u32string_view name);
+
+        // an interned name; equal names always get the same symbol, so comparing and hashing them is comparing and hashing integers
+        // the table is global and never shrinks, so only names (of variables, properties, targets) should be interned, not arbitrary strings
+        // a default constructed symbol is the empty name
+        class symbol
+        {
+        public:
+            symbol() = default;
+
+            std::uint32_t id() const
+            {
+                return _id;
+            }
+
+            // the UTF-8 spelling; stays valid for the lifetime of the process
+            std::experimental::string_view string() const;
+
+            bool operator==(const symbol & other) const
+            {
+                return _id == other._id;
+            }
+
+            bool operator!=(const symbol & other) const
+            {
+                return _id != other._id;
+            }
+
+            bool operator<(const symbol & other) const
+            {
+                return _id < other._id;
+            }
+
+        private:
+            friend symbol intern(std::experimental::string_view name);
+
+            explicit symbol(std::uint32_t id) : _id{ id }
+            {
+            }
+
+            std::uint32_t _id = 0;
+        };
+    }}
+}
+
+namespace std
+{
+    template<>
+    struct hash<reaver::despayre::_v1::symbol>
+    {
+        std::size_t operator()(const reaver::despayre::_v1::symbol & sym) const
+        {
+            return sym.id();
+        }
+    };
+}
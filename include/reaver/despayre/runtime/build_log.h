@@ -0,0 +1,99 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <reaver/optional.h>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // persistent, append-only database of what was built, kept in the output directory
+        // the file is mapped and indexed once when the log is opened; afterwards every query is a hash lookup
+        // records are appended as targets finish; a record for an output replaces any earlier one, and the file
+        // is compacted when opened if most of it consists of replaced records
+        class build_log
+        {
+        public:
+            struct input
+            {
+                boost::filesystem::path path;
+                std::uint64_t hash;
+            };
+
+            struct record
+            {
+                std::vector<input> inputs;
+                bool hashed = false; // whether the input and output hashes are meaningful
+                std::uint64_t command_signature = 0;
+                std::uint64_t output_hash = 0;
+                std::uint64_t duration = 0; // in microseconds
+            };
+
+            struct file_hash
+            {
+                std::uint64_t inode;
+                std::uintmax_t size;
+                std::int64_t last_write_time;
+                std::int64_t hashed_at; // when the file was read, on the scale of last_write_time
+                std::uint64_t hash;
+            };
+
+            build_log(boost::filesystem::path path);
+            ~build_log();
+
+            build_log(const build_log &) = delete;
+            build_log & operator=(const build_log &) = delete;
+
+            std::shared_ptr<const record> find(const boost::filesystem::path & output) const;
+            void add(const boost::filesystem::path & output, record rec);
+
+            optional<file_hash> find_file_hash(const boost::filesystem::path & path) const;
+            void add_file_hash(const boost::filesystem::path & path, file_hash hash);
+
+        private:
+            void _load();
+            void _compact();
+            void _append(const std::string & buffer);
+
+            const boost::filesystem::path _path;
+
+            mutable std::mutex _lock;
+            int _fd = -1;
+            std::size_t _record_count = 0;
+
+            std::unordered_map<boost::filesystem::path, std::shared_ptr<const record>, boost::hash<boost::filesystem::path>> _records;
+            std::unordered_map<boost::filesystem::path, file_hash, boost::hash<boost::filesystem::path>> _file_hashes;
+        };
+    }}
+}
@@ -0,0 +1,56 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "remote_cache.h"
+#include "server.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // the reference implementation of the cache protocol (see remote_cache.h), storing everything in a directory
+        class cache_server : public frame_server
+        {
+        public:
+            cache_server(boost::filesystem::path socket, boost::filesystem::path storage);
+            ~cache_server();
+
+        protected:
+            virtual std::string _handle(const std::string & request) override;
+
+        private:
+            boost::filesystem::path _blob_path(std::uint64_t) const;
+            boost::filesystem::path _action_path(std::uint64_t) const;
+
+            const boost::filesystem::path _storage;
+
+            std::mutex _actions_lock;
+        };
+    }}
+}
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <unordered_map>
 
@@ -44,6 +45,32 @@ namespace reaver
 
             virtual void build(context_ptr, const boost::filesystem::path &) const = 0;
             virtual const std::vector<linker_capability> & linker_caps(context_ptr, const boost::filesystem::path &) const = 0;
+
+            // identifies the command that build() would run; 0 means the compiler cannot tell
+            virtual std::uint64_t command_signature(context_ptr, const boost::filesystem::path &) const
+            {
+                return 0;
+            }
+
+            // see target::_remote_capable, target::_build_remote, target::_declared_inputs and target::_restored
+            virtual bool can_build_remotely(context_ptr, const boost::filesystem::path &) const
+            {
+                return false;
+            }
+
+            virtual void build_remote(context_ptr ctx, const boost::filesystem::path & path) const
+            {
+                build(ctx, path);
+            }
+
+            virtual std::vector<boost::filesystem::path> declared_inputs(context_ptr ctx, const boost::filesystem::path & path) const
+            {
+                return inputs(ctx, path);
+            }
+
+            virtual void restored(context_ptr, const boost::filesystem::path &, std::vector<boost::filesystem::path>) const
+            {
+            }
         };
 
         using compiler_ptr = std::shared_ptr<compiler>;
@@ -0,0 +1,60 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+
+#include <boost/filesystem.hpp>
+
+#include "file_status.h"
+#include "build_log.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // opt-in content based freshness
+        // like git's index, remembers the inode, size and mtime each hash was computed for,
+        // so that unchanged files are never rehashed; the hashes are persisted in the build log
+        // also like git, a file modified no earlier than it was hashed is racily clean: it may have been written again
+        // within the same tick of the file system's clock, so its hash is only trusted once its mtime is older than that
+        class content_hashes
+        {
+        public:
+            content_hashes(build_log & log, bool enabled) : _log{ log }, _enabled{ enabled }
+            {
+            }
+
+            bool enabled() const
+            {
+                return _enabled;
+            }
+
+            std::uint64_t hash(file_status_cache & file_status, const boost::filesystem::path & path);
+
+        private:
+            build_log & _log;
+            const bool _enabled;
+        };
+    }}
+}
@@ -33,6 +33,12 @@
 
 #include "compiler.h"
 #include "linker.h"
+#include "scheduler.h"
+#include "file_status.h"
+#include "target_state.h"
+#include "build_log.h"
+#include "content_hashes.h"
+#include "environment.h"
 
 namespace reaver
 {
@@ -40,16 +46,53 @@ namespace reaver
     {
         class target;
 
+        struct runtime_options
+        {
+            std::size_t jobs = default_job_count();
+            bool content_hashes = false;
+            std::shared_ptr<cache_backend> remote_cache;
+            std::shared_ptr<remote_executor> remote_execution;
+            std::size_t remote_jobs = 0;
+            // what commands run with (and their signatures see), as `NAME=value`; none means the environment of this process
+            // lets the daemon build with the environment of a client without touching its own, which no thread could safely do while others run
+            optional<std::vector<std::string>> environment;
+        };
+
         struct runtime_context
         {
-            runtime_context(boost::filesystem::path output_dir) : output_directory{ std::move(output_dir) }
+            runtime_context(boost::filesystem::path output_dir, runtime_options opts)
+                : output_directory{ std::move(output_dir) },
+                options{ opts },
+                environment{ options.environment ? *options.environment : process_environment() },
+                scheduler{ options.jobs },
+                build_log{ output_directory / ".despayre_log" },
+                content_hashes{ build_log, options.content_hashes }
+            {
+            }
+
+            // prepares a context that was used by an earlier build for the next one
+            // unless someone keeps the stat cache up to date in between, every file has to be looked at again
+            void start_build()
             {
+                scheduler.reset();
+                if (!file_status_maintained)
+                {
+                    file_status.clear();
+                }
+                target_states.clear();
             }
 
             const boost::filesystem::path output_directory;
+            const runtime_options options;
+            const std::vector<std::string> environment;
 
-            std::mutex futures_lock;
-            std::unordered_map<std::shared_ptr<target>, optional<future<>>> build_futures;
+            job_scheduler scheduler;
+            file_status_cache file_status;
+            // set by the owner of a context that forgets the paths that changed between builds itself (see build_daemon)
+            bool file_status_maintained = false;
+            target_state_record target_states;
+            class build_log build_log;
+            class content_hashes content_hashes;
 
             std::unordered_map<boost::filesystem::path, std::shared_ptr<target>, boost::hash<boost::filesystem::path>> generated_files;
             std::unordered_map<boost::filesystem::path, std::shared_ptr<target>, boost::hash<boost::filesystem::path>> file_targets;
@@ -58,9 +101,9 @@ namespace reaver
             linker_configuration linkers;
         };
 
-        inline context_ptr make_runtime_context(boost::filesystem::path output_dir)
+        inline context_ptr make_runtime_context(boost::filesystem::path output_dir, runtime_options options = {})
         {
-            return std::make_shared<runtime_context>(std::move(output_dir));
+            return std::make_shared<runtime_context>(std::move(output_dir), std::move(options));
         }
     }}
 }
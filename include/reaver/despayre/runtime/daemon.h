@@ -0,0 +1,111 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <reaver/optional.h>
+
+#include "../despayre.h"
+#include "file_status.h"
+#include "file_watcher.h"
+#include "server.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // a build as requested from the command line; the daemon turns it into runtime_options on its side
+        struct daemon_request
+        {
+            std::string target;
+            std::string output_directory;
+            std::size_t jobs = 0;
+            bool content_hashes = false;
+            std::string remote_cache;
+            std::vector<std::string> workers;
+            std::size_t remote_jobs = 0;
+            bool stats = false;
+            // filled in by build_with_daemon when left empty; the daemon builds with the client's environment,
+            // and only for a client in the directory it serves
+            std::string working_directory;
+            std::vector<std::string> environment; // as `NAME=value`
+        };
+
+        std::string encode(const daemon_request & request);
+        daemon_request decode_daemon_request(message_reader & reader);
+
+        runtime_options make_runtime_options(const daemon_request & request);
+
+        // the socket a daemon serving the current working directory listens on
+        inline boost::filesystem::path daemon_socket_path()
+        {
+            return ".despayre_daemon";
+        }
+
+        // keeps the parsed buildfile, the analyzed graph and the runtime contexts (with their build logs) loaded between builds
+        // the buildfile is analyzed again when it (or .despayreignore) changes, or when any directory a glob looked at does, as that may change what the globs match,
+        // and when a request asks for a different output directory, which the globs have to skip
+        // the stat caches of the contexts are kept between builds as well; the workspace is watched, and only what changed in it, or lies outside of it
+        // (like the outputs), is looked at again
+        // a request frame is followed by the client's stdout and stderr (see send_fds), which the build writes to;
+        // the response is the exit code the build would have had as a separate process, unless the client is in a different directory,
+        // in which case the daemon turns the request down
+        // builds are run one at a time, as they share the process' standard streams
+        class build_daemon : public frame_server
+        {
+        public:
+            build_daemon(boost::filesystem::path buildfile, std::string endpoint = daemon_socket_path().string());
+            ~build_daemon();
+
+        protected:
+            virtual std::string _handle_connection(int connection, const std::string & request) override;
+
+        private:
+            int _build(const daemon_request & request);
+            bool _buildfile_changed() const;
+            bool _globs_changed() const;
+            void _refresh(const std::string & output_directory);
+            void _forget_changes();
+
+            const boost::filesystem::path _buildfile;
+
+            std::mutex _build_lock;
+            std::unique_ptr<despayre> _graph;
+            file_status _buildfile_status;
+            file_status _ignore_file_status;
+            file_watcher _watcher;
+            std::string _output_directory;
+            std::map<std::string, context_ptr> _contexts;
+        };
+
+        // returns none when there is no daemon to talk to, it turned the request down, or it went away before answering; the caller should then build on its own
+        optional<int> build_with_daemon(const daemon_request & request, const boost::filesystem::path & socket = daemon_socket_path());
+    }}
+}
@@ -0,0 +1,40 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // environments are kept as `NAME=value` strings, like environ, so that they can be handed to a new process as they are
+
+        // a copy of the environment of this process
+        std::vector<std::string> process_environment();
+
+        // null when the variable isn't set
+        const char * find_variable(const std::vector<std::string> & environment, const std::string & name);
+    }}
+}
@@ -60,6 +60,11 @@ namespace reaver
                 }
             }
 
+            const std::u32string & name() const
+            {
+                return _name;
+            }
+
             virtual const std::vector<std::shared_ptr<target>> & dependencies(context_ptr) override
             {
                 return _deps;
@@ -78,16 +83,29 @@ namespace reaver
         protected:
             virtual void _build(context_ptr ctx) override
             {
-                auto required_linker_caps = mbind(_deps, [&](auto && dep) { return dep->linker_caps(ctx); });
-                std::sort(required_linker_caps.begin(), required_linker_caps.end());
-                required_linker_caps.erase(std::unique(required_linker_caps.begin(), required_linker_caps.end()), required_linker_caps.end());
+                auto required_linker_caps = _required_linker_caps(ctx);
                 auto linker = ctx->linkers.get_linker(required_linker_caps);
                 linker->build(ctx, outputs(ctx).front(), binary_type::executable, inputs(ctx), required_linker_caps);
             }
 
+            virtual std::uint64_t _command_signature(context_ptr ctx) override
+            {
+                auto required_linker_caps = _required_linker_caps(ctx);
+                auto linker = ctx->linkers.get_linker(required_linker_caps);
+                return linker->command_signature(ctx, outputs(ctx).front(), binary_type::executable, inputs(ctx), required_linker_caps);
+            }
+
         private:
             std::u32string _name;
             std::vector<std::shared_ptr<target>> _deps;
+
+            std::vector<linker_capability> _required_linker_caps(const context_ptr & ctx)
+            {
+                auto required_linker_caps = mbind(_deps, [&](auto && dep) { return dep->linker_caps(ctx); });
+                std::sort(required_linker_caps.begin(), required_linker_caps.end());
+                required_linker_caps.erase(std::unique(required_linker_caps.begin(), required_linker_caps.end()), required_linker_caps.end());
+                return required_linker_caps;
+            }
         };
     }}
 }
@@ -0,0 +1,131 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <reaver/optional.h>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        struct file_status
+        {
+            bool exists = false;
+            std::int64_t last_write_time = 0; // in nanoseconds
+            std::uintmax_t size = 0;
+            std::uint64_t inode = 0;
+        };
+
+        // uncached; a path that can't be stat'd doesn't exist
+        file_status stat_file(const boost::filesystem::path & path);
+
+        // the current time, on the scale of file_status::last_write_time
+        inline std::int64_t current_file_time()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        void set_last_write_time(const boost::filesystem::path & path, std::int64_t time);
+
+        // stats every path at most once per build
+        // outputs need to be invalidated after they are (re)built
+        class file_status_cache
+        {
+        public:
+            file_status status(const boost::filesystem::path & path);
+
+            bool exists(const boost::filesystem::path & path)
+            {
+                return status(path).exists;
+            }
+
+            std::int64_t last_write_time(const boost::filesystem::path & path)
+            {
+                return status(path).last_write_time;
+            }
+
+            // doesn't stat the path when it isn't in the cache
+            optional<file_status> cached(const boost::filesystem::path & path) const
+            {
+                std::lock_guard<std::mutex> lock{ _lock };
+                auto it = _cache.find(path);
+                if (it == _cache.end())
+                {
+                    return none;
+                }
+                return it->second;
+            }
+
+            void invalidate(const boost::filesystem::path & path)
+            {
+                std::lock_guard<std::mutex> lock{ _lock };
+                _cache.erase(path);
+            }
+
+            // forgets everything; for contexts reused across builds
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock{ _lock };
+                _cache.clear();
+            }
+
+            // forgets the paths `keep` returns false for; for contexts reused across builds, when it's known what changed in between
+            template<typename F>
+            void retain(F && keep)
+            {
+                std::lock_guard<std::mutex> lock{ _lock };
+                for (auto it = _cache.begin(); it != _cache.end(); )
+                {
+                    it = keep(it->first) ? std::next(it) : _cache.erase(it);
+                }
+            }
+
+            std::size_t hits() const
+            {
+                return _hits;
+            }
+
+            std::size_t misses() const
+            {
+                return _misses;
+            }
+
+        private:
+            mutable std::mutex _lock;
+            std::unordered_map<boost::filesystem::path, file_status, boost::hash<boost::filesystem::path>> _cache;
+
+            std::atomic<std::size_t> _hits{ 0 };
+            std::atomic<std::size_t> _misses{ 0 };
+        };
+    }}
+}
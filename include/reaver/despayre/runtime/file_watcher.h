@@ -0,0 +1,90 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // the directories under root (and root itself) that sources can be found in
+        // skips .git and output directories (ones with a build log), which change with every build, but are never globbed for
+        std::vector<boost::filesystem::path> source_directories(const boost::filesystem::path & root);
+
+        struct file_changes
+        {
+            // the entries of watched directories that were created, removed, renamed or written to, as absolute paths
+            std::unordered_set<boost::filesystem::path, boost::hash<boost::filesystem::path>> paths;
+            // the kernel dropped events; anything could have changed
+            bool overflow = false;
+            // interrupt() was called
+            bool interrupted = false;
+        };
+
+        // watches directories (not recursively) with inotify
+        // directories are watched rather than files, so that files replaced by renaming (as many editors save them) are still followed
+        class file_watcher
+        {
+        public:
+            file_watcher();
+            ~file_watcher();
+
+            file_watcher(const file_watcher &) = delete;
+            file_watcher & operator=(const file_watcher &) = delete;
+
+            // watching the same directory twice is a no-op, and so is watching one that doesn't exist
+            void watch(const boost::filesystem::path & directory);
+            void clear();
+
+            // blocks until something changes, then collects changes until none arrive for `quiet_ms`, so that a burst of saves is seen as one
+            file_changes wait(std::uint32_t quiet_ms);
+            // the changes that arrived since the last call, without waiting for any
+            file_changes pending();
+
+            // whether changes in the directory are seen; false once it was removed
+            bool watching(const boost::filesystem::path & directory) const
+            {
+                return _watched.count(directory);
+            }
+
+            // makes a wait() in progress (or the next one) return with `interrupted` set; safe to call from any thread
+            void interrupt();
+
+        private:
+            void _read(file_changes & changes);
+
+            int _fd = -1;
+            int _interrupt[2] = { -1, -1 };
+
+            std::unordered_map<int, boost::filesystem::path> _directories;
+            std::unordered_set<boost::filesystem::path, boost::hash<boost::filesystem::path>> _watched;
+        };
+    }}
+}
@@ -22,12 +22,17 @@
 
 #pragma once
 
+#include <mutex>
+
 #include <reaver/prelude/functor.h>
 #include <reaver/prelude/monad.h>
 #include <reaver/filesystem.h>
 
 #include "../semantics/string.h"
 #include "../semantics/target.h"
+#include "../semantics/context.h"
+#include "file_status.h"
+#include "glob.h"
 #include "compiler.h"
 #include "linker.h"
 
@@ -126,6 +131,31 @@ namespace reaver
                 ctx->compilers.get_compiler(_path)->build(ctx, _path);
             }
 
+            virtual bool _remote_capable(context_ptr ctx) override
+            {
+                return ctx->compilers.get_compiler(_path)->can_build_remotely(ctx, _path);
+            }
+
+            virtual void _build_remote(context_ptr ctx) override
+            {
+                ctx->compilers.get_compiler(_path)->build_remote(ctx, _path);
+            }
+
+            virtual std::uint64_t _command_signature(context_ptr ctx) override
+            {
+                return ctx->compilers.get_compiler(_path)->command_signature(ctx, _path);
+            }
+
+            virtual std::vector<boost::filesystem::path> _declared_inputs(context_ptr ctx) override
+            {
+                return ctx->compilers.get_compiler(_path)->declared_inputs(ctx, _path);
+            }
+
+            virtual void _restored(context_ptr ctx, std::vector<boost::filesystem::path> inputs) override
+            {
+                ctx->compilers.get_compiler(_path)->restored(ctx, _path, std::move(inputs));
+            }
+
         private:
             boost::filesystem::path _path;
             std::shared_ptr<compiler> _compiler;
@@ -148,29 +178,8 @@ namespace reaver
 
         class files : public target
         {
-            files() : target{ get_type_identifier<files>() }
-            {
-                _add_addition(get_type_identifier<files>(), [](_op_arg lhs, _op_arg rhs) -> std::shared_ptr<variable> {
-                    auto lhs_files = lhs->as<files>();
-                    auto rhs_files = rhs->as<files>();
-
-                    std::vector<boost::filesystem::path> result;
-                    std::set_union(lhs_files->_args.begin(), lhs_files->_args.end(), rhs_files->_args.begin(), rhs_files->_args.end(), std::back_inserter(result));
-                    return std::make_shared<files>(std::move(result));
-                });
-
-                _add_removal(get_type_identifier<files>(), [](_op_arg lhs, _op_arg rhs) -> std::shared_ptr<variable> {
-                    auto lhs_files = lhs->as<files>();
-                    auto rhs_files = rhs->as<files>();
-
-                    std::vector<boost::filesystem::path> result;
-                    std::set_difference(lhs_files->_args.begin(), lhs_files->_args.end(), rhs_files->_args.begin(), rhs_files->_args.end(), std::back_inserter(result));
-                    return std::make_shared<files>(std::move(result));
-                });
-            }
-
         public:
-            files(std::vector<std::shared_ptr<variable>> args) : files()
+            files(std::vector<std::shared_ptr<variable>> args) : target{ get_type_identifier<files>() }
             {
                 auto paths = fmap(args, [](std::shared_ptr<variable> arg) {
                     return boost::filesystem::path(utf8(arg->as<string>()->value()));
@@ -179,17 +188,54 @@ namespace reaver
                 std::unique_copy(paths.begin(), paths.end(), std::back_inserter(_args));
             }
 
-            files(std::vector<boost::filesystem::path> paths) : files()
+            files(std::vector<boost::filesystem::path> paths) : target{ get_type_identifier<files>() }
             {
                 std::sort(paths.begin(), paths.end());
                 std::unique_copy(std::make_move_iterator(paths.begin()), std::make_move_iterator(paths.end()), std::back_inserter(_args));
             }
 
+            // for paths that are already sorted and unique, like the ones a glob or a set operation produces
+            struct sorted_tag {};
+
+            files(std::vector<boost::filesystem::path> paths, sorted_tag) : target{ get_type_identifier<files>() }, _args{ std::move(paths) }
+            {
+            }
+
+            using directory_times = std::shared_ptr<std::map<boost::filesystem::path, std::int64_t>>;
+
+            // the globs are only walked once the paths are needed, so that the globs later removed from these files can be left out of the walks
+            // the walks record the directories they looked at in `globbed_directories`, when there's one, and skip what `options` tell them to
+            struct pending_glob
+            {
+                glob_query query;
+                directory_times globbed_directories;
+                std::shared_ptr<const glob_options> options;
+            };
+
+            // the matches of the globs, and the (sorted) explicit paths, without the (sorted) removed paths
+            files(std::vector<pending_glob> globs, std::vector<boost::filesystem::path> explicit_paths, std::vector<boost::filesystem::path> removed)
+                : target{ get_type_identifier<files>() }, _globs{ std::move(globs) }, _explicit{ std::move(explicit_paths) }, _removed{ std::move(removed) }
+            {
+            }
+
+            const std::vector<boost::filesystem::path> & paths() const
+            {
+                if (!_globs.empty())
+                {
+                    std::call_once(_walked, [&]{ _walk(); });
+                }
+                return _args;
+            }
+
+            // the set operations keep the globs unwalked for as long as that doesn't change the result
+            std::shared_ptr<files> unite(const files & other) const;
+            std::shared_ptr<files> remove(const files & other) const;
+
             virtual const std::vector<std::shared_ptr<target>> & dependencies(context_ptr ctx) override
             {
                 if (!_file_deps || ctx != _cached_context)
                 {
-                    _file_deps = fmap(_args, [&](boost::filesystem::path argument) {
+                    _file_deps = fmap(paths(), [&](boost::filesystem::path argument) {
                         return get_file_target(ctx, std::move(argument));
                     });
                     _linker_caps = mbind(*_file_deps, [&](auto && file) {
@@ -225,7 +271,18 @@ namespace reaver
             }
 
         private:
-            std::vector<boost::filesystem::path> _args;
+            void _walk() const;
+
+            const std::vector<boost::filesystem::path> & _explicit_paths() const
+            {
+                return _globs.empty() ? _args : _explicit;
+            }
+
+            mutable std::vector<boost::filesystem::path> _args;
+            std::vector<pending_glob> _globs;
+            std::vector<boost::filesystem::path> _explicit;
+            std::vector<boost::filesystem::path> _removed;
+            mutable std::once_flag _walked;
             optional<std::vector<std::shared_ptr<target>>> _file_deps;
             optional<std::vector<linker_capability>> _linker_caps;
             context_ptr _cached_context;
@@ -233,9 +290,19 @@ namespace reaver
 
         struct glob_tag {};
 
-        inline std::shared_ptr<variable> glob(std::vector<std::shared_ptr<variable>> arguments)
+        inline std::shared_ptr<variable> glob(std::vector<std::shared_ptr<variable>> arguments, files::directory_times globbed_directories = nullptr, std::shared_ptr<const glob_options> options = nullptr)
         {
-            return std::make_shared<files>(filesystem::wildcard(utf8(arguments[0]->as<string>()->value())));
+            std::vector<files::pending_glob> globs{ { { utf8(arguments[0]->as<string>()->value()), {} }, std::move(globbed_directories), std::move(options) } };
+            return std::make_shared<files>(std::move(globs), std::vector<boost::filesystem::path>{}, std::vector<boost::filesystem::path>{});
+        }
+
+        // like glob, but the walk remembers the directories the pattern looked at, with their modification times, and uses the options of the context
+        inline auto generate_glob(semantic_context & ctx)
+        {
+            return [globbed_directories = ctx.globbed_directories, options = ctx.walk_options](std::vector<std::shared_ptr<variable>> arguments)
+            {
+                return glob(std::move(arguments), globbed_directories, options);
+            };
         }
     }}
 }
@@ -0,0 +1,84 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        struct globbed_directory
+        {
+            boost::filesystem::path path;
+            std::int64_t last_write_time = 0;
+        };
+
+        struct glob_result
+        {
+            // regular files (and symlinks to them), sorted like paths are, without a leading "./"
+            std::vector<boost::filesystem::path> matches;
+            // the directories whose contents decide what the pattern matches; output directories are left out
+            std::vector<globbed_directory> directories;
+        };
+
+        struct glob_query
+        {
+            std::string pattern;
+            // patterns of other globs whose matches are left out during the walk; each has to pass can_exclude
+            std::vector<std::string> excluded;
+        };
+
+        struct glob_options
+        {
+            // never entered; like in .gitignore, a pattern with no slash is matched against the names of directories,
+            // and one with a slash against their paths relative to the working directory
+            std::vector<std::string> ignored;
+            // never entered either, like `.git` and any other directory holding a build log
+            // the build log of an output directory only shows up with its first build, so those need to be told upfront
+            std::vector<boost::filesystem::path> output_directories;
+        };
+
+        // one pattern per line; empty lines and ones starting with `#` are skipped; a missing file has no patterns
+        std::vector<std::string> read_ignore_file(const boost::filesystem::path & path);
+
+        // whether glob(pattern) - glob(excluded) is the same as walking `pattern` with `excluded` left out of the walk
+        // it is when the literal root of `excluded` is inside the one of `pattern`: whatever the walk reaches there, it reaches the way a walk of `excluded` would
+        bool can_exclude(const std::string & pattern, const std::string & excluded);
+
+        // `*`, `?` and `[...]` match within a single component, `**` matches any number of directories
+        // wildcards don't match names starting with a dot, and symlinks to directories aren't followed
+        // only the directories the pattern can still match in are entered, and none where an excluded pattern is sure to match everything
+        // the walk is split between `threads` threads (0 meaning one per core), each stealing directories from the others when it runs out
+        glob_result match_glob(const glob_query & query, std::size_t threads = 0, const glob_options & options = {});
+
+        inline glob_result match_glob(const std::string & pattern, std::size_t threads = 0)
+        {
+            return match_glob(glob_query{ pattern, {} }, threads);
+        }
+    }}
+}
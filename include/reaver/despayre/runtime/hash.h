@@ -0,0 +1,47 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // XXH64; processes four independent 64 bit lanes per 32 byte stripe, which keeps the hot loop
+        // free of cross-lane dependencies and lets the compiler interleave (or vectorize) them
+        std::uint64_t hash_bytes(const void * data, std::size_t size, std::uint64_t seed = 0);
+
+        // hashes the contents of a file; throws if it cannot be read
+        std::uint64_t hash_file(const boost::filesystem::path & path);
+
+        // hashes a command line together with the values the variables it expands (`names`) have in the environment it runs with (see environment.h);
+        // the signature changes whenever what would actually be executed changes
+        std::uint64_t hash_command(const std::vector<std::string> & args, const std::vector<std::string> & names, const std::vector<std::string> & environment);
+    }}
+}
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <sstream>
@@ -57,6 +58,26 @@ namespace reaver
             virtual ~linker() = default;
 
             void build(context_ptr ctx, const boost::filesystem::path & output, binary_type type, const std::vector<boost::filesystem::path> & inputs, const std::vector<linker_capability> & required_caps) const
+            {
+                _build(ctx, output, type, inputs, _flags(required_caps));
+            }
+
+            std::uint64_t command_signature(context_ptr ctx, const boost::filesystem::path & output, binary_type type, const std::vector<boost::filesystem::path> & inputs, const std::vector<linker_capability> & required_caps) const
+            {
+                return _command_signature(ctx, output, type, inputs, _flags(required_caps));
+            }
+
+        protected:
+            virtual void _build(context_ptr, const boost::filesystem::path &, binary_type, const std::vector<boost::filesystem::path> &, const std::string &) const = 0;
+
+            // 0 means the linker cannot tell; such outputs are never rebuilt because of a changed command
+            virtual std::uint64_t _command_signature(context_ptr, const boost::filesystem::path &, binary_type, const std::vector<boost::filesystem::path> &, const std::string &) const
+            {
+                return 0;
+            }
+
+        private:
+            std::string _flags(const std::vector<linker_capability> & required_caps) const
             {
                 std::stringstream all_flags{ " " }; // really need sane ranges though
                 std::vector<std::string> empty; // curses to C++ lambda return type deduction and the retarded {} rules
@@ -65,11 +86,8 @@ namespace reaver
                     all_flags << std::quoted(std::move(flag)) << " ";
                 }
 
-                _build(ctx, output, type, inputs, all_flags.str());
+                return all_flags.str();
             }
-
-        protected:
-            virtual void _build(context_ptr, const boost::filesystem::path &, binary_type, const std::vector<boost::filesystem::path> &, const std::string &) const = 0;
         };
 
         class linker_configuration
@@ -0,0 +1,130 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <reaver/exception.h>
+#include <reaver/optional.h>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // the building blocks of the wire protocols spoken between despayre processes
+        // a connection carries frames: a 32 bit length followed by that many bytes of body
+        // integers in bodies are stored in host byte order, as both ends are expected to run on the same kind of machine
+        class protocol_error : public exception
+        {
+        public:
+            protocol_error(const std::string & message) : exception{ logger::error }
+            {
+                *this << message;
+            }
+        };
+
+        template<typename T>
+        void put_value(std::string & buffer, T value)
+        {
+            buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        inline void put_string(std::string & buffer, const std::string & str)
+        {
+            put_value<std::uint32_t>(buffer, str.size());
+            buffer += str;
+        }
+
+        class message_reader
+        {
+        public:
+            message_reader(const std::string & body) : _current{ body.data() }, _end{ body.data() + body.size() }
+            {
+            }
+
+            template<typename T>
+            T get()
+            {
+                if (static_cast<std::size_t>(_end - _current) < sizeof(T))
+                {
+                    throw protocol_error{ "truncated message." };
+                }
+
+                T ret;
+                std::memcpy(&ret, _current, sizeof(T));
+                _current += sizeof(T);
+                return ret;
+            }
+
+            std::string get_string()
+            {
+                auto size = get<std::uint32_t>();
+                if (static_cast<std::size_t>(_end - _current) < size)
+                {
+                    throw protocol_error{ "truncated message." };
+                }
+
+                std::string ret{ _current, _current + size };
+                _current += size;
+                return ret;
+            }
+
+            bool empty() const
+            {
+                return _current == _end;
+            }
+
+        private:
+            const char * _current;
+            const char * _end;
+        };
+
+        // both throw protocol_error when the connection fails or times out
+        void write_frame(int fd, const std::string & body);
+        // returns none when the other end closes the connection between frames
+        optional<std::string> read_frame(int fd);
+
+        // passes open file descriptors over a unix socket, attached to a single byte of data
+        // the receiving end owns the returned descriptors
+        void send_fds(int socket, const std::vector<int> & fds);
+        std::vector<int> receive_fds(int socket, std::size_t count);
+
+        // a timeout of 0 means blocking forever
+        int connect_unix_socket(const boost::filesystem::path & path, std::uint32_t timeout_ms = 0);
+        // replaces a stale socket file left behind by a dead process
+        int listen_unix_socket(const boost::filesystem::path & path);
+
+        int connect_tcp_socket(const std::string & host, const std::string & port, std::uint32_t timeout_ms = 0);
+        int listen_tcp_socket(const std::string & host, const std::string & port);
+
+        // endpoints are written as `tcp:<host>:<port>` or `unix:<path>`; anything else is taken to be a unix socket path
+        // a tcp endpoint with no host (`tcp::<port>`) listens on the loopback interface; listening on every one has to be asked for, like `tcp:0.0.0.0:<port>`
+        int connect_endpoint(const std::string & endpoint, std::uint32_t timeout_ms = 0);
+        int listen_endpoint(const std::string & endpoint);
+    }}
+}
@@ -0,0 +1,122 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <reaver/optional.h>
+
+#include "protocol.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // what a build step produced, as stored in a shared cache
+        // inputs are the ones only known after the step ran (like included headers), and have to match for the result to be used
+        // outputs refer to blobs by the hash of their contents
+        struct action_result
+        {
+            struct file
+            {
+                boost::filesystem::path path;
+                std::uint64_t hash;
+                std::uint32_t mode = 0;
+            };
+
+            std::vector<file> inputs;
+            std::vector<file> outputs;
+        };
+
+        void encode(std::string & buffer, const action_result & result);
+        action_result decode_action_result(message_reader & reader);
+
+        // storage shared between builds: content addressed blobs, plus a map from action keys to the results of those actions
+        // an action key can map to several results, differing in their discovered inputs
+        // implementations throw protocol_error when the storage can't be reached; callers treat that as a miss
+        class cache_backend
+        {
+        public:
+            virtual ~cache_backend() = default;
+
+            virtual optional<std::string> get_blob(std::uint64_t hash) = 0;
+            virtual void put_blob(std::uint64_t hash, const std::string & contents) = 0;
+
+            virtual std::vector<action_result> get_action(std::uint64_t key) = 0;
+            virtual void put_action(std::uint64_t key, const action_result & result) = 0;
+        };
+
+        // requests are single frames starting with an operation byte:
+        //   get_blob   u64 hash                     -> status, and the contents if found
+        //   put_blob   u64 hash, contents           -> status; the server checks the hash
+        //   get_action u64 key                      -> status, u32 count, that many results
+        //   put_action u64 key, result              -> status
+        // responses are single frames starting with a status byte
+        enum class cache_operation : std::uint8_t
+        {
+            get_blob = 1,
+            put_blob = 2,
+            get_action = 3,
+            put_action = 4
+        };
+
+        enum class cache_status : std::uint8_t
+        {
+            ok = 0,
+            not_found = 1,
+            error = 2
+        };
+
+        // talks to a cache server over a unix socket; connections are kept open and reused
+        // every request fails with protocol_error if it takes longer than the timeout
+        class unix_socket_cache : public cache_backend
+        {
+        public:
+            unix_socket_cache(boost::filesystem::path socket, std::uint32_t timeout_ms = 2000) : _socket{ std::move(socket) }, _timeout{ timeout_ms }
+            {
+            }
+
+            ~unix_socket_cache();
+
+            virtual optional<std::string> get_blob(std::uint64_t hash) override;
+            virtual void put_blob(std::uint64_t hash, const std::string & contents) override;
+
+            virtual std::vector<action_result> get_action(std::uint64_t key) override;
+            virtual void put_action(std::uint64_t key, const action_result & result) override;
+
+        private:
+            std::string _request(const std::string & body);
+
+            const boost::filesystem::path _socket;
+            const std::uint32_t _timeout;
+
+            std::mutex _lock;
+            std::vector<int> _idle;
+        };
+    }}
+}
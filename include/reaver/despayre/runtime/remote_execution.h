@@ -0,0 +1,104 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "protocol.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // a self contained compilation, needing nothing from the machine that runs it but the compiler
+        // the worker stores `source` in a file with the given extension and runs `<arguments...> -o <object> <source file>`, without a shell;
+        // it only runs the compiler it was started with, and turns down arguments that would load code into it or have it write elsewhere
+        // (see worker_server)
+        struct remote_action
+        {
+            std::vector<std::string> arguments;
+            std::string source_extension;
+            std::string source;
+        };
+
+        struct remote_result
+        {
+            std::int32_t exit_code = 0;
+            std::string diagnostics;
+            std::string object;
+        };
+
+        // requests and responses are single frames:
+        //   execute    arguments, source extension, source  -> status, exit code, diagnostics, object
+        // nothing authenticates the clients; see worker_server
+        enum class execution_operation : std::uint8_t
+        {
+            execute = 1
+        };
+
+        enum class execution_status : std::uint8_t
+        {
+            ok = 0,
+            error = 2
+        };
+
+        std::string encode(const remote_action & action);
+        remote_action decode_remote_action(message_reader & reader);
+
+        // hands actions out to a pool of workers, preferring the least busy one
+        // a worker that fails is not used again; execute() throws protocol_error once every worker has failed
+        class remote_executor
+        {
+        public:
+            remote_executor(std::vector<std::string> endpoints, std::uint32_t timeout_ms = 10 * 60 * 1000);
+            ~remote_executor();
+
+            remote_executor(const remote_executor &) = delete;
+            remote_executor & operator=(const remote_executor &) = delete;
+
+            std::size_t workers() const
+            {
+                return _workers.size();
+            }
+
+            remote_result execute(const remote_action & action);
+
+        private:
+            struct _worker
+            {
+                std::string endpoint;
+                std::vector<int> idle;
+                std::size_t running = 0;
+                bool failed = false;
+            };
+
+            const std::uint32_t _timeout;
+
+            std::mutex _lock;
+            std::vector<_worker> _workers;
+        };
+    }}
+}
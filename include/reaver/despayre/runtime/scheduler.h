@@ -0,0 +1,191 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <deque>
+
+#include <reaver/exception.h>
+#include <reaver/future.h>
+
+#include "decl.h"
+#include "remote_cache.h"
+#include "remote_execution.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        class target;
+
+        inline std::size_t default_job_count()
+        {
+            return std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        // the error of targets whose builds were dropped by job_scheduler::cancel
+        class build_cancelled : public exception
+        {
+        public:
+            build_cancelled() : exception{ logger::info }
+            {
+                *this << "the build was cancelled.";
+            }
+        };
+
+        // the error of targets whose commands failed; whatever the command printed has already been logged
+        class build_failed : public exception
+        {
+        public:
+            build_failed(const std::string & what) : exception{ logger::error }
+            {
+                *this << what;
+            }
+        };
+
+        // keeps at most `jobs` target builds running at once
+        // a target becomes ready (and is queued) once all of its dependencies have finished building
+        // ready targets are started longest first, going by how long they took the last time (as per the build log)
+        // with a remote cache configured, ready targets are first looked up in the cache by a separate set of threads,
+        // so that a slow cache holds up only the targets being looked up, never the ones already known to need building;
+        // results of local builds are uploaded in the background, and the scheduler waits for the uploads when destroyed
+        // with remote execution configured, targets that can be built remotely are served by an additional `remote_jobs` threads;
+        // local threads take those too when they run out of local-only work, so the local machine is never idle while work remains
+        class job_scheduler
+        {
+        public:
+            job_scheduler(std::size_t jobs) : _jobs{ std::max<std::size_t>(jobs, 1) }
+            {
+            }
+
+            job_scheduler(const job_scheduler &) = delete;
+            job_scheduler & operator=(const job_scheduler &) = delete;
+
+            ~job_scheduler();
+
+            std::size_t jobs() const
+            {
+                return _jobs;
+            }
+
+            future<> schedule(context_ptr ctx, std::shared_ptr<target> root);
+
+            // waits for everything scheduled so far to finish, and forgets about it, so that the targets can be scheduled again
+            void reset();
+
+            // jobs that haven't started yet are not started at all, and fail with build_cancelled; running ones are left to finish
+            // lasts until the next reset()
+            void cancel();
+            // likewise, but only for the jobs of the given targets, and (as those fail) of the targets depending on them
+            void cancel(const std::unordered_set<std::shared_ptr<target>> & targets);
+
+        private:
+            struct _upload
+            {
+                std::shared_ptr<cache_backend> backend;
+                std::uint64_t key;
+                action_result result;
+                std::vector<std::pair<std::uint64_t, std::string>> blobs;
+            };
+
+            struct _node
+            {
+                std::shared_ptr<class target> target;
+                // keeps the context (which owns the scheduler) alive while the node is pending, so that whoever waits for it is always answered;
+                // released when the node finishes, which breaks the cycle
+                context_ptr ctx;
+
+                std::size_t pending_dependencies = 0;
+                std::uint64_t expected_duration = 0;
+                bool cacheable = false;
+                bool remote = false;
+                std::uint64_t action_key = 0;
+                std::vector<_node *> dependents;
+
+                bool running = false; // taken by a worker, to be built or looked up in the cache, and not finished yet
+                bool cancelled = false;
+                bool finished = false;
+                std::exception_ptr error;
+
+                promise<> build_promise;
+                future<> build_future;
+            };
+
+            // the workers share this with the scheduler, so that a worker that drops the last reference
+            // to the runtime context (and thus destroys the scheduler) can still safely wind down
+            struct _shared_state
+            {
+                std::mutex lock;
+                std::condition_variable ready_condition;
+                bool stop = false;
+                bool cancelled = false;
+
+                std::size_t unfinished = 0;
+                std::condition_variable idle_condition;
+
+                std::unordered_map<std::shared_ptr<target>, std::unique_ptr<_node>> nodes;
+                std::vector<_node *> ready; // a heap, ordered by _shorter_job
+                std::condition_variable remote_condition;
+                std::vector<_node *> remote_ready; // likewise
+
+                std::condition_variable cache_condition;
+                std::deque<_node *> lookups;
+                std::deque<_upload> uploads;
+                bool cache_failed = false; // after the first failure, the cache is not contacted again
+            };
+
+            struct _shorter_job
+            {
+                bool operator()(const _node * lhs, const _node * rhs) const
+                {
+                    return lhs->expected_duration < rhs->expected_duration;
+                }
+            };
+
+            static _node * _add(_shared_state & state, const context_ptr & ctx, const std::shared_ptr<target> & target, std::vector<_node *> & notify);
+            static void _finish(_shared_state & state, _node * node, std::exception_ptr error, std::vector<_node *> & notify);
+            static void _make_ready(_shared_state & state, _node * node);
+            static void _enqueue(_shared_state & state, _node * node);
+            static void _notify(const std::vector<_node *> & finished_nodes);
+            static void _work(std::shared_ptr<_shared_state> state, bool remote);
+
+            static std::uint64_t _action_key(const context_ptr & ctx, const std::shared_ptr<target> & target);
+            static bool _restore(const context_ptr & ctx, _node * node);
+            static optional<_upload> _prepare_upload(const context_ptr & ctx, _node * node, std::int64_t started);
+            static void _cache_work(std::shared_ptr<_shared_state> state);
+
+            const std::size_t _jobs;
+            std::shared_ptr<_shared_state> _state = std::make_shared<_shared_state>();
+            std::vector<std::thread> _workers;
+            std::vector<std::thread> _cache_workers;
+        };
+    }}
+}
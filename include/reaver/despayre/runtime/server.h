@@ -0,0 +1,70 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // serves a frame based protocol (see protocol.h): every request frame is answered with the frame returned by _handle
+        // servers that need to talk to the connection directly (for instance to receive file descriptors) override _handle_connection instead
+        // the endpoint is listening once the constructor returns; run() serves connections, each on its own thread, until stop() is called
+        // derived classes must call _shutdown() in their destructors, so that no connection thread is left calling _handle
+        class frame_server
+        {
+        public:
+            frame_server(std::string endpoint);
+            virtual ~frame_server();
+
+            frame_server(const frame_server &) = delete;
+            frame_server & operator=(const frame_server &) = delete;
+
+            void run();
+            void stop();
+
+        protected:
+            virtual std::string _handle(const std::string & request);
+            virtual std::string _handle_connection(int connection, const std::string & request);
+
+            void _shutdown();
+
+        private:
+            void _serve(int fd);
+
+            const std::string _endpoint;
+
+            int _listener = -1;
+            std::atomic<bool> _stopped{ false };
+
+            std::mutex _lock;
+            std::condition_variable _finished_condition;
+            std::vector<int> _connections;
+        };
+    }}
+}
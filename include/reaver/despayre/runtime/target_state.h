@@ -0,0 +1,82 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <reaver/optional.h>
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        class target;
+
+        enum class target_state
+        {
+            dirty,
+            built
+        };
+
+        // filled by target::built in a single pass over the graph, updated by the scheduler as targets get built
+        class target_state_record
+        {
+        public:
+            optional<target_state> get(const std::shared_ptr<target> & target) const
+            {
+                std::lock_guard<std::mutex> lock{ _lock };
+                auto it = _states.find(target);
+                if (it == _states.end())
+                {
+                    return none;
+                }
+                return it->second;
+            }
+
+            void set(std::shared_ptr<target> target, target_state state)
+            {
+                std::lock_guard<std::mutex> lock{ _lock };
+                _states[std::move(target)] = state;
+            }
+
+            // the target is evaluated again the next time it's asked about
+            void erase(const std::shared_ptr<target> & target)
+            {
+                std::lock_guard<std::mutex> lock{ _lock };
+                _states.erase(target);
+            }
+
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock{ _lock };
+                _states.clear();
+            }
+
+        private:
+            mutable std::mutex _lock;
+            std::unordered_map<std::shared_ptr<target>, target_state> _states;
+        };
+    }}
+}
@@ -0,0 +1,96 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+
+#include "../despayre.h"
+#include "file_watcher.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // builds a target, and then builds it again whenever its inputs change
+        // a change to a known input only re-evaluates the targets consuming it and everything depending on them;
+        // a change to the buildfile or to .despayreignore, or a new or removed file in the workspace (which globs may match differently), analyzes it again
+        // a change arriving during a build cancels the jobs it affects that haven't started yet; running ones finish, but their outputs
+        // are only trusted if their inputs weren't modified in the meantime (see target::_after_build)
+        class build_watcher
+        {
+        public:
+            build_watcher(boost::filesystem::path buildfile, std::string target_name, std::string output_directory, runtime_options options = {}, std::uint32_t quiet_ms = 100);
+
+            build_watcher(const build_watcher &) = delete;
+            build_watcher & operator=(const build_watcher &) = delete;
+
+            // returns once stop() is called
+            void run();
+            void stop();
+
+        private:
+            void _analyze();
+            void _start_build();
+            void _apply(const file_changes & changes);
+            // the targets consuming the changed inputs and everything depending on them; none when the buildfile has to be analyzed again
+            optional<std::unordered_set<std::shared_ptr<target>>> _affected(const file_changes & changes) const;
+            void _index(const std::shared_ptr<target> & target);
+            void _add_input(const std::shared_ptr<target> & target, const boost::filesystem::path & input);
+            bool _generated(const boost::filesystem::path & absolute) const;
+
+            using _path_hash = boost::hash<boost::filesystem::path>;
+
+            const boost::filesystem::path _buildfile;
+            const boost::filesystem::path _workspace;
+            const boost::filesystem::path _ignore_file;
+            const std::string _target_name;
+            const std::string _output_directory;
+            const boost::filesystem::path _output_path;
+            const runtime_options _options;
+            const std::uint32_t _quiet;
+
+            std::atomic<bool> _stopped{ false };
+            file_watcher _watcher;
+
+            std::unique_ptr<despayre> _graph;
+            context_ptr _context;
+            std::shared_ptr<target> _root;
+            bool _first_build = true;
+
+            // inputs are keyed by their absolute paths; the paths the targets know them by are kept to invalidate the stat cache
+            std::unordered_map<boost::filesystem::path, std::unordered_set<std::shared_ptr<target>>, _path_hash> _consumers;
+            std::unordered_map<boost::filesystem::path, std::unordered_set<boost::filesystem::path, _path_hash>, _path_hash> _input_names;
+            std::unordered_map<std::shared_ptr<target>, std::unordered_set<std::shared_ptr<target>>> _dependents;
+            std::unordered_set<std::shared_ptr<target>> _indexed;
+            // building a target can change its inputs (like the headers a source includes), so they're indexed again after it was built
+            std::vector<std::shared_ptr<target>> _reindex;
+        };
+    }}
+}
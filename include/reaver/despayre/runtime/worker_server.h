@@ -0,0 +1,60 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "remote_execution.h"
+#include "server.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // runs actions sent by remote_executor (see remote_execution.h), at most `jobs` at a time
+        // the protocol is unauthenticated: whoever can connect can have `compiler` compile anything, so only listen where every client is trusted
+        // (tcp endpoints without a host only listen on the loopback interface, see listen_tcp_socket)
+        // actions for any other program, or with arguments that would load code into the compiler or have it write elsewhere, are turned down
+        class worker_server : public frame_server
+        {
+        public:
+            worker_server(std::string endpoint, std::size_t jobs, std::string compiler);
+            ~worker_server();
+
+        protected:
+            virtual std::string _handle(const std::string & request) override;
+
+        private:
+            remote_result _execute(const remote_action & action);
+
+            const std::size_t _jobs;
+            const std::string _compiler;
+
+            std::mutex _lock;
+            std::condition_variable _slot_condition;
+            std::size_t _running = 0;
+        };
+    }}
+}
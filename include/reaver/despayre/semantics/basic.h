@@ -39,12 +39,17 @@ namespace reaver
             print(const print &) = default;
             print(print &&) = default;
 
-            virtual bool built(context_ptr) override
+            const std::vector<std::shared_ptr<variable>> & arguments() const
             {
-                return false;
+                return _args;
             }
 
         protected:
+            virtual bool _up_to_date(context_ptr) override
+            {
+                return false;
+            }
+
             virtual void _build(context_ptr) override
             {
                 for (auto && arg : _args)
@@ -71,17 +76,17 @@ namespace reaver
                 }
             }
 
-            virtual bool built(context_ptr) override
-            {
-                return false;
-            }
-
             virtual const std::vector<std::shared_ptr<target>> & dependencies(context_ptr) override
             {
                 return _args;
             }
 
         protected:
+            virtual bool _up_to_date(context_ptr) override
+            {
+                return false;
+            }
+
             virtual void _build(context_ptr) override
             {
             }
@@ -22,14 +22,19 @@
 
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <string>
 
+#include <boost/filesystem.hpp>
+
 #include <reaver/plugin.h>
 
 #include "../parser/parser.h"
 #include "../runtime/context.h"
+#include "../runtime/glob.h"
 
 namespace reaver
 {
@@ -81,11 +86,19 @@ namespace reaver
             semantic_context & operator=(semantic_context &&) = default;
 
             std::shared_ptr<variable> variables;
-            std::unordered_map<std::u32string, std::shared_ptr<target>> targets;
+            // keyed by the whole, dotted name
+            std::unordered_map<symbol, std::shared_ptr<target>> targets;
             std::unordered_map<std::shared_ptr<delayed_variable>, range_type> unresolved;
+            // the name of the buildfile the ranges above point into; only used in diagnostics
+            std::string file;
             // ugly map because ugly incomplete type makes GCC unhappy when this is unordered
             std::map<type_identifier, type_descriptor> type_descriptors;
             std::unordered_set<plugin_initializer_with_context, hiwc_hash> plugin_initializers;
+            // the directories globs looked at during analysis, and their modification times back then
+            // shared with the glob constructor, which outlives the context it was registered in when thunks are forced after analysis
+            std::shared_ptr<std::map<boost::filesystem::path, std::int64_t>> globbed_directories = std::make_shared<std::map<boost::filesystem::path, std::int64_t>>();
+            // what the globs never enter; shared with the glob constructor too, so it has to be set before the builtins are registered
+            std::shared_ptr<const glob_options> walk_options = std::make_shared<const glob_options>();
         };
     }}
 }
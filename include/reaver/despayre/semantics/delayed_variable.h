@@ -28,6 +28,8 @@ namespace reaver
 {
     namespace despayre { inline namespace _v1
     {
+        struct parsed_buildfile;
+
         class delayed_variable : public variable
         {
         public:
@@ -35,11 +37,11 @@ namespace reaver
             {
             }
 
-            delayed_variable(std::vector<std::u32string> ref_id_expr) : variable{ nullptr }, _state{ _delayed_reference_info{ std::move(ref_id_expr) } }
+            delayed_variable(std::vector<symbol> ref_id_expr) : variable{ nullptr }, _state{ _delayed_reference_info{ std::move(ref_id_expr) } }
             {
             }
 
-            delayed_variable(std::vector<std::u32string> type_name, std::vector<std::shared_ptr<variable>> arguments) : variable{ nullptr }, _state{ _delayed_type_info{ std::move(type_name), std::move(arguments) } }
+            delayed_variable(std::vector<symbol> type_name, std::vector<std::shared_ptr<variable>> arguments) : variable{ nullptr }, _state{ _delayed_type_info{ std::move(type_name), std::move(arguments) } }
             {
             }
 
@@ -47,29 +49,83 @@ namespace reaver
             {
             }
 
+            // a thunk; the expression is only analyzed once something needs its value
+            delayed_variable(std::shared_ptr<const parsed_buildfile> buildfile, const expression & expr) : variable{ nullptr }, _state{ _thunk_info{ std::move(buildfile), &expr } }
+            {
+            }
+
             virtual type_identifier type() const override
             {
                 if (_state.index() == 0)
                 {
-                    return get<0>(_state)->type();
+                    return _resolved()->type();
                 }
 
                 return nullptr;
             }
 
+            // null if the variable isn't a delayed_variable; only those are constructed without a type, so this needs no RTTI
+            static delayed_variable * as_delayed(variable * var)
+            {
+                return var && var->_type_id == nullptr ? static_cast<delayed_variable *>(var) : nullptr;
+            }
+
+            static std::shared_ptr<delayed_variable> as_delayed(const std::shared_ptr<variable> & var)
+            {
+                return as_delayed(var.get()) ? std::static_pointer_cast<delayed_variable>(var) : nullptr;
+            }
+
+            bool resolved() const
+            {
+                return _state.index() == 0;
+            }
+
+            // doesn't touch ctx.unresolved, other than through analyzing the expression of a thunk; keeping track of what is left is up to the caller
             bool try_resolve(semantic_context & ctx);
 
-            virtual std::shared_ptr<target> as_target() override
+            // the unresolved variable this one is waiting on, at the end of its chain of references; null when this can be tried right away
+            // a reference waits for the variable it refers to, so chains of references are resolved from their end, and whatever waits on them is only woken once
+            // a resolved variable waits for what it resolved to, when that isn't resolved yet, like the value of a thunk that was just forced
+            std::shared_ptr<delayed_variable> pending_dependency(const semantic_context & ctx) const;
+
+            // the name this looks up, if it's a reference or an instantiation of a type named in the buildfile; empty otherwise
+            std::vector<symbol> looked_up_name() const;
+
+            // the expression of a thunk that hasn't been forced yet; null otherwise
+            const expression * thunk() const;
+
+            // points every link of the chain of resolved delayed variables starting here straight at its end, so that it's only walked once
+            // writes to the links, so it's only done by resolve, while nothing else can be looking at them
+            void compress();
+
+            using variable::add_property;
+            using variable::get_property;
+
+            virtual void add_property(symbol name, std::shared_ptr<variable> value) override
             {
-                return get<0>(fmap(_state, make_overload_set(
-                    [&](const std::shared_ptr<variable> & resolved) {
-                        return resolved->as_target();
-                    },
+                if (_state.index() == 0)
+                {
+                    _resolved()->add_property(name, std::move(value));
+                    return;
+                }
+
+                variable::add_property(name, std::move(value));
+            }
+
+            virtual std::shared_ptr<variable> get_property(symbol name) const override
+            {
+                if (_state.index() == 0)
+                {
+                    return _resolved()->get_property(name);
+                }
 
-                    [&](const auto &) -> std::shared_ptr<target> {
-                        assert(!"");
-                    }
-                )));
+                return variable::get_property(name);
+            }
+
+            virtual std::shared_ptr<target> as_target() override
+            {
+                assert(_state.index() == 0);
+                return _resolved()->as_target();
             }
 
         protected:
@@ -77,11 +133,7 @@ namespace reaver
             {
                 if (_state.index() == 0)
                 {
-                    if (auto nested = std::dynamic_pointer_cast<delayed_variable>(get<0>(_state)))
-                    {
-                        return nested->_shared_this();
-                    }
-                    return get<0>(_state);
+                    return _resolved();
                 }
 
                 return shared_from_this();
@@ -91,17 +143,20 @@ namespace reaver
             {
                 if (_state.index() == 0)
                 {
-                    if (auto nested = std::dynamic_pointer_cast<delayed_variable>(get<0>(_state)))
-                    {
-                        return nested->_shared_this();
-                    }
-                    return get<0>(_state);
+                    return _resolved();
                 }
 
                 return shared_from_this();
             }
 
         private:
+            // the unresolved variable at the end of the chain of references starting at `var`; null if `var` has a type
+            static std::shared_ptr<delayed_variable> _pending(const std::shared_ptr<variable> & var);
+
+            // for resolved variables; what they resolved to, following resolved delayed variables until the first that isn't one
+            // only reads, as it's reachable from the workers of a build; see compress
+            const std::shared_ptr<variable> & _resolved() const;
+
             struct _delayed_instantiation_info
             {
                 type_identifier actual_type;
@@ -110,12 +165,12 @@ namespace reaver
 
             struct _delayed_reference_info
             {
-                std::vector<std::u32string> referenced_id_expression;
+                std::vector<symbol> referenced_id_expression;
             };
 
             struct _delayed_type_info
             {
-                std::vector<std::u32string> type_name;
+                std::vector<symbol> type_name;
                 std::vector<std::shared_ptr<variable>> arguments;
             };
 
@@ -126,12 +181,19 @@ namespace reaver
                 operation_type operation;
             };
 
+            struct _thunk_info
+            {
+                std::shared_ptr<const parsed_buildfile> buildfile;
+                const expression * expr;
+            };
+
             variant<
                 std::shared_ptr<variable>,
                 _delayed_instantiation_info,
                 _delayed_reference_info,
                 _delayed_type_info,
-                _delayed_operation_info
+                _delayed_operation_info,
+                _thunk_info
             > _state;
         };
     }}
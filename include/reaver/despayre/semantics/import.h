@@ -20,6 +20,8 @@
  *
  **/
 
+#pragma once
+
 #include <reaver/plugin.h>
 
 #include "variable.h"
@@ -36,26 +38,44 @@ namespace reaver
         class plugin_namespace : public variable
         {
         public:
-            plugin_namespace(std::shared_ptr<plugin> plugin) : variable{ get_type_identifier<plugin_namespace>() }, _plugin{ std::move(plugin) }
+            plugin_namespace(std::shared_ptr<plugin> plugin, std::u32string name, std::shared_ptr<variable> arguments)
+                : variable{ get_type_identifier<plugin_namespace>() }, _plugin{ std::move(plugin) }, _name{ std::move(name) }, _arguments{ std::move(arguments) }
+            {
+            }
+
+            const std::u32string & name() const
+            {
+                return _name;
+            }
+
+            const std::shared_ptr<variable> & arguments() const
             {
+                return _arguments;
             }
 
         private:
             std::shared_ptr<plugin> _plugin;
+            std::u32string _name;
+            std::shared_ptr<variable> _arguments;
         };
 
-        auto generate_import(semantic_context & ctx)
+        inline std::shared_ptr<plugin_namespace> import_plugin(semantic_context & ctx, std::u32string name, std::shared_ptr<variable> arguments)
+        {
+            auto plugin = open_library("despayre." + utf8(name));
+            plugin->get_symbol<void (semantic_context &)>("init_semantic")(ctx);
+            ctx.plugin_initializers.insert({ { plugin, "init_runtime" }, arguments });
+
+            return std::make_shared<plugin_namespace>(std::move(plugin), std::move(name), std::move(arguments));
+        }
+
+        inline auto generate_import(semantic_context & ctx)
         {
-            return [&ctx](std::vector<std::shared_ptr<variable>> args)
+            return [&ctx](std::vector<std::shared_ptr<variable>> args) -> std::shared_ptr<variable>
             {
                 assert(args.size() == 2);
                 assert(args[0]->type() == get_type_identifier<string>());
 
-                auto plugin = open_library("despayre." + utf8(args[0]->as<string>()->value()));
-                plugin->get_symbol<void (semantic_context &)>("init_semantic")(ctx);
-                ctx.plugin_initializers.insert({ { plugin, "init_runtime" }, args[1] });
-
-                return std::make_shared<plugin_namespace>(std::move(plugin));
+                return import_plugin(ctx, args[0]->as<string>()->value(), args[1]);
             };
         }
     }}
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "variable.h"
+#include "symbol_map.h"
 
 namespace reaver
 {
@@ -36,28 +37,35 @@ namespace reaver
             {
             }
 
-            virtual void add_property(std::u32string name, std::shared_ptr<variable> value) override
+            using variable::add_property;
+            using variable::get_property;
+
+            virtual void add_property(symbol name, std::shared_ptr<variable> value) override
             {
-                auto & variable = _map[std::move(name)];
-                if (variable)
+                if (!_members.emplace(name, std::move(value)))
                 {
                     assert(!"do something in this case");
                 }
-                variable = std::move(value);
             }
 
-            virtual std::shared_ptr<variable> get_property(const std::u32string & name) const override
+            virtual std::shared_ptr<variable> get_property(symbol name) const override
             {
-                auto it = _map.find(name);
-                if (it == _map.end())
+                auto member = _members.find(name);
+                if (!member)
                 {
                     return nullptr;
                 }
-                return it->second;
+                return *member;
+            }
+
+            // in the order they were added
+            const symbol_map<std::shared_ptr<variable>> & properties() const
+            {
+                return _members;
             }
 
         private:
-            std::unordered_map<std::u32string, std::shared_ptr<variable>> _map;
+            symbol_map<std::shared_ptr<variable>> _members;
         };
     }}
 }
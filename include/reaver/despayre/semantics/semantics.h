@@ -29,9 +29,35 @@ namespace reaver
 {
     namespace despayre { inline namespace _v1
     {
-        semantic_context analyze(const std::vector<assignment> & parse_tree);
-        std::shared_ptr<variable> analyze_expression(semantic_context & ctx, const expression & expr);
-        std::shared_ptr<variable> analyze_simple_expression(semantic_context & ctx, const simple_expression & expr);
+        enum class evaluation
+        {
+            // every assignment is analyzed, and every variable resolved, before analyze returns
+            eager,
+            // assignments are bound to thunks, analyzed only once they are forced; imports are analyzed right away
+            lazy
+        };
+
+        // the parse tree thunks refer to; kept alive by them for as long as any is left
+        struct parsed_buildfile
+        {
+            arena nodes;
+            parse_tree tree;
+        };
+
+        // the globs of the buildfile are walked with `options`
+        semantic_context analyze(const parse_tree & tree, glob_options options = {});
+        // eagerly, parses and analyzes the assignments one at a time, so the whole parse tree never exists at once
+        semantic_context analyze(token_stream tokens, evaluation mode = evaluation::eager, glob_options options = {});
+
+        void analyze_assignment(semantic_context & ctx, const std::vector<token> & tokens, const assignment & assignment);
+        std::shared_ptr<variable> analyze_expression(semantic_context & ctx, const std::vector<token> & tokens, const expression & expr);
+        std::shared_ptr<variable> analyze_simple_expression(semantic_context & ctx, const std::vector<token> & tokens, const simple_expression & expr);
+        // resolves the variables whose values weren't known when they were analyzed; throws if any remain unresolved
+        void resolve(semantic_context & ctx);
+        // forces the thunk, and resolves everything its value depends on; a no-op for anything else; throws like resolve
+        void force(semantic_context & ctx, const std::shared_ptr<variable> & var);
+        // the same, for every thunk in the namespace and in the namespaces nested in it
+        void force_all(semantic_context & ctx, const std::shared_ptr<variable> & var);
         void register_builtins(semantic_context & ctx);
     }}
 }
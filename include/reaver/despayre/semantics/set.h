@@ -36,7 +36,23 @@ namespace reaver
         public:
             set(std::unordered_set<std::shared_ptr<variable>> variables) : clone_wrapper<set>{ get_type_identifier<set>() }, _value{ std::move(variables) }
             {
-                _add_addition(get_type_identifier<set>(), [](_op_arg lhs, _op_arg rhs) -> std::shared_ptr<variable> {
+            }
+
+            const std::unordered_set<std::shared_ptr<variable>> & value() const
+            {
+                return _value;
+            }
+
+        private:
+            std::unordered_set<std::shared_ptr<variable>> _value;
+        };
+
+        namespace _detail
+        {
+            static auto _register_set = once([]{ create_type<set>(U"set", "<builtin>", nullptr); });
+
+            static auto _register_set_operators = once([]{
+                register_operator(operation_type::addition, get_type_identifier<set>(), get_type_identifier<set>(), [](std::shared_ptr<variable> lhs, std::shared_ptr<variable> rhs) -> std::shared_ptr<variable> {
                     auto & lhs_set = lhs->as<set>()->value();
                     auto & rhs_set = rhs->as<set>()->value();
 
@@ -46,7 +62,7 @@ namespace reaver
                     return std::make_shared<set>(std::move(result));
                 });
 
-                _add_removal(get_type_identifier<set>(), [](_op_arg lhs, _op_arg rhs) -> std::shared_ptr<variable> {
+                register_operator(operation_type::removal, get_type_identifier<set>(), get_type_identifier<set>(), [](std::shared_ptr<variable> lhs, std::shared_ptr<variable> rhs) -> std::shared_ptr<variable> {
                     auto & lhs_set = lhs->as<set>()->value();
                     auto & rhs_set = rhs->as<set>()->value();
 
@@ -55,20 +71,7 @@ namespace reaver
                     std::set_difference(lhs_set.begin(), lhs_set.end(), rhs_set.begin(), rhs_set.end(), std::inserter(result, result.begin()));
                     return std::make_shared<set>(std::move(result));
                 });
-            }
-
-            const std::unordered_set<std::shared_ptr<variable>> & value() const
-            {
-                return _value;
-            }
-
-        private:
-            std::unordered_set<std::shared_ptr<variable>> _value;
-        };
-
-        namespace _detail
-        {
-            static auto _register_set = once([]{ create_type<set>(U"set", "<builtin>", nullptr); });
+            });
         }
     }}
 }
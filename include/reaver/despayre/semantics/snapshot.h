@@ -0,0 +1,46 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+
+#include <boost/filesystem.hpp>
+
+#include <reaver/optional.h>
+
+#include "context.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // the analyzed graph of a buildfile, stored so that later runs can skip parsing and analysis
+        // a snapshot is only valid for the same buildfile contents (compared by hash) and while every directory
+        // a glob looked at during analysis keeps its modification time, as that's what decides what the globs match
+        // returns false when the graph contains variables of types that can't be stored (like ones defined by plugins)
+        bool save_snapshot(const semantic_context & ctx, const boost::filesystem::path & path, std::uint64_t buildfile_hash);
+        // imported plugins are loaded again; returns none when there's no valid snapshot
+        // the options are for the globs of the loaded graph; the walks the snapshot holds were made with the same ones, as they're part of the hash
+        optional<semantic_context> load_snapshot(const boost::filesystem::path & path, std::uint64_t buildfile_hash, glob_options options = {});
+    }}
+}
@@ -35,12 +35,6 @@ namespace reaver
         public:
             string(std::u32string value) : variable{ get_type_identifier<string>() }, _value{ std::move(value) }
             {
-                _add_addition(get_type_identifier<string>(), [](_op_arg lhs, _op_arg rhs) -> std::shared_ptr<variable> {
-                    auto lhs_string = lhs->as<string>();
-                    auto rhs_string = rhs->as<string>();
-
-                    return std::make_shared<string>(lhs_string->value() + rhs_string->value());
-                });
             }
 
             string(const string &) = default;
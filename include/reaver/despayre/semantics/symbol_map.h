@@ -0,0 +1,161 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../parser/symbol.h"
+
+namespace reaver
+{
+    namespace despayre { inline namespace _v1
+    {
+        // a map from symbols that keeps its entries in a single vector, in the order they were added, and finds them through a linearly probed index
+        // namespaces mostly have a handful of members; for those the index is 8 slots of 4 bytes, and a lookup is a couple of loads
+        // entries can't be removed, which keeps the index free of tombstones
+        template<typename T>
+        class symbol_map
+        {
+        public:
+            using value_type = std::pair<symbol, T>;
+            using const_iterator = typename std::vector<value_type>::const_iterator;
+
+            T * find(symbol name)
+            {
+                auto index = _find(name);
+                return index == _npos ? nullptr : &_entries[index].second;
+            }
+
+            const T * find(symbol name) const
+            {
+                auto index = _find(name);
+                return index == _npos ? nullptr : &_entries[index].second;
+            }
+
+            // leaves the map as it was, and returns false, if the name is already there
+            bool emplace(symbol name, T value)
+            {
+                if (_find(name) != _npos)
+                {
+                    return false;
+                }
+
+                _entries.emplace_back(name, std::move(value));
+
+                if (_entries.size() * 4 > _index.size() * 3)
+                {
+                    _rehash();
+                }
+                else
+                {
+                    _insert_index(_entries.size() - 1);
+                }
+
+                return true;
+            }
+
+            std::size_t size() const
+            {
+                return _entries.size();
+            }
+
+            bool empty() const
+            {
+                return _entries.empty();
+            }
+
+            const_iterator begin() const
+            {
+                return _entries.begin();
+            }
+
+            const_iterator end() const
+            {
+                return _entries.end();
+            }
+
+        private:
+            static constexpr std::uint32_t _npos = ~std::uint32_t{};
+
+            // symbol ids are dense, so they need mixing before their top bits are any good
+            std::size_t _slot(symbol name) const
+            {
+                return static_cast<std::uint32_t>(name.id() * 2654435769u) >> _shift;
+            }
+
+            std::uint32_t _find(symbol name) const
+            {
+                if (_index.empty())
+                {
+                    return _npos;
+                }
+
+                auto mask = _index.size() - 1;
+                for (auto slot = _slot(name); _index[slot] != _npos; slot = (slot + 1) & mask)
+                {
+                    if (_entries[_index[slot]].first == name)
+                    {
+                        return _index[slot];
+                    }
+                }
+
+                return _npos;
+            }
+
+            void _insert_index(std::uint32_t entry)
+            {
+                auto mask = _index.size() - 1;
+                auto slot = _slot(_entries[entry].first);
+                while (_index[slot] != _npos)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                _index[slot] = entry;
+            }
+
+            void _rehash()
+            {
+                std::size_t capacity = 8;
+                _shift = 29;
+                while (_entries.size() * 2 > capacity)
+                {
+                    capacity *= 2;
+                    --_shift;
+                }
+
+                _index.assign(capacity, _npos);
+                for (std::uint32_t i = 0; i < _entries.size(); ++i)
+                {
+                    _insert_index(i);
+                }
+            }
+
+            std::vector<value_type> _entries;
+            // positions of the entries, by the top bits of their mixed ids; at most 3/4 full
+            std::vector<std::uint32_t> _index;
+            std::uint32_t _shift = 32;
+        };
+    }}
+}
@@ -34,25 +34,95 @@ namespace reaver
         class target : public variable
         {
         public:
+            friend class job_scheduler;
+
             target(type_identifier type_id) : variable{ type_id }
             {
             }
 
-            virtual bool built(context_ptr ctx)
+            // true when the target and everything it depends on is up to date
+            // the state of the whole subgraph is evaluated once per build and remembered in the runtime context
+            bool built(context_ptr ctx)
+            {
+                return _evaluate(ctx, _shared_this()->as_target());
+            }
+
+            future<> build(context_ptr ctx)
             {
-                for (auto && dep : dependencies(ctx))
+                if (built(ctx))
                 {
-                    if (!dep->built(ctx))
-                    {
-                        return false;
-                    }
+                    return make_ready_future();
                 }
 
+                return ctx->scheduler.schedule(ctx, _shared_this()->as_target());
+            }
+
+            virtual const std::vector<std::shared_ptr<target>> & dependencies(context_ptr)
+            {
+                static std::vector<std::shared_ptr<target>> empty;
+                return empty;
+            }
+
+            virtual const std::vector<linker_capability> & linker_caps(context_ptr)
+            {
+                static std::vector<linker_capability> empty;
+                return empty;
+            }
+
+            virtual void invalidate()
+            {
+            }
+
+            virtual std::vector<boost::filesystem::path> inputs(context_ptr)
+            {
+                return {};
+            }
+
+            virtual std::vector<boost::filesystem::path> outputs(context_ptr)
+            {
+                return {};
+            }
+
+        protected:
+            virtual void _build(context_ptr) = 0;
+
+            // identifies the command that produces the outputs; a change forces a rebuild even when the inputs are unchanged
+            // 0 means there's nothing to compare
+            virtual std::uint64_t _command_signature(context_ptr)
+            {
+                return 0;
+            }
+
+            // the inputs known before building; inputs() can also list ones only discovered by building, like included headers
+            virtual std::vector<boost::filesystem::path> _declared_inputs(context_ptr ctx)
+            {
+                return inputs(ctx);
+            }
+
+            // whether _build_remote can hand the work over to remote workers
+            virtual bool _remote_capable(context_ptr)
+            {
+                return false;
+            }
+
+            virtual void _build_remote(context_ptr ctx)
+            {
+                _build(ctx);
+            }
+
+            // called instead of _build when the outputs were restored from a cache; inputs are the ones the cached build discovered
+            virtual void _restored(context_ptr, std::vector<boost::filesystem::path>)
+            {
+            }
+
+            // checks only the target's own outputs against its own inputs; dependencies are handled by _evaluate
+            virtual bool _up_to_date(context_ptr ctx)
+            {
                 auto outs = outputs(ctx);
 
                 for (auto && output : outs)
                 {
-                    if (!boost::filesystem::exists(output))
+                    if (!ctx->file_status.exists(output))
                     {
                         return false;
                     }
@@ -67,77 +137,167 @@ namespace reaver
                         assert(ins.empty());
                     }
 
-                    for (auto && out : outs)
+                    return true;
+                }
+
+                auto record = ctx->build_log.find(outs.front());
+                auto signature = _command_signature(ctx);
+
+                // a record without a signature predates signatures (or comes from a target that can't provide one)
+                if (record && record->command_signature && record->command_signature != signature)
+                {
+                    return false;
+                }
+
+                if (record && record->hashed && ctx->content_hashes.enabled())
+                {
+                    if (record->inputs.size() != ins.size())
                     {
-                        if (!boost::filesystem::exists(out))
+                        return false;
+                    }
+
+                    for (auto i = 0ull; i < ins.size(); ++i)
+                    {
+                        if (record->inputs[i].path != ins[i] || record->inputs[i].hash != ctx->content_hashes.hash(ctx->file_status, ins[i]))
                         {
                             return false;
                         }
                     }
 
+                    // the output was overwritten (or damaged) since it was built
+                    if (record->output_hash != ctx->content_hashes.hash(ctx->file_status, outs.front()))
+                    {
+                        return false;
+                    }
+
+                    if (signature && !record->command_signature)
+                    {
+                        _record(ctx, outs, ins, signature, record->duration);
+                    }
+
                     return true;
                 }
 
-                auto input_times = fmap(ins, [](auto && path) {
-                    return boost::filesystem::last_write_time(path);
+                auto input_times = fmap(ins, [&](auto && path) {
+                    return ctx->file_status.last_write_time(path);
                 });
-                auto output_times = fmap(outs, [](auto && path) {
-                    return boost::filesystem::last_write_time(path);
+                auto output_times = fmap(outs, [&](auto && path) {
+                    return ctx->file_status.last_write_time(path);
                 });
 
-                return *std::max_element(input_times.begin(), input_times.end()) <= *std::min_element(output_times.begin(), output_times.end());
+                auto up_to_date = *std::max_element(input_times.begin(), input_times.end()) <= *std::min_element(output_times.begin(), output_times.end());
+
+                // the outputs are known to match the inputs, but the log doesn't know as much as it could; remember that
+                if (up_to_date && (!record || (signature && !record->command_signature) || (ctx->content_hashes.enabled() && !record->hashed)))
+                {
+                    _record(ctx, outs, ins, signature, record ? record->duration : 0);
+                }
+
+                return up_to_date;
             }
 
-            future<> build(context_ptr ctx)
+            // called by the scheduler once _build returns; duration is in microseconds, started is on the scale of current_file_time()
+            // returns false when the outputs can't be trusted, because an input was modified while the target was being built
+            bool _after_build(const context_ptr & ctx, std::uint64_t duration, std::int64_t started)
             {
-                if (built(ctx))
+                auto outs = outputs(ctx);
+                for (auto && output : outs)
                 {
-                    return make_ready_future();
+                    ctx->file_status.invalidate(output);
                 }
 
-                auto this_target = _shared_this()->as_target();
+                // targets without inputs of their own (like `files`) only forward the outputs of their dependencies
+                auto ins = outs.empty() ? std::vector<boost::filesystem::path>{} : inputs(ctx);
+
+                if (_modified_since(ctx, ins, started))
+                {
+                    // the build may or may not have seen the modification; make the outputs look older than it, so that the next build redoes the work
+                    for (auto && output : outs)
+                    {
+                        if (ctx->file_status.exists(output))
+                        {
+                            set_last_write_time(output, started - 1);
+                            ctx->file_status.invalidate(output);
+                        }
+                    }
 
-                ctx->futures_lock.lock();
-                auto & build_future = ctx->build_futures[this_target];
-                ctx->futures_lock.unlock();
+                    ctx->target_states.set(_shared_this()->as_target(), target_state::dirty);
+                    return false;
+                }
 
-                if (!build_future)
+                if (!ins.empty())
                 {
-                    build_future = when_all(fmap(dependencies(ctx), [ctx](auto && dep){ return dep->build(ctx); }))
-                        .then([this_target, ctx](){ this_target->_build(ctx); });
+                    _record(ctx, outs, ins, _command_signature(ctx), duration);
                 }
 
-                return *build_future;
+                ctx->target_states.set(_shared_this()->as_target(), target_state::built);
+                return true;
             }
 
-            virtual const std::vector<std::shared_ptr<target>> & dependencies(context_ptr)
+            // inputs looked at before the build are compared with what was seen then; ones discovered by it, with the time it started
+            static bool _modified_since(const context_ptr & ctx, const std::vector<boost::filesystem::path> & ins, std::int64_t started)
             {
-                static std::vector<std::shared_ptr<target>> empty;
-                return empty;
-            }
+                for (auto && input : ins)
+                {
+                    auto current = stat_file(input);
+                    if (auto seen = ctx->file_status.cached(input))
+                    {
+                        if (current.exists != seen->exists || current.last_write_time != seen->last_write_time || current.size != seen->size || current.inode != seen->inode)
+                        {
+                            return true;
+                        }
+                    }
+                    else if (current.last_write_time >= started)
+                    {
+                        return true;
+                    }
+                }
 
-            virtual const std::vector<linker_capability> & linker_caps(context_ptr)
-            {
-                static std::vector<linker_capability> empty;
-                return empty;
+                return false;
             }
 
-            virtual void invalidate()
+            // outputs are recorded in the build log under the first one
+            void _record(const context_ptr & ctx, const std::vector<boost::filesystem::path> & outs, const std::vector<boost::filesystem::path> & ins, std::uint64_t signature, std::uint64_t duration)
             {
-            }
+                build_log::record record;
+                record.command_signature = signature;
+                record.hashed = ctx->content_hashes.enabled();
+                record.duration = duration;
+                record.inputs = fmap(ins, [&](auto && input) {
+                    return build_log::input{ input, record.hashed ? ctx->content_hashes.hash(ctx->file_status, input) : 0 };
+                });
 
-            virtual std::vector<boost::filesystem::path> inputs(context_ptr)
-            {
-                return {};
+                if (record.hashed)
+                {
+                    record.output_hash = ctx->content_hashes.hash(ctx->file_status, outs.front());
+                }
+
+                ctx->build_log.add(outs.front(), std::move(record));
             }
 
-            virtual std::vector<boost::filesystem::path> outputs(context_ptr)
+            // post-order walk that records the state of every target it reaches,
+            // so each target is checked at most once per build no matter how many paths lead to it
+            static bool _evaluate(const context_ptr & ctx, const std::shared_ptr<target> & target)
             {
-                return {};
-            }
+                if (auto state = ctx->target_states.get(target))
+                {
+                    return *state == target_state::built;
+                }
 
-        protected:
-            virtual void _build(context_ptr) = 0;
+                bool built = true;
+                for (auto && dep : target->dependencies(ctx))
+                {
+                    if (!_evaluate(ctx, dep))
+                    {
+                        built = false;
+                    }
+                }
+
+                built = built && target->_up_to_date(ctx);
+                ctx->target_states.set(target, built ? target_state::built : target_state::dirty);
+
+                return built;
+            }
         };
     }}
 }
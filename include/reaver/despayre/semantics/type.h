@@ -67,7 +67,7 @@ namespace reaver
 
         namespace _detail
         {
-            void _save_identifier(semantic_context & ctx, const std::vector<std::u32string> & name, type_identifier id);
+            void _save_identifier(semantic_context & ctx, const std::vector<symbol> & name, type_identifier id);
             void _save_descriptor(semantic_context & ctx, type_identifier id, std::u32string name, std::string source_module, constructor type_constructor);
         }
 
@@ -84,7 +84,7 @@ namespace reaver
         };
 
         template<typename Tag>
-        type_identifier create_type(semantic_context & ctx, std::u32string full_name, std::vector<std::u32string> name, std::string source_module, constructor type_constructor)
+        type_identifier create_type(semantic_context & ctx, std::u32string full_name, std::vector<symbol> name, std::string source_module, constructor type_constructor)
         {
             auto id = get_type_identifier<Tag>();
 
@@ -104,10 +104,16 @@ namespace reaver
             // TODO: need better split
             boost::algorithm::split(split, name, boost::is_any_of(U"."));
 
-            return create_type<Tag>(ctx, std::move(name), std::move(split), std::move(source_module), std::move(type_constructor));
+            std::vector<symbol> symbols;
+            for (auto && part : split)
+            {
+                symbols.push_back(intern(part));
+            }
+
+            return create_type<Tag>(ctx, std::move(name), std::move(symbols), std::move(source_module), std::move(type_constructor));
         }
 
-        std::shared_ptr<variable> instantiate(const semantic_context & ctx, const std::vector<std::u32string> & name, std::vector<std::shared_ptr<variable>> variables);
+        std::shared_ptr<variable> instantiate(const semantic_context & ctx, const std::vector<symbol> & name, std::vector<std::shared_ptr<variable>> variables);
         std::shared_ptr<variable> instantiate(const semantic_context & ctx, type_identifier type, std::vector<std::shared_ptr<variable>> variables);
     }}
 }
@@ -40,23 +40,23 @@ namespace reaver
         class invalid_add_property : public exception
         {
         public:
-            invalid_add_property(std::u32string name) : exception{ logger::error }, name{ std::move(name) }
+            invalid_add_property(symbol name) : exception{ logger::error }, name{ name }
             {
-                *this << "failed to add property `" << utf8(name) << " `to a variable.";
+                *this << "failed to add property `" << name.string().to_string() << " `to a variable.";
             }
 
-            std::u32string name;
+            symbol name;
         };
 
         class invalid_get_property : public exception
         {
         public:
-            invalid_get_property(std::u32string name) : exception{ logger::error }, name{ std::move(name) }
+            invalid_get_property(symbol name) : exception{ logger::error }, name{ name }
             {
-                *this << "failed to get property `" << utf8(name) << " `from a variable.";
+                *this << "failed to get property `" << name.string().to_string() << " `from a variable.";
             }
 
-            std::u32string name;
+            symbol name;
         };
 
         class delayed_variable;
@@ -65,6 +65,12 @@ namespace reaver
         std::shared_ptr<variable> delayed_addition(std::shared_ptr<variable> lhs, std::shared_ptr<variable> rhs);
         std::shared_ptr<variable> delayed_removal(std::shared_ptr<variable> lhs, std::shared_ptr<variable> rhs);
 
+        // the binary operators are looked up by the types of both operands, in a table shared by all variables
+        // the handlers are registered once per pair of types, usually by a static initializer next to the type; there's no need to register the ones for unresolved operands
+        using operator_handler = std::shared_ptr<variable> (std::shared_ptr<variable>, std::shared_ptr<variable>);
+        void register_operator(operation_type operation, type_identifier lhs, type_identifier rhs, operator_handler * handler);
+        operator_handler * find_operator(operation_type operation, type_identifier lhs, type_identifier rhs);
+
         // ...in Vapor this will be a typeclass
         // ...but doing that kind of thing in C++ manually is troublesome
         // and I really don't want to dive into boost.type_erasure or some other dark magic library right now
@@ -75,8 +81,6 @@ namespace reaver
 
             variable(type_identifier type_id) : _type_id{ type_id }
             {
-                _add_addition(nullptr, delayed_addition);
-                _add_removal(nullptr, delayed_removal);
             }
 
             virtual ~variable() = default;
@@ -94,7 +98,8 @@ namespace reaver
                     throw std::bad_cast{};
                 }
 
-                return std::dynamic_pointer_cast<T>(_shared_this());
+                // every variable is constructed with the identifier of its own class, so the check above is all the checking the cast needs
+                return std::static_pointer_cast<T>(_shared_this());
             }
 
             template<typename T>
@@ -105,7 +110,7 @@ namespace reaver
                     throw std::bad_cast{};
                 }
 
-                return std::dynamic_pointer_cast<const T>(_shared_this());
+                return std::static_pointer_cast<const T>(_shared_this());
             }
 
             virtual std::shared_ptr<target> as_target();
@@ -113,45 +118,40 @@ namespace reaver
             std::shared_ptr<variable> operator+(std::shared_ptr<variable> other);
             std::shared_ptr<variable> operator-(std::shared_ptr<variable> other);
 
-            virtual void add_property(std::u32string name, std::shared_ptr<variable> value)
+            virtual void add_property(symbol name, std::shared_ptr<variable> value)
             {
-                throw invalid_add_property{ std::move(name) };
+                throw invalid_add_property{ name };
             }
 
-            virtual std::shared_ptr<variable> get_property(const std::u32string & name) const
+            virtual std::shared_ptr<variable> get_property(symbol name) const
             {
                 throw invalid_get_property{ name };
             }
 
-        protected:
-            using _op_arg = std::shared_ptr<variable>;
-            using _operator_type = std::shared_ptr<variable> (_op_arg, _op_arg);
-
-            virtual std::shared_ptr<variable> _shared_this()
+            // for names that don't come from the parser, like the ones plugins look up; derived classes need to pull these in with a using declaration
+            void add_property(std::experimental::u32string_view name, std::shared_ptr<variable> value)
             {
-                return shared_from_this();
+                add_property(intern(name), std::move(value));
             }
 
-            virtual std::shared_ptr<const variable> _shared_this() const
+            std::shared_ptr<variable> get_property(std::experimental::u32string_view name) const
             {
-                return shared_from_this();
+                return get_property(intern(name));
             }
 
-            void _add_addition(type_identifier other_id, _operator_type handler)
+        protected:
+            virtual std::shared_ptr<variable> _shared_this()
             {
-                _operator_plus_call_table.emplace(other_id, handler);
+                return shared_from_this();
             }
 
-            void _add_removal(type_identifier other_id, _operator_type handler)
+            virtual std::shared_ptr<const variable> _shared_this() const
             {
-                _operator_minus_call_table.emplace(other_id, handler);
+                return shared_from_this();
             }
 
         private:
             type_identifier _type_id;
-
-            std::unordered_map<type_identifier, _operator_type *> _operator_plus_call_table;
-            std::unordered_map<type_identifier, _operator_type *> _operator_minus_call_table;
         };
 
         class type_descriptor_variable : public variable
@@ -212,27 +212,37 @@ namespace reaver
             };
         }
 
-        template<typename Type, typename F>
-        decltype(auto) type_dispatch(std::shared_ptr<variable> var, id<Type>, F && callback)
+        namespace _detail
         {
-            if (var->type() == get_type_identifier<Type>())
+            template<typename Type, typename F>
+            decltype(auto) _type_dispatch(std::shared_ptr<variable> var, type_identifier type, id<Type>, F && callback)
             {
-                return std::forward<F>(callback)(var->as<Type>());
-            }
+                if (type == get_type_identifier<Type>())
+                {
+                    return std::forward<F>(callback)(var->as<Type>());
+                }
 
-            assert(!"invalid dispatch");
-        }
+                assert(!"invalid dispatch");
+            }
 
-        template<typename Type, typename F, typename... Tail, typename std::enable_if<(sizeof...(Tail) > 0), int>::type = 0>
-        decltype(auto) type_dispatch(std::shared_ptr<variable> var, id<Type>, F && head_callback, Tail &&... tail)
-        {
-            if (var->type() == get_type_identifier<Type>())
+            template<typename Type, typename F, typename... Tail, typename std::enable_if<(sizeof...(Tail) > 0), int>::type = 0>
+            decltype(auto) _type_dispatch(std::shared_ptr<variable> var, type_identifier type, id<Type>, F && head_callback, Tail &&... tail)
             {
-                return std::forward<F>(head_callback)(var->as<Type>());
+                if (type == get_type_identifier<Type>())
+                {
+                    return std::forward<F>(head_callback)(var->as<Type>());
+                }
+
+                return _type_dispatch(std::move(var), type, std::forward<Tail>(tail)...);
             }
+        }
 
-            return type_dispatch(std::move(var), std::forward<Tail>(tail)...);
+        // the type of the variable is only asked for once, however many alternatives there are
+        template<typename... Args>
+        decltype(auto) type_dispatch(std::shared_ptr<variable> var, Args &&... args)
+        {
+            auto type = var->type();
+            return _detail::_type_dispatch(std::move(var), type, std::forward<Args>(args)...);
         }
     }}
 }
-
@@ -20,16 +20,189 @@
  *
  **/
 
+#include <csignal>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include <boost/locale.hpp>
 
+#include <pthread.h>
+
 #include "despayre.h"
+#include "despayre/runtime/daemon.h"
+#include "despayre/runtime/watch.h"
 
 int main(int argc, char ** argv) try
 {
-    auto context = reaver::despayre::despayre{ "./buildfile" };
-    context.build(argv[1], argv[2]);
+    reaver::despayre::daemon_request request;
+    request.jobs = reaver::despayre::default_job_count();
+    bool serve = false;
+    bool watch = false;
+    bool use_daemon = false;
+    auto evaluation = reaver::despayre::evaluation::eager;
+    std::vector<std::string> positional;
+    reaver::optional<std::size_t> remote_jobs;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--stats")
+        {
+            request.stats = true;
+            continue;
+        }
+
+        if (arg == "--content-hashes")
+        {
+            request.content_hashes = true;
+            continue;
+        }
+
+        if (arg == "--serve")
+        {
+            serve = true;
+            continue;
+        }
+
+        if (arg == "--watch")
+        {
+            watch = true;
+            continue;
+        }
+
+        // opt-in; the build falls back to this process when no daemon is serving the directory
+        if (arg == "--daemon")
+        {
+            use_daemon = true;
+            continue;
+        }
+
+        // the daemon keeps the whole graph around for every target anyway, so this only applies to builds in this process
+        if (arg == "--lazy")
+        {
+            evaluation = reaver::despayre::evaluation::lazy;
+            continue;
+        }
+
+        if (arg == "--remote-cache")
+        {
+            if (++i == argc)
+            {
+                throw reaver::exception{ reaver::logger::fatal } << "`--remote-cache` requires a socket path.";
+            }
+
+            request.remote_cache = argv[i];
+            continue;
+        }
+
+        if (arg == "--worker" || arg == "--remote-jobs")
+        {
+            if (++i == argc)
+            {
+                throw reaver::exception{ reaver::logger::fatal } << "`" << arg << "` requires an argument.";
+            }
+
+            if (arg == "--worker")
+            {
+                request.workers.push_back(argv[i]);
+            }
+            else
+            {
+                remote_jobs = std::stoull(argv[i]);
+            }
+            continue;
+        }
+
+        if (arg.compare(0, 2, "-j") == 0)
+        {
+            if (arg.size() == 2)
+            {
+                if (++i == argc)
+                {
+                    throw reaver::exception{ reaver::logger::fatal } << "`-j` requires a job count.";
+                }
+                arg += argv[i];
+            }
+
+            request.jobs = std::stoull(arg.substr(2));
+            continue;
+        }
+
+        positional.push_back(std::move(arg));
+    }
+
+    // blocked in every thread, so that they are only ever received by a sigwait
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    if (serve)
+    {
+        if (!positional.empty())
+        {
+            throw reaver::exception{ reaver::logger::fatal } << "usage: " << argv[0] << " --serve";
+        }
+
+        // clients going away in the middle of a build must not take the daemon with them
+        std::signal(SIGPIPE, SIG_IGN);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        reaver::despayre::build_daemon server{ "./buildfile" };
+        std::thread serve{ [&]{ server.run(); } };
+
+        int signal;
+        sigwait(&signals, &signal);
+
+        server.stop();
+        serve.join();
+        return 0;
+    }
+
+    if (positional.size() != 2)
+    {
+        throw reaver::exception{ reaver::logger::fatal } << "usage: " << argv[0] << " [-j <jobs>] [--content-hashes] [--remote-cache <socket>] [--worker <endpoint>]... [--remote-jobs <jobs>] [--stats] [--daemon | --lazy | --watch] <target> <output directory>\n"
+            << "       " << argv[0] << " --serve";
+    }
+
+    request.target = positional[0];
+    request.output_directory = positional[1];
+    // a few actions in flight per worker hide the round trips
+    request.remote_jobs = remote_jobs ? *remote_jobs : 4 * request.workers.size();
+
+    if (watch)
+    {
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        reaver::despayre::build_watcher watcher{ "./buildfile", request.target, request.output_directory, reaver::despayre::make_runtime_options(request) };
+        std::thread run{ [&]{ watcher.run(); } };
+
+        int signal;
+        sigwait(&signals, &signal);
+
+        watcher.stop();
+        run.join();
+        return 0;
+    }
+
+    if (use_daemon && evaluation == reaver::despayre::evaluation::eager)
+    {
+        if (auto exit_code = reaver::despayre::build_with_daemon(request))
+        {
+            return *exit_code;
+        }
+    }
+
+    auto context = reaver::despayre::despayre::load("./buildfile", boost::filesystem::path{ request.output_directory } / ".despayre_graph", boost::filesystem::current_path(), evaluation);
+    reaver::despayre::wait(context.build(request.target, request.output_directory, reaver::despayre::make_runtime_options(request)));
+
+    if (request.stats)
+    {
+        auto & file_status = context.last_context()->file_status;
+        reaver::logger::dlog() << "file status cache: " << file_status.hits() << " hits, " << file_status.misses() << " misses.";
+    }
 }
 catch (reaver::exception & ex)
 {
@@ -0,0 +1,64 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+
+#include "despayre/parser/arena.h"
+
+void * reaver::despayre::_v1::arena::_allocate_block(std::size_t size, std::size_t alignment)
+{
+    // blocks double in size, so the number of them stays logarithmic in the total size of the allocations
+    std::size_t block_size = _blocks.empty() ? 64 * 1024 : _blocks.back().size * 2;
+    block_size = std::max(block_size, size + alignment);
+
+    _blocks.push_back({ std::unique_ptr<char[]>{ new char[block_size] }, block_size });
+    _current = _blocks.back().data.get();
+    _end = _current + block_size;
+
+    return allocate(size, alignment);
+}
+
+void reaver::despayre::_v1::arena::reset()
+{
+    if (_blocks.empty())
+    {
+        return;
+    }
+
+    auto largest = std::max_element(_blocks.begin(), _blocks.end(), [](auto && lhs, auto && rhs) { return lhs.size < rhs.size; });
+    auto kept = std::move(*largest);
+    _blocks.clear();
+    _blocks.push_back(std::move(kept));
+
+    _current = _blocks.back().data.get();
+    _end = _current + _blocks.back().size;
+}
+
+std::size_t reaver::despayre::_v1::arena::capacity() const
+{
+    std::size_t ret = 0;
+    for (auto && block : _blocks)
+    {
+        ret += block.size;
+    }
+    return ret;
+}
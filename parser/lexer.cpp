@@ -20,8 +20,10 @@
  *
  **/
 
+#include <algorithm>
+#include <limits>
+
 #include <reaver/unit.h>
-#include <reaver/optional.h>
 
 #include "despayre/parser/lexer.h"
 
@@ -45,186 +47,214 @@ static auto token_types_init = []() -> reaver::unit
     return {};
 }();
 
-const std::unordered_map<char32_t, token_type> reaver::despayre::_v1::symbols1 = {
-    { '.', token_type::dot },
-    { ',', token_type::comma },
-    { '+', token_type::plus },
-    { '-', token_type::minus },
-    { '=', token_type::equals },
-    { '(', token_type::open_paren },
-    { ')', token_type::close_paren }
-};
-
-const std::unordered_map<char32_t, std::unordered_map<char32_t, token_type>> reaver::despayre::_v1::symbols2 = {
-};
-
-std::vector<reaver::despayre::_v1::token> reaver::despayre::_v1::tokenize(const std::experimental::u32string_view buildfile, const boost::filesystem::path & filename)
+namespace
 {
-    position pos;
-    pos.offset = -1;
-    pos.column = 0;
-    pos.line = 1;
-    pos.file = filename.string();
-
-    auto begin = std::begin(buildfile);
-    auto end = std::end(buildfile);
+    enum char_class : std::uint8_t
+    {
+        identifier_start = 1,
+        identifier_char = 2
+    };
 
-    std::vector<token> tokens;
+    struct char_class_table
+    {
+        std::uint8_t classes[256];
+    };
 
-    auto get = [&]() -> reaver::optional<char32_t>
+    constexpr char_class_table make_char_class_table()
     {
-        if (begin == end)
+        char_class_table ret{};
+
+        for (auto c = 'a'; c <= 'z'; ++c)
         {
-            return reaver::none;
+            ret.classes[static_cast<unsigned char>(c)] = identifier_start | identifier_char;
         }
-
-        if (*begin == U'\n')
+        for (auto c = 'A'; c <= 'Z'; ++c)
         {
-            pos.column = 0;
-            ++pos.line;
+            ret.classes[static_cast<unsigned char>(c)] = identifier_start | identifier_char;
         }
-
-        ++pos.offset;
-        ++pos.column;
-        return *begin++;
-    };
-
-    auto peek = [&](std::size_t x = 0) -> reaver::optional<char32_t>
-    {
-        if (static_cast<std::size_t>(std::distance(begin, end)) < x)
+        for (auto c = '0'; c <= '9'; ++c)
         {
-            return reaver::none;
+            ret.classes[static_cast<unsigned char>(c)] = identifier_char;
         }
+        ret.classes[static_cast<unsigned char>('_')] = identifier_start | identifier_char;
 
-        auto ret = begin;
-        std::advance(ret, x); // this interface is absurdly bad
-        return *ret;
-    };
+        return ret;
+    }
 
-    auto generate_token = [&](token_type type, position begin, position end, std::u32string string)
-    {
-        tokens.emplace_back(token{ type, std::move(string), range_type{ begin, end } });
-    };
+    constexpr char_class_table char_classes = make_char_class_table();
 
-    auto is_white_space = [](char32_t c)
+    bool is(char c, char_class cls)
     {
-        return c == U' ' || c == U'\t' || c == '\n' || c == U'\r';
-    };
+        return char_classes.classes[static_cast<unsigned char>(c)] & cls;
+    }
 
-    auto is_identifier_start = [](char32_t c)
+    bool is_continuation_byte(char c)
     {
-        return (c >= U'a' && c <= U'z') || (c >= U'A' && c <= U'Z') || c == U'_';
-    };
+        return (static_cast<unsigned char>(c) & 0xc0) == 0x80;
+    }
+}
 
-    auto is_decimal = [](char32_t c)
+reaver::despayre::_v1::token_stream::token_stream(std::experimental::string_view buildfile, std::string file, const reaver::despayre::_v1::scanner & scan) : _buildfile{ buildfile }, _file{ std::move(file) }, _scan{ scan }
+{
+    if (buildfile.size() >= std::numeric_limits<std::uint32_t>::max())
     {
-        return c >= U'0' && c <= U'9';
-    };
+        throw exception{ logger::fatal } << "buildfiles of 4 GiB or more are not supported.";
+    }
+}
 
-    auto is_identifier_char = [=](char32_t c)
-    {
-        return is_identifier_start(c) || is_decimal(c);
-    };
+// moves the position forward, keeping the line and column up to date; the scanners only deal in offsets
+void reaver::despayre::_v1::token_stream::_move_to(std::size_t offset)
+{
+    auto data = _buildfile.data();
 
-    while (begin != end)
+    // most moves are over a token or a single space, which are done before a call to the scanner would even return
+    if (offset - _position.offset < 16)
     {
-        auto next = get();
-
-        if (is_white_space(*next))
+        for (auto i = _position.offset; i < offset; ++i)
         {
-            continue;
+            if (data[i] == '\n')
+            {
+                ++_position.line;
+                _position.column = 1;
+            }
+
+            // continuation bytes belong to the code point already counted
+            else if (!is_continuation_byte(data[i]))
+            {
+                ++_position.column;
+            }
         }
 
-        auto p = pos;
-        if (next == U'/')
-        {
-            auto second = peek();
+        _position.offset = offset;
+        return;
+    }
 
-            if (second == U'/')
-            {
-                while ((next = get()) && *next != U'\n')
-                {
-                }
+    auto advance = _scan.advance(data, _position.offset, offset);
+    if (advance.newlines)
+    {
+        _position.line += advance.newlines;
+        _position.column = 1;
+    }
 
-                continue;
-            }
+    _position.offset = offset;
+    _position.column += advance.code_points;
+}
 
-            if (second == U'*')
-            {
-                get();
+reaver::optional<reaver::despayre::_v1::token> reaver::despayre::_v1::token_stream::next()
+{
+    auto data = _buildfile.data();
+    auto size = _buildfile.size();
 
-                while ((next = get()) && (second = peek()) && next != U'*' && second != U'/')
-                {
-                }
+    auto generate_token = [&](token_type type, position begin, std::size_t end)
+    {
+        _move_to(end);
+        return reaver::optional<token>{ token{ type, _buildfile.substr(begin.offset, end - begin.offset), range_type{ begin, _position } } };
+    };
 
-                if (next && second && next == U'*' && second == U'/')
-                {
-                    get();
-                    continue;
-                }
+    while (true)
+    {
+        auto start = _scan.skip_white_space(data, size, _position.offset);
+        _move_to(start);
 
-                throw unterminated_comment{ { p, pos } };
-            }
+        if (start == size)
+        {
+            return reaver::none;
         }
 
+        auto p = _position;
+        auto c = data[start];
+        auto second = start + 1 < size ? data[start + 1] : '\0';
+
+        if (c == '/' && second == '/')
         {
-            auto second = peek();
+            _move_to(_scan.find_byte(data, size, start + 2, '\n'));
+            continue;
+        }
 
-            if (second && symbols2.find(*next) != symbols2.end() && symbols2.at(*next).find(*second) != symbols2.at(*next).end())
+        if (c == '/' && second == '*')
+        {
+            auto star = _scan.find_byte(data, size, start + 2, '*');
+            while (star + 1 < size && data[star + 1] != '/')
             {
-                auto p = pos;
-                generate_token(symbols2.at(*next).at(*second), p, p + 2, { *next, *get() });
-                continue;
+                star = _scan.find_byte(data, size, star + 1, '*');
             }
 
-            else if (symbols1.find(*next) != symbols1.end())
+            if (star + 1 >= size)
             {
-                auto p = pos;
-                generate_token(symbols1.at(*next), p, p + 1, { *next });
-                continue;
+                _move_to(size);
+                throw unterminated_comment{ _file, { p, _position } };
             }
-        }
 
-        std::u32string variable_length;
+            _move_to(star + 2);
+            continue;
+        }
 
-        if (next == U'"')
+        auto symbol = symbols[c];
+        if (symbol != token_type::count)
         {
-            auto second = peek();
+            return generate_token(symbol, p, start + 1);
+        }
 
-            while (next && second && (second != U'"' || next == U'\\') && (second != U'\n' || next == U'\\'))
+        if (c == '"')
+        {
+            auto end = start + 1;
+            while (true)
             {
-                variable_length.push_back(*next);
+                end = _scan.find_string_special(data, size, end);
+                if (end == size || data[end] == '\n')
+                {
+                    _move_to(end);
+                    throw unterminated_string{ _file, { p, _position } };
+                }
 
-                next = get();
-                second = peek();
-            }
+                if (data[end] == '"')
+                {
+                    break;
+                }
 
-            if (!next || second == U'\n')
-            {
-                throw unterminated_string{ { p, p + variable_length.size() } };
+                // an escaped character (including a newline) never ends the string
+                end = std::min(end + 2, size);
             }
 
-            variable_length.push_back(*next);
-            get();
-
-            generate_token(token_type::string, p, p + variable_length.size(), std::move(variable_length).substr(1));
-            continue;
+            _move_to(end + 1);
+            return reaver::optional<token>{ token{ token_type::string, _buildfile.substr(start + 1, end - start - 1), range_type{ p, _position } } };
         }
 
-        if (is_identifier_start(*next))
+        if (is(c, identifier_start))
         {
-            do
+            auto end = start + 1;
+            while (end < size && is(data[end], identifier_char))
             {
-                variable_length.push_back(*next);
-            } while (peek() && is_identifier_char(*peek()) && (next = get()));
+                ++end;
+            }
 
-            generate_token(token_type::identifier, p, p + variable_length.size(), std::move(variable_length));
-            continue;
+            return generate_token(token_type::identifier, p, end);
         }
 
-        throw exception{ logger::fatal } << range_type{ pos, pos } << ": unexpected character: `" << *next << "`";
+        // print the whole code point, not just its first byte
+        auto end = start + 1;
+        while (end < size && is_continuation_byte(data[end]))
+        {
+            ++end;
+        }
+
+        range_type range{ p, p };
+        throw exception{ logger::fatal } << file_range{ _file, range } << ": unexpected character: `" << _buildfile.substr(start, end - start).to_string() << "`";
+    }
+}
+
+std::vector<reaver::despayre::_v1::token> reaver::despayre::_v1::tokenize(std::experimental::string_view buildfile, const reaver::despayre::_v1::scanner & scan)
+{
+    token_stream stream{ buildfile, scan };
+
+    // buildfiles average a token every 8 to 12 bytes; growing the vector from nothing costs more than the lexing itself
+    std::vector<token> tokens;
+    tokens.reserve(buildfile.size() / 8);
+
+    while (auto token = stream.next())
+    {
+        tokens.push_back(std::move(*token));
     }
 
     return tokens;
 }
-
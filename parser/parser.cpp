@@ -22,20 +22,36 @@
 
 #include "despayre/parser/parser.h"
 
-std::vector<reaver::despayre::assignment> reaver::despayre::_v1::parse(std::vector<reaver::despayre::token> tokens)
+reaver::despayre::parse_tree reaver::despayre::_v1::parse(std::vector<reaver::despayre::token> tokens, reaver::despayre::arena & nodes, std::string file)
 {
-    std::vector<assignment> assignments;
-
-    context ctx;
-    ctx.begin = std::begin(tokens);
-    ctx.end = std::end(tokens);
+    context ctx{ std::move(tokens), nodes, std::move(file) };
 
-    while (ctx.begin != ctx.end)
+    std::vector<assignment> assignments;
+    while (fill(ctx))
     {
         assignments.push_back(parse_assignment(ctx));
     }
 
-    return assignments;
+    parse_tree tree;
+    tree.assignments = nodes.copy<const assignment>(assignments.begin(), assignments.end());
+    tree.tokens = std::move(ctx.tokens);
+    return tree;
+}
+
+void reaver::despayre::_v1::parse(reaver::despayre::token_stream tokens, reaver::despayre::arena & nodes, const std::function<void (const std::vector<reaver::despayre::token> &, const reaver::despayre::assignment &)> & consumer)
+{
+    context ctx{ {}, nodes, tokens.file(), &tokens };
+
+    while (fill(ctx))
+    {
+        auto assignment = parse_assignment(ctx);
+        consumer(ctx.tokens, assignment);
+
+        // the lookahead that ended the assignment is where the next one starts
+        ctx.tokens.erase(ctx.tokens.begin(), ctx.tokens.begin() + ctx.current);
+        ctx.current = 0;
+        nodes.reset();
+    }
 }
 
 reaver::despayre::assignment reaver::despayre::_v1::parse_assignment(reaver::despayre::context & ctx)
@@ -45,66 +61,65 @@ reaver::despayre::assignment reaver::despayre::_v1::parse_assignment(reaver::des
     expect(ctx, token_type::equals);
     auto value = parse_expression(ctx);
 
-    return { range_type{ id.range.start(), value.range.end() }, std::move(id), std::move(value) };
+    return { range_type{ id.range.start(), value.range.end() }, id, value };
 }
 
 reaver::despayre::id_expression reaver::despayre::_v1::parse_id_expression(reaver::despayre::context & ctx)
 {
-    std::vector<identifier> identifiers;
-    identifiers.push_back(parse_identifier(ctx));
+    auto mark = ctx.identifiers.size();
+    ctx.identifiers.push_back(parse_identifier(ctx));
 
     while (peek(ctx, token_type::dot))
     {
         expect(ctx, token_type::dot);
-        identifiers.push_back(parse_identifier(ctx));
+        ctx.identifiers.push_back(parse_identifier(ctx));
     }
 
-    return { range_type{ identifiers.front().range.start(), identifiers.back().range.end() }, std::move(identifiers) };
+    range_type range{ ctx.tokens[ctx.identifiers[mark].token].range.start(), ctx.tokens[ctx.identifiers.back().token].range.end() };
+    return { range, pop_list(ctx, ctx.identifiers, mark) };
 }
 
 reaver::despayre::identifier reaver::despayre::_v1::parse_identifier(reaver::despayre::context & ctx)
 {
-    auto token = expect(ctx, token_type::identifier);
-    return { std::move(token.range), std::move(token) };
+    return { expect(ctx, token_type::identifier) };
 }
 
 reaver::despayre::string_node reaver::despayre::_v1::parse_string(reaver::despayre::context & ctx)
 {
-    auto token = expect(ctx, token_type::string);
-    return { std::move(token.range), std::move(token) };
+    return { expect(ctx, token_type::string) };
 }
 
-std::vector<reaver::despayre::operation> reaver::despayre::_v1::parse_operations(reaver::despayre::context & ctx)
+reaver::despayre::span<const reaver::despayre::operation> reaver::despayre::_v1::parse_operations(reaver::despayre::context & ctx)
 {
-    auto peeked = peek(ctx);
+    auto mark = ctx.operations.size();
 
-    std::vector<operation> operations;
+    auto peeked = peek(ctx);
     while (peeked && (peeked->type == token_type::plus || peeked->type == token_type::minus))
     {
-        operation_type operation = expect(ctx, peeked->type).type == token_type::plus ? operation_type::addition : operation_type::removal;
+        auto start = peeked->range.start();
+        operation_type operation = ctx.tokens[expect(ctx, peeked->type)].type == token_type::plus ? operation_type::addition : operation_type::removal;
         auto operand = parse_simple_expression(ctx);
-        auto end = get<0>(fmap(operand, [](auto && op){ return op.range.end(); }));
-        operations.push_back({ range_type{ peeked->range.start(), end }, operation, std::move(operand) });
+        auto end = get<0>(fmap(operand, [&](auto && op){ return range_of(ctx.tokens, op).end(); }));
+        ctx.operations.push_back({ range_type{ start, end }, operation, std::move(operand) });
 
         peeked = peek(ctx);
     }
 
-    return operations;
+    return pop_list(ctx, ctx.operations, mark);
 }
 
 reaver::despayre::expression reaver::despayre::_v1::parse_expression(reaver::despayre::context & ctx)
 {
     auto expr = parse_simple_expression(ctx);
     auto peeked = peek(ctx);
-    auto start = get<0>(fmap(expr, [](auto && expr){ return expr.range.start(); }));
+    auto expr_range = get<0>(fmap(expr, [&](auto && expr){ return range_of(ctx.tokens, expr); }));
     if (peeked && (peeked->type == token_type::plus || peeked->type == token_type::minus))
     {
         auto operations = parse_operations(ctx);
-        return expression{ range_type{ start, operations.back().range.end() }, std::move(expr), std::move(operations) };
+        return expression{ range_type{ expr_range.start(), operations.back().range.end() }, std::move(expr), operations };
     }
 
-    auto end = get<0>(fmap(expr, [](auto && expr){ return expr.range.end(); }));
-    return expression{ range_type{ start, end }, std::move(expr), {} };
+    return expression{ expr_range, std::move(expr), {} };
 }
 
 reaver::despayre::simple_expression reaver::despayre::_v1::parse_simple_expression(reaver::despayre::context & ctx)
@@ -112,7 +127,7 @@ reaver::despayre::simple_expression reaver::despayre::_v1::parse_simple_expressi
     auto peeked = peek(ctx);
     if (!peeked)
     {
-        throw expectation_failure{ "expression" };
+        throw expectation_failure{ ctx.file, "expression" };
     }
 
     switch (peeked->type)
@@ -130,30 +145,32 @@ reaver::despayre::simple_expression reaver::despayre::_v1::parse_simple_expressi
             {
                 expect(ctx, token_type::open_paren);
 
-                std::vector<expression> arguments;
+                auto mark = ctx.expressions.size();
                 if (peek(ctx) && peek(ctx)->type != token_type::close_paren)
                 {
-                    arguments.push_back(parse_expression(ctx));
+                    ctx.expressions.push_back(parse_expression(ctx));
 
                     while (peek(ctx) && peek(ctx)->type != token_type::close_paren)
                     {
                         expect(ctx, token_type::comma);
-                        arguments.push_back(parse_expression(ctx));
+                        ctx.expressions.push_back(parse_expression(ctx));
                     }
                 }
 
                 auto close = expect(ctx, token_type::close_paren);
-                return { instantiation{ range_type{ id.range.start(), close.range.end() }, std::move(id), std::move(arguments) } };
+                return { instantiation{ range_type{ id.range.start(), ctx.tokens[close].range.end() }, id, pop_list(ctx, ctx.expressions, mark) } };
             }
 
             else
             {
-                return { std::move(id) };
+                return { id };
             }
         }
 
         default:
-            throw expectation_failure{ "expression", peeked->string, ctx.begin->range };
+        {
+            auto range = peeked->range;
+            throw expectation_failure{ ctx.file, "expression", peeked->string, range };
+        }
     }
 }
-
@@ -0,0 +1,360 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DESPAYRE_X86_SCANNERS
+#endif
+
+#include "despayre/parser/scan.h"
+
+namespace
+{
+    bool is_white_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    bool is_string_special(char c)
+    {
+        return c == '"' || c == '\\' || c == '\n';
+    }
+
+    bool is_continuation_byte(char c)
+    {
+        return (static_cast<unsigned char>(c) & 0xc0) == 0x80;
+    }
+
+    // what moving over `first` and then `second` does
+    reaver::despayre::line_advance operator+(reaver::despayre::line_advance first, reaver::despayre::line_advance second)
+    {
+        if (second.newlines)
+        {
+            second.newlines += first.newlines;
+            return second;
+        }
+
+        first.code_points += second.code_points;
+        return first;
+    }
+
+    std::size_t skip_white_space_scalar(const char * data, std::size_t size, std::size_t from)
+    {
+        while (from < size && is_white_space(data[from]))
+        {
+            ++from;
+        }
+        return from;
+    }
+
+    std::size_t find_string_special_scalar(const char * data, std::size_t size, std::size_t from)
+    {
+        while (from < size && !is_string_special(data[from]))
+        {
+            ++from;
+        }
+        return from;
+    }
+
+    std::size_t find_byte_scalar(const char * data, std::size_t size, std::size_t from, char c)
+    {
+        while (from < size && data[from] != c)
+        {
+            ++from;
+        }
+        return from;
+    }
+
+    reaver::despayre::line_advance advance_scalar(const char * data, std::size_t from, std::size_t to)
+    {
+        reaver::despayre::line_advance ret;
+        for (; from < to; ++from)
+        {
+            if (data[from] == '\n')
+            {
+                ++ret.newlines;
+                ret.code_points = 0;
+            }
+
+            // continuation bytes belong to the code point already counted
+            else if (!is_continuation_byte(data[from]))
+            {
+                ++ret.code_points;
+            }
+        }
+        return ret;
+    }
+
+#ifdef DESPAYRE_X86_SCANNERS
+    // i386 builds don't assume SSE2, so like AVX2, it's enabled per function and checked for at runtime (see get_scanner)
+
+    // the same for both vector widths, given the masks of a chunk; `starts` has a bit for every byte that isn't a continuation byte
+    inline reaver::despayre::line_advance advance_chunk(unsigned newlines, unsigned starts)
+    {
+        reaver::despayre::line_advance ret;
+        if (newlines)
+        {
+            ret.newlines = __builtin_popcount(newlines);
+            // shifted twice, as the last newline may be the last bit
+            ret.code_points = __builtin_popcount((starts >> (31 - __builtin_clz(newlines))) >> 1);
+        }
+        else
+        {
+            ret.code_points = __builtin_popcount(starts);
+        }
+        return ret;
+    }
+
+    // most runs of white space in a buildfile are a single space; don't bother loading a vector for those
+    __attribute__((target("sse2")))
+    std::size_t skip_white_space_sse2(const char * data, std::size_t size, std::size_t from)
+    {
+        if (from < size && !is_white_space(data[from]))
+        {
+            return from;
+        }
+
+        const auto space = _mm_set1_epi8(' ');
+        const auto tab = _mm_set1_epi8('\t');
+        const auto newline = _mm_set1_epi8('\n');
+        const auto carriage_return = _mm_set1_epi8('\r');
+
+        for (; from + 16 <= size; from += 16)
+        {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + from));
+            auto white_space = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage_return))
+            );
+
+            unsigned mask = ~_mm_movemask_epi8(white_space) & 0xffff;
+            if (mask)
+            {
+                return from + __builtin_ctz(mask);
+            }
+        }
+
+        return skip_white_space_scalar(data, size, from);
+    }
+
+    __attribute__((target("sse2")))
+    std::size_t find_string_special_sse2(const char * data, std::size_t size, std::size_t from)
+    {
+        const auto quote = _mm_set1_epi8('"');
+        const auto backslash = _mm_set1_epi8('\\');
+        const auto newline = _mm_set1_epi8('\n');
+
+        for (; from + 16 <= size; from += 16)
+        {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + from));
+            auto special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                _mm_cmpeq_epi8(chunk, newline)
+            );
+
+            unsigned mask = _mm_movemask_epi8(special);
+            if (mask)
+            {
+                return from + __builtin_ctz(mask);
+            }
+        }
+
+        return find_string_special_scalar(data, size, from);
+    }
+
+    __attribute__((target("sse2")))
+    std::size_t find_byte_sse2(const char * data, std::size_t size, std::size_t from, char c)
+    {
+        const auto wanted = _mm_set1_epi8(c);
+
+        for (; from + 16 <= size; from += 16)
+        {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + from));
+            unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, wanted));
+            if (mask)
+            {
+                return from + __builtin_ctz(mask);
+            }
+        }
+
+        return find_byte_scalar(data, size, from, c);
+    }
+
+    // continuation bytes are 10xxxxxx, which as signed bytes are exactly the ones below 11000000
+    __attribute__((target("sse2")))
+    reaver::despayre::line_advance advance_sse2(const char * data, std::size_t from, std::size_t to)
+    {
+        const auto newline = _mm_set1_epi8('\n');
+        const auto first_non_continuation = _mm_set1_epi8(static_cast<char>(0xc0));
+
+        reaver::despayre::line_advance ret;
+        for (; from + 16 <= to; from += 16)
+        {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + from));
+            unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+            unsigned starts = ~_mm_movemask_epi8(_mm_cmplt_epi8(chunk, first_non_continuation)) & 0xffff;
+            ret = ret + advance_chunk(newlines, starts);
+        }
+
+        return ret + advance_scalar(data, from, to);
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t skip_white_space_avx2(const char * data, std::size_t size, std::size_t from)
+    {
+        if (from < size && !is_white_space(data[from]))
+        {
+            return from;
+        }
+
+        const auto space = _mm256_set1_epi8(' ');
+        const auto tab = _mm256_set1_epi8('\t');
+        const auto newline = _mm256_set1_epi8('\n');
+        const auto carriage_return = _mm256_set1_epi8('\r');
+
+        for (; from + 32 <= size; from += 32)
+        {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + from));
+            auto white_space = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, carriage_return))
+            );
+
+            unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(white_space));
+            if (mask)
+            {
+                return from + __builtin_ctz(mask);
+            }
+        }
+
+        return skip_white_space_sse2(data, size, from);
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t find_string_special_avx2(const char * data, std::size_t size, std::size_t from)
+    {
+        const auto quote = _mm256_set1_epi8('"');
+        const auto backslash = _mm256_set1_epi8('\\');
+        const auto newline = _mm256_set1_epi8('\n');
+
+        for (; from + 32 <= size; from += 32)
+        {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + from));
+            auto special = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+                _mm256_cmpeq_epi8(chunk, newline)
+            );
+
+            unsigned mask = _mm256_movemask_epi8(special);
+            if (mask)
+            {
+                return from + __builtin_ctz(mask);
+            }
+        }
+
+        return find_string_special_sse2(data, size, from);
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t find_byte_avx2(const char * data, std::size_t size, std::size_t from, char c)
+    {
+        const auto wanted = _mm256_set1_epi8(c);
+
+        for (; from + 32 <= size; from += 32)
+        {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + from));
+            unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, wanted));
+            if (mask)
+            {
+                return from + __builtin_ctz(mask);
+            }
+        }
+
+        return find_byte_sse2(data, size, from, c);
+    }
+
+    // every CPU with AVX2 has POPCNT too, but the compiler has to be told
+    __attribute__((target("avx2,popcnt")))
+    reaver::despayre::line_advance advance_avx2(const char * data, std::size_t from, std::size_t to)
+    {
+        const auto newline = _mm256_set1_epi8('\n');
+        // there's no unsigned (or less than) comparison in AVX2; greater than -65 is the same as not less than -64
+        const auto last_continuation = _mm256_set1_epi8(static_cast<char>(0xbf));
+
+        reaver::despayre::line_advance ret;
+        for (; from + 32 <= to; from += 32)
+        {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + from));
+            unsigned newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+            unsigned starts = _mm256_movemask_epi8(_mm256_cmpgt_epi8(chunk, last_continuation));
+            ret = ret + advance_chunk(newlines, starts);
+        }
+
+        return ret + advance_sse2(data, from, to);
+    }
+#endif
+
+    const reaver::despayre::scanner scalar_scanner = { &skip_white_space_scalar, &find_string_special_scalar, &find_byte_scalar, &advance_scalar };
+#ifdef DESPAYRE_X86_SCANNERS
+    const reaver::despayre::scanner sse2_scanner = { &skip_white_space_sse2, &find_string_special_sse2, &find_byte_sse2, &advance_sse2 };
+    const reaver::despayre::scanner avx2_scanner = { &skip_white_space_avx2, &find_string_special_avx2, &find_byte_avx2, &advance_avx2 };
+#endif
+}
+
+const reaver::despayre::_v1::scanner * reaver::despayre::_v1::get_scanner(reaver::despayre::_v1::scan_implementation implementation)
+{
+    switch (implementation)
+    {
+        case scan_implementation::scalar:
+            return &scalar_scanner;
+
+#ifdef DESPAYRE_X86_SCANNERS
+        case scan_implementation::sse2:
+            return __builtin_cpu_supports("sse2") ? &sse2_scanner : nullptr;
+
+        case scan_implementation::avx2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") ? &avx2_scanner : nullptr;
+#endif
+
+        default:
+            return nullptr;
+    }
+}
+
+const reaver::despayre::_v1::scanner & reaver::despayre::_v1::default_scanner()
+{
+    static const scanner & best = []() -> const scanner & {
+        for (auto implementation : { scan_implementation::avx2, scan_implementation::sse2 })
+        {
+            if (auto ret = get_scanner(implementation))
+            {
+                return *ret;
+            }
+        }
+
+        return scalar_scanner;
+    }();
+
+    return best;
+}
@@ -0,0 +1,126 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <reaver/exception.h>
+
+#include "despayre/parser/source.h"
+
+reaver::despayre::_v1::source_buffer::source_buffer(std::string contents) : _owned{ std::make_unique<std::string>(std::move(contents)) }
+{
+    _data = _owned->data();
+    _size = _owned->size();
+}
+
+reaver::despayre::_v1::source_buffer::source_buffer(reaver::despayre::_v1::source_buffer && other) noexcept
+    : _data{ other._data }, _size{ other._size }, _mapped{ other._mapped }, _owned{ std::move(other._owned) }
+{
+    other._data = nullptr;
+    other._size = 0;
+    other._mapped = false;
+}
+
+reaver::despayre::_v1::source_buffer & reaver::despayre::_v1::source_buffer::operator=(reaver::despayre::_v1::source_buffer && other) noexcept
+{
+    if (this != &other)
+    {
+        _release();
+
+        _data = other._data;
+        _size = other._size;
+        _mapped = other._mapped;
+        _owned = std::move(other._owned);
+
+        other._data = nullptr;
+        other._size = 0;
+        other._mapped = false;
+    }
+
+    return *this;
+}
+
+reaver::despayre::_v1::source_buffer::~source_buffer()
+{
+    _release();
+}
+
+void reaver::despayre::_v1::source_buffer::_release()
+{
+    if (_mapped)
+    {
+        ::munmap(const_cast<char *>(_data), _size);
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _mapped = false;
+    _owned.reset();
+}
+
+reaver::despayre::_v1::source_buffer reaver::despayre::_v1::source_buffer::map_file(const boost::filesystem::path & path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        throw exception{ logger::fatal } << "could not open `" << path.string() << "`: " << std::strerror(errno);
+    }
+
+    struct stat status;
+    if (::fstat(fd, &status) == -1)
+    {
+        auto error = errno;
+        ::close(fd);
+        throw exception{ logger::fatal } << "could not stat `" << path.string() << "`: " << std::strerror(error);
+    }
+
+    source_buffer ret;
+
+    // mapping zero bytes fails, and there's nothing to map anyway
+    if (status.st_size == 0)
+    {
+        ::close(fd);
+        return ret;
+    }
+
+    auto data = ::mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    auto error = errno;
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        throw exception{ logger::fatal } << "could not map `" << path.string() << "`: " << std::strerror(error);
+    }
+
+    ::madvise(data, status.st_size, MADV_SEQUENTIAL);
+
+    ret._data = static_cast<const char *>(data);
+    ret._size = status.st_size;
+    ret._mapped = true;
+    return ret;
+}
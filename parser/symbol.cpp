@@ -0,0 +1,90 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <boost/locale.hpp>
+
+#include <reaver/exception.h>
+
+#include "despayre/parser/symbol.h"
+
+namespace
+{
+    struct symbol_table
+    {
+        symbol_table()
+        {
+            spellings.emplace_back();
+            ids.emplace(spellings.back(), 0);
+        }
+
+        std::mutex lock;
+        // a deque never moves its elements, so the views (both the keys below and the ones handed out) stay valid
+        std::deque<std::string> spellings;
+        std::unordered_map<std::experimental::string_view, std::uint32_t> ids;
+    };
+
+    symbol_table & table()
+    {
+        static symbol_table ret;
+        return ret;
+    }
+}
+
+reaver::despayre::_v1::symbol reaver::despayre::_v1::intern(std::experimental::string_view name)
+{
+    auto & symbols = table();
+    std::lock_guard<std::mutex> lock{ symbols.lock };
+
+    auto it = symbols.ids.find(name);
+    if (it != symbols.ids.end())
+    {
+        return symbol{ it->second };
+    }
+
+    if (symbols.spellings.size() == std::numeric_limits<std::uint32_t>::max())
+    {
+        throw exception{ logger::fatal } << "too many distinct names.";
+    }
+
+    std::uint32_t id = symbols.spellings.size();
+    symbols.spellings.emplace_back(name.data(), name.size());
+    symbols.ids.emplace(symbols.spellings.back(), id);
+    return symbol{ id };
+}
+
+reaver::despayre::_v1::symbol reaver::despayre::_v1::intern(std::experimental::u32string_view name)
+{
+    return intern(boost::locale::conv::utf_to_utf<char>(name.data(), name.data() + name.size()));
+}
+
+std::experimental::string_view reaver::despayre::_v1::symbol::string() const
+{
+    auto & symbols = table();
+    std::lock_guard<std::mutex> lock{ symbols.lock };
+    return symbols.spellings[_id];
+}
@@ -0,0 +1,293 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <reaver/logger.h>
+
+#include "cache.h"
+#include "despayre/runtime/hash.h"
+
+namespace
+{
+    // older header sets are dropped once a manifest grows past this
+    const std::size_t max_manifest_entries = 16;
+
+    std::string hex(std::uint64_t value)
+    {
+        std::stringstream stream;
+        stream << std::hex << std::setw(16) << std::setfill('0') << value;
+        return stream.str();
+    }
+
+    std::string read_file(const boost::filesystem::path & path)
+    {
+        std::ifstream file{ path.string(), std::ios::binary };
+        return { std::istreambuf_iterator<char>{ file.rdbuf() }, {} };
+    }
+
+    // writes under a temporary name next to the destination and renames it into place
+    void write_file(const boost::filesystem::path & path, const std::string & contents)
+    {
+        auto temporary = path;
+        temporary += "." + boost::filesystem::unique_path().string() + ".tmp";
+
+        {
+            std::ofstream file{ temporary.string(), std::ios::binary | std::ios::trunc };
+            file << contents;
+            if (!file.flush())
+            {
+                boost::system::error_code ec;
+                boost::filesystem::remove(temporary, ec);
+                throw boost::filesystem::filesystem_error{ "failed to write", temporary, boost::system::errc::make_error_code(boost::system::errc::io_error) };
+            }
+        }
+
+        boost::filesystem::rename(temporary, path);
+    }
+
+    // an exclusive flock, held for as long as the object lives; released by the kernel if the process dies while holding it
+    class file_lock
+    {
+    public:
+        file_lock(const boost::filesystem::path & path)
+        {
+            _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (_fd < 0)
+            {
+                throw boost::filesystem::filesystem_error{ "failed to open", path, boost::system::error_code{ errno, boost::system::system_category() } };
+            }
+
+            while (::flock(_fd, LOCK_EX) != 0)
+            {
+                if (errno != EINTR)
+                {
+                    boost::system::error_code error{ errno, boost::system::system_category() };
+                    ::close(_fd);
+                    throw boost::filesystem::filesystem_error{ "failed to lock", path, error };
+                }
+            }
+        }
+
+        ~file_lock()
+        {
+            ::close(_fd);
+        }
+
+        file_lock(const file_lock &) = delete;
+        file_lock & operator=(const file_lock &) = delete;
+
+    private:
+        int _fd = -1;
+    };
+}
+
+auto reaver::despayre::cxx::_v1::compilation_cache::restore(context_ptr ctx, std::uint64_t key, const boost::filesystem::path & object) const -> optional<hit>
+{
+    try
+    {
+        for (auto && entry : _read_manifest(_manifest_path(key)))
+        {
+            auto matches = std::all_of(entry.inputs.begin(), entry.inputs.end(), [&](auto && input) {
+                return ctx->file_status.exists(input.second) && ctx->content_hashes.hash(ctx->file_status, input.second) == input.first;
+            });
+
+            if (!matches)
+            {
+                continue;
+            }
+
+            auto result = _result_path(entry.result);
+
+            auto temporary = object;
+            temporary += "." + boost::filesystem::unique_path().string() + ".tmp";
+
+            boost::system::error_code ec;
+            boost::filesystem::copy_file(result / "object", temporary, boost::filesystem::copy_option::overwrite_if_exists, ec);
+            if (ec)
+            {
+                // removed by someone cleaning up the cache; the other entries won't do any better
+                boost::filesystem::remove(temporary, ec);
+                return none;
+            }
+            boost::filesystem::rename(temporary, object);
+
+            hit ret;
+            ret.inputs.reserve(entry.inputs.size());
+            for (auto && input : entry.inputs)
+            {
+                ret.inputs.push_back(input.second);
+            }
+            ret.diagnostics = read_file(result / "diagnostics");
+
+            return ret;
+        }
+    }
+
+    catch (boost::filesystem::filesystem_error & ex)
+    {
+        logger::dlog(logger::warning) << "compilation cache lookup failed: " << ex.what();
+    }
+
+    return none;
+}
+
+void reaver::despayre::cxx::_v1::compilation_cache::store(context_ptr ctx, std::uint64_t key, const boost::filesystem::path & object, const std::vector<boost::filesystem::path> & inputs, const std::string & diagnostics) const
+{
+    try
+    {
+        _entry entry;
+        entry.result = key;
+        entry.inputs.reserve(inputs.size());
+
+        for (auto && input : inputs)
+        {
+            auto hash = ctx->content_hashes.hash(ctx->file_status, input);
+            auto name = input.string();
+            entry.result = hash_bytes(&hash, sizeof(hash), hash_bytes(name.data(), name.size(), entry.result));
+            entry.inputs.emplace_back(hash, input);
+        }
+
+        auto result = _result_path(entry.result);
+        if (!boost::filesystem::exists(result))
+        {
+            auto temporary = _temporary_path();
+            boost::filesystem::create_directories(temporary);
+            boost::filesystem::copy_file(object, temporary / "object");
+            write_file(temporary / "diagnostics", diagnostics);
+
+            boost::filesystem::create_directories(result.parent_path());
+            boost::system::error_code ec;
+            boost::filesystem::rename(temporary, result, ec);
+            if (ec)
+            {
+                // someone else stored the same result in the meantime
+                boost::filesystem::remove_all(temporary, ec);
+            }
+        }
+
+        auto manifest_path = _manifest_path(key);
+        boost::filesystem::create_directories(manifest_path.parent_path());
+
+        // other builds sharing the cache may be storing under the same key; without the lock, the last one to rename its manifest would win
+        auto lock_path = manifest_path;
+        lock_path += ".lock";
+        file_lock lock{ lock_path };
+
+        auto manifest = _read_manifest(manifest_path);
+        manifest.erase(std::remove_if(manifest.begin(), manifest.end(), [&](auto && other) { return other.result == entry.result; }), manifest.end());
+        manifest.insert(manifest.begin(), std::move(entry));
+        if (manifest.size() > max_manifest_entries)
+        {
+            manifest.resize(max_manifest_entries);
+        }
+
+        std::stringstream buffer;
+        buffer << "despayre-manifest 1\n";
+        for (auto && each : manifest)
+        {
+            buffer << "entry " << hex(each.result) << " " << each.inputs.size() << "\n";
+            for (auto && input : each.inputs)
+            {
+                buffer << hex(input.first) << " " << input.second.string() << "\n";
+            }
+        }
+
+        write_file(manifest_path, buffer.str());
+    }
+
+    catch (boost::filesystem::filesystem_error & ex)
+    {
+        logger::dlog(logger::warning) << "failed to store a compilation result in the cache: " << ex.what();
+    }
+}
+
+auto reaver::despayre::cxx::_v1::compilation_cache::_read_manifest(const boost::filesystem::path & path) const -> std::vector<_entry>
+{
+    std::vector<_entry> entries;
+
+    std::ifstream file{ path.string() };
+    std::string line;
+    if (!std::getline(file, line) || line != "despayre-manifest 1")
+    {
+        return entries;
+    }
+
+    while (std::getline(file, line))
+    {
+        std::istringstream header{ line };
+        std::string tag;
+        std::size_t count = 0;
+        _entry entry;
+
+        if (!(header >> tag >> std::hex >> entry.result >> std::dec >> count) || tag != "entry")
+        {
+            break;
+        }
+
+        for (std::size_t i = 0; i < count && std::getline(file, line); ++i)
+        {
+            auto space = line.find(' ');
+            if (space == std::string::npos)
+            {
+                break;
+            }
+
+            entry.inputs.emplace_back(std::strtoull(line.c_str(), nullptr, 16), line.substr(space + 1));
+        }
+
+        // a manifest cut short is unusable past the cut
+        if (entry.inputs.size() != count)
+        {
+            break;
+        }
+
+        entries.push_back(std::move(entry));
+    }
+
+    return entries;
+}
+
+boost::filesystem::path reaver::despayre::cxx::_v1::compilation_cache::_manifest_path(std::uint64_t key) const
+{
+    auto name = hex(key);
+    return _directory / "manifests" / name.substr(0, 2) / name;
+}
+
+boost::filesystem::path reaver::despayre::cxx::_v1::compilation_cache::_result_path(std::uint64_t key) const
+{
+    auto name = hex(key);
+    return _directory / "results" / name.substr(0, 2) / name;
+}
+
+boost::filesystem::path reaver::despayre::cxx::_v1::compilation_cache::_temporary_path() const
+{
+    return _directory / "tmp" / boost::filesystem::unique_path();
+}
@@ -0,0 +1,81 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <reaver/optional.h>
+
+#include "despayre/runtime/context.h"
+
+namespace reaver
+{
+    namespace despayre
+    {
+        namespace cxx { inline namespace _v1
+        {
+            // content addressed store of compilation results, shareable between processes
+            // a manifest, keyed by everything known before preprocessing (the compiler, the flags, the source),
+            // lists the header sets seen with that key; a result, keyed by the manifest key and the hashes of
+            // one such header set, holds the object file and the diagnostics printed while producing it
+            // every file is written under a temporary name and renamed into place, so readers never see partial entries;
+            // writers of a manifest hold an flock on the `.lock` file next to it, so that none of them drops the others' entries
+            class compilation_cache
+            {
+            public:
+                struct hit
+                {
+                    std::vector<boost::filesystem::path> inputs;
+                    std::string diagnostics;
+                };
+
+                compilation_cache(boost::filesystem::path directory) : _directory{ std::move(directory) }
+                {
+                }
+
+                // on a hit, the object is restored; the dependency file is up to the caller
+                optional<hit> restore(context_ptr ctx, std::uint64_t key, const boost::filesystem::path & object) const;
+                // inputs are the ones listed by the dependency file; the source comes first
+                void store(context_ptr ctx, std::uint64_t key, const boost::filesystem::path & object, const std::vector<boost::filesystem::path> & inputs, const std::string & diagnostics) const;
+
+            private:
+                struct _entry
+                {
+                    std::uint64_t result;
+                    std::vector<std::pair<std::uint64_t, boost::filesystem::path>> inputs;
+                };
+
+                std::vector<_entry> _read_manifest(const boost::filesystem::path &) const;
+                boost::filesystem::path _manifest_path(std::uint64_t) const;
+                boost::filesystem::path _result_path(std::uint64_t) const;
+                boost::filesystem::path _temporary_path() const;
+
+                boost::filesystem::path _directory;
+            };
+        }}
+    }
+}
@@ -20,9 +20,14 @@
  *
  **/
 
+#include <algorithm>
 #include <fstream>
 
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+
 #include <reaver/filesystem.h>
+#include <reaver/prelude/functor.h>
 
 #include <boost/process.hpp>
 #ifndef BOOST_POSIX_API
@@ -33,6 +38,8 @@
 
 #include "compiler.h"
 #include "despayre/semantics/string.h"
+#include "despayre/runtime/environment.h"
+#include "despayre/runtime/hash.h"
 
 using reaver::despayre::_v1::context_ptr;
 
@@ -50,13 +57,8 @@ namespace
         output += ".deps";
         return output;
     }
-}
 
-std::vector<boost::filesystem::path> reaver::despayre::cxx::_v1::cxx_compiler::inputs(context_ptr ctx, const boost::filesystem::path & path) const
-{
-    auto deps_path = dependencies_path(ctx, path);
-
-    if (boost::filesystem::exists(deps_path))
+    std::vector<boost::filesystem::path> parse_dependencies(const boost::filesystem::path & deps_path)
     {
         std::vector<boost::filesystem::path> inputs;
 
@@ -114,6 +116,84 @@ std::vector<boost::filesystem::path> reaver::despayre::cxx::_v1::cxx_compiler::i
         return inputs;
     }
 
+    // writes a dependency file like the one the compiler would have written
+    void write_dependencies(const boost::filesystem::path & object, const boost::filesystem::path & deps_path, const std::vector<boost::filesystem::path> & inputs)
+    {
+        auto escape = [](const std::string & path) {
+            std::string escaped;
+            for (auto && c : path)
+            {
+                if (c == ' ')
+                {
+                    escaped.push_back('\\');
+                }
+                escaped.push_back(c);
+            }
+            return escaped;
+        };
+
+        auto temporary = deps_path;
+        temporary += ".tmp";
+
+        {
+            std::ofstream file{ temporary.string(), std::ios::trunc };
+            file << escape(object.string()) << ":";
+            for (auto && input : inputs)
+            {
+                file << " \\\n " << escape(input.string());
+            }
+            file << "\n";
+        }
+
+        boost::filesystem::rename(temporary, deps_path);
+    }
+
+    // runs a command, collecting everything it prints; returns the exit code and the output
+    // runs with the environment of the build, not necessarily the one of this process (see runtime_options::environment)
+    std::pair<int, std::string> run(const std::vector<std::string> & args, const std::vector<std::string> & environment)
+    {
+        using namespace boost::process::initializers;
+        boost::process::pipe p = boost::process::create_pipe();
+
+        {
+            boost::iostreams::file_descriptor_sink sink{ p.sink, boost::iostreams::close_handle };
+            auto child = boost::process::execute(set_args(args), set_env(environment), bind_stdout(sink), bind_stderr(sink), close_stdin());
+
+            boost::iostreams::file_descriptor_source source{ p.source, boost::iostreams::close_handle };
+            boost::iostreams::stream<boost::iostreams::file_descriptor_source> is(source);
+
+            // the write end has to be closed here, or the read below never sees the end of the output
+            sink.close();
+
+            std::string buffer(std::istreambuf_iterator<char>(is.rdbuf()), std::istreambuf_iterator<char>());
+            auto exit_status = wait_for_exit(child);
+            return { WIFEXITED(exit_status) ? WEXITSTATUS(exit_status) : 128 + WTERMSIG(exit_status), std::move(buffer) };
+        }
+    }
+}
+
+std::vector<boost::filesystem::path> reaver::despayre::cxx::_v1::cxx_compiler::inputs(context_ptr ctx, const boost::filesystem::path & path) const
+{
+    {
+        std::lock_guard<std::mutex> lock{ _fresh_inputs_lock };
+        auto it = _fresh_inputs.find(path);
+        if (it != _fresh_inputs.end())
+        {
+            return it->second;
+        }
+    }
+
+    if (auto record = ctx->build_log.find(output_path(ctx, path)))
+    {
+        return fmap(record->inputs, [](auto && input) { return input.path; });
+    }
+
+    auto deps_path = dependencies_path(ctx, path);
+    if (ctx->file_status.exists(deps_path))
+    {
+        return parse_dependencies(deps_path);
+    }
+
     return { path };
 }
 
@@ -123,54 +203,231 @@ std::vector<boost::filesystem::path> reaver::despayre::cxx::_v1::cxx_compiler::o
     return { output_path(ctx, path) };
 }
 
-void reaver::despayre::cxx::_v1::cxx_compiler::build(context_ptr ctx, const boost::filesystem::path & path) const
+std::uint64_t reaver::despayre::cxx::_v1::cxx_compiler::command_signature(context_ptr ctx, const boost::filesystem::path & path) const
 {
-    auto out = filesystem::make_relative(output_path(ctx, path));
+    return hash_command(_command(ctx, path), { "CXX", "CXXFLAGS" }, ctx->environment);
+}
 
-    logger::dlog() << "Building " << out.string() << " from " << path.string() << ".";
+void reaver::despayre::cxx::_v1::cxx_compiler::restored(context_ptr ctx, const boost::filesystem::path & path, std::vector<boost::filesystem::path> inputs) const
+{
+    auto deps_path = dependencies_path(ctx, path);
+    write_dependencies(filesystem::make_relative(output_path(ctx, path)), deps_path, inputs);
+    ctx->file_status.invalidate(deps_path);
 
-    boost::filesystem::create_directories(out.parent_path());
+    std::lock_guard<std::mutex> lock{ _fresh_inputs_lock };
+    _fresh_inputs[path] = std::move(inputs);
+}
 
+std::string reaver::despayre::cxx::_v1::cxx_compiler::_flags() const
+{
     // need a better way to do this
-    auto flags = [&]{
-        try
+    try
+    {
+        return utf8(_arguments->get_property(U"flags")->as<string>()->value());
+    }
+    catch (...)
+    {
+        return {};
+    }
+}
+
+std::vector<std::string> reaver::despayre::cxx::_v1::cxx_compiler::_command(context_ptr ctx, const boost::filesystem::path & path) const
+{
+    auto out = filesystem::make_relative(output_path(ctx, path));
+    auto deps_flags = " -MD -MF " + dependencies_path(ctx, path).string() + " ";
+
+    return { "/bin/sh", "-c", "exec ${CXX} -c ${CXXFLAGS} -std=c++1z -o '" + out.string() + "' '" + path.string() + "' " + _flags() + deps_flags };
+}
+
+const reaver::despayre::cxx::_v1::compilation_cache * reaver::despayre::cxx::_v1::cxx_compiler::_cache(context_ptr ctx) const
+{
+    std::call_once(_cache_once, [&]{
+        auto directory = [&]() -> std::string {
+            try
+            {
+                return utf8(_arguments->get_property(U"cache_dir")->as<string>()->value());
+            }
+            catch (...)
+            {
+                auto env = find_variable(ctx->environment, "DESPAYRE_CXX_CACHE");
+                return env ? env : "";
+            }
+        }();
+
+        if (directory.empty())
         {
-            return _arguments->get_property(U"flags")->as<string>()->value();
+            return;
         }
-        catch (...)
+
+        // the version banner changes with every compiler build worth telling apart
+        auto version = run({ "/bin/sh", "-c", "exec ${CXX} --version" }, ctx->environment);
+        if (version.first)
         {
-            return std::u32string{};
+            logger::dlog(logger::warning) << "could not determine the version of the compiler; not using the compilation cache.";
+            return;
         }
-    }();
 
-    auto deps_flags = " -MD -MF " + dependencies_path(ctx, path).string() + " ";
+        _compiler_fingerprint = hash_bytes(version.second.data(), version.second.size());
+        _cache_ptr = std::make_unique<compilation_cache>(boost::filesystem::absolute(directory));
+    });
+
+    return _cache_ptr.get();
+}
+
+// everything that determines the result except the contents of the headers, which the cache checks itself
+// output paths are left out, so that output directories (and workspaces) can share results
+std::uint64_t reaver::despayre::cxx::_v1::cxx_compiler::_cache_key(context_ptr ctx, const boost::filesystem::path & path) const
+{
+    return hash_command({
+            "despayre c++ cache 1",
+            std::to_string(_compiler_fingerprint),
+            "-std=c++1z",
+            _flags(),
+            path.string(),
+            std::to_string(ctx->content_hashes.hash(ctx->file_status, path))
+        },
+        { "CXX", "CXXFLAGS" }, ctx->environment);
+}
 
-    std::vector<std::string> args = { "/bin/sh", "-c", "exec ${CXX} -c ${CXXFLAGS} -std=c++1z -o '" + out.string() + "' '" + path.string() + "' " + utf8(flags) + deps_flags };
+void reaver::despayre::cxx::_v1::cxx_compiler::build(context_ptr ctx, const boost::filesystem::path & path) const
+{
+    _build(ctx, path, false);
+}
+
+void reaver::despayre::cxx::_v1::cxx_compiler::build_remote(context_ptr ctx, const boost::filesystem::path & path) const
+{
+    _build(ctx, path, true);
+}
+
+// preprocesses locally (writing the dependency file on the way) and ships the result to a worker
+// returns none when no worker could take it, in which case the caller should compile locally
+reaver::optional<std::pair<int, std::string>> reaver::despayre::cxx::_v1::cxx_compiler::_compile_remotely(context_ptr ctx, const boost::filesystem::path & path) const
+{
+    auto out = filesystem::make_relative(output_path(ctx, path));
+    auto preprocessed = out;
+    preprocessed += ".ii";
 
-    using namespace boost::process::initializers;
-    boost::process::pipe p = boost::process::create_pipe();
+    auto env = [&](const char * name) {
+        auto value = find_variable(ctx->environment, name);
+        return std::string{ value ? value : "" };
+    };
 
-    int exit_code = 0;
+    auto preprocessing = run({ "/bin/sh", "-c", "exec ${CXX} -E ${CXXFLAGS} -std=c++1z -o '" + preprocessed.string() + "' '" + path.string() + "' " + _flags()
+        + " -MD -MF " + dependencies_path(ctx, path).string() + " -MT '" + out.string() + "'" }, ctx->environment);
 
+    // split like the shell splits the unquoted variables of the local command; the worker runs the arguments as they are
+    auto words = [](const std::string & string) {
+        std::vector<std::string> ret;
+        boost::algorithm::split(ret, string, boost::is_any_of(" \t\n"), boost::algorithm::token_compress_on);
+        ret.erase(std::remove(ret.begin(), ret.end(), std::string{}), ret.end());
+        return ret;
+    };
+
+    remote_action action;
+    action.arguments = words(env("CXX") + " -c " + env("CXXFLAGS") + " -std=c++1z " + _flags());
+    action.source_extension = ".ii";
+
+    {
+        std::ifstream file{ preprocessed.string(), std::ios::binary };
+        action.source.assign(std::istreambuf_iterator<char>{ file.rdbuf() }, {});
+    }
+    boost::system::error_code ec;
+    boost::filesystem::remove(preprocessed, ec);
+
+    if (preprocessing.first)
     {
-        boost::iostreams::file_descriptor_sink sink{ p.sink, boost::iostreams::close_handle };
-        auto child = boost::process::execute(set_args(args), inherit_env(), bind_stdout(sink), close_stdin());
-        auto exit_status = wait_for_exit(child);
-        exit_code = WEXITSTATUS(exit_status);
+        return std::move(preprocessing);
     }
 
-    boost::iostreams::file_descriptor_source source{ p.source, boost::iostreams::close_handle };
-    boost::iostreams::stream<boost::iostreams::file_descriptor_source> is(source);
+    remote_result result;
+    try
+    {
+        result = ctx->options.remote_execution->execute(action);
+    }
+    catch (protocol_error &)
+    {
+        return none;
+    }
+
+    if (!result.exit_code)
+    {
+        auto temporary = out;
+        temporary += ".tmp";
+
+        {
+            std::ofstream file{ temporary.string(), std::ios::binary | std::ios::trunc };
+            file << result.object;
+        }
+
+        boost::filesystem::rename(temporary, out);
+    }
+
+    return std::make_pair(result.exit_code, preprocessing.second + result.diagnostics);
+}
+
+void reaver::despayre::cxx::_v1::cxx_compiler::_build(context_ptr ctx, const boost::filesystem::path & path, bool remote) const
+{
+    auto out = filesystem::make_relative(output_path(ctx, path));
+    auto deps_path = dependencies_path(ctx, path);
+
+    logger::dlog() << "Building " << out.string() << " from " << path.string() << ".";
+
+    boost::filesystem::create_directories(out.parent_path());
+
+    auto cache = _cache(ctx);
+    auto key = cache ? _cache_key(ctx, path) : 0;
+
+    if (cache)
+    {
+        if (auto hit = cache->restore(ctx, key, out))
+        {
+            if (!hit->diagnostics.empty())
+            {
+                logger::dlog() << hit->diagnostics;
+            }
+
+            restored(ctx, path, std::move(hit->inputs));
+            return;
+        }
+    }
+
+    auto result = [&]{
+        if (remote)
+        {
+            if (auto remote_result = _compile_remotely(ctx, path))
+            {
+                return std::move(*remote_result);
+            }
+        }
+
+        return run(_command(ctx, path), ctx->environment);
+    }();
+    auto exit_code = result.first;
+    auto & buffer = result.second;
+
+    ctx->file_status.invalidate(deps_path);
+
+    // the build log still has the inputs of the previous build; make sure the new ones are what gets recorded
+    auto fresh = ctx->file_status.exists(deps_path) ? parse_dependencies(deps_path) : std::vector<boost::filesystem::path>{ path };
 
-    std::string buffer(std::istreambuf_iterator<char>(is.rdbuf()), std::istreambuf_iterator<char>());
     if (!buffer.empty())
     {
         logger::dlog() << buffer;
     }
 
-    if (!exit_code)
+    if (cache && !exit_code)
     {
-        // TODO :P
+        cache->store(ctx, key, out, fresh, buffer);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ _fresh_inputs_lock };
+        _fresh_inputs[path] = std::move(fresh);
     }
-}
 
+    // thrown before the scheduler gets to record the build, so that the old outputs (if any) aren't taken for the results of this one
+    if (exit_code)
+    {
+        throw build_failed{ "failed to build `" + out.string() + "` from `" + path.string() + "`." };
+    }
+}
@@ -22,9 +22,15 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "despayre/runtime/context.h"
 #include "despayre/semantics/variable.h"
 
+#include "cache.h"
+
 namespace reaver
 {
     namespace despayre
@@ -42,14 +48,48 @@ namespace reaver
                 virtual std::vector<boost::filesystem::path> outputs(context_ptr, const boost::filesystem::path &) const override;
 
                 virtual void build(context_ptr, const boost::filesystem::path &) const override;
+
+                virtual bool can_build_remotely(context_ptr ctx, const boost::filesystem::path &) const override
+                {
+                    return static_cast<bool>(ctx->options.remote_execution);
+                }
+
+                virtual void build_remote(context_ptr, const boost::filesystem::path &) const override;
                 virtual const std::vector<linker_capability> & linker_caps(context_ptr, const::boost::filesystem::path &) const override
                 {
                     return _linker_cap;
                 }
 
+                virtual std::uint64_t command_signature(context_ptr, const boost::filesystem::path &) const override;
+
+                virtual std::vector<boost::filesystem::path> declared_inputs(context_ptr, const boost::filesystem::path & path) const override
+                {
+                    return { path };
+                }
+
+                virtual void restored(context_ptr, const boost::filesystem::path &, std::vector<boost::filesystem::path>) const override;
+
             private:
+                void _build(context_ptr, const boost::filesystem::path &, bool remote) const;
+                optional<std::pair<int, std::string>> _compile_remotely(context_ptr, const boost::filesystem::path &) const;
+
+                std::string _flags() const;
+                std::vector<std::string> _command(context_ptr, const boost::filesystem::path &) const;
+
+                const compilation_cache * _cache(context_ptr ctx) const;
+                std::uint64_t _cache_key(context_ptr, const boost::filesystem::path &) const;
+
                 std::vector<linker_capability> _linker_cap;
                 std::shared_ptr<variable> _arguments;
+
+                // inputs discovered by builds in this run, which take precedence over the build log
+                mutable std::mutex _fresh_inputs_lock;
+                mutable std::unordered_map<boost::filesystem::path, std::vector<boost::filesystem::path>, boost::hash<boost::filesystem::path>> _fresh_inputs;
+
+                // set up on first use, from the `cache_dir` argument or the DESPAYRE_CXX_CACHE environment variable
+                mutable std::once_flag _cache_once;
+                mutable std::unique_ptr<compilation_cache> _cache_ptr;
+                mutable std::uint64_t _compiler_fingerprint = 0;
             };
         }}
     }
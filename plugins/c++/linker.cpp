@@ -32,10 +32,16 @@
 
 #include "linker.h"
 #include "despayre/semantics/string.h"
+#include "despayre/runtime/environment.h"
+#include "despayre/runtime/hash.h"
 
-void reaver::despayre::cxx::_v1::cxx_linker::_build(reaver::despayre::_v1::context_ptr ctx, const boost::filesystem::path & out, reaver::despayre::_v1::binary_type type, const std::vector<boost::filesystem::path> & inputs, const std::string & additional_flags) const
+std::uint64_t reaver::despayre::cxx::_v1::cxx_linker::_command_signature(reaver::despayre::_v1::context_ptr ctx, const boost::filesystem::path & out, reaver::despayre::_v1::binary_type type, const std::vector<boost::filesystem::path> & inputs, const std::string & additional_flags) const
+{
+    return hash_command(_command(out, type, inputs, additional_flags), { "CXX", "CXXFLAGS", "LDFLAGS" }, ctx->environment);
+}
+
+std::vector<std::string> reaver::despayre::cxx::_v1::cxx_linker::_command(const boost::filesystem::path & out, reaver::despayre::_v1::binary_type type, const std::vector<boost::filesystem::path> & inputs, const std::string & additional_flags) const
 {
-    std::string message;
     std::string flags;
 
     auto output = filesystem::make_relative(out);
@@ -43,11 +49,9 @@ void reaver::despayre::cxx::_v1::cxx_linker::_build(reaver::despayre::_v1::conte
     switch (type)
     {
         case binary_type::executable:
-            message = "Building executable ";
             break;
 
         case binary_type::shared_library:
-            message = "Building shared library ";
             flags = " -shared ";
             break;
 
@@ -55,8 +59,6 @@ void reaver::despayre::cxx::_v1::cxx_linker::_build(reaver::despayre::_v1::conte
             assert(!"static library not implemented yet");
     }
 
-    logger::dlog() << message << output.string() << ".";
-
     std::string input_paths = " ";
     for (auto && input : inputs)
     {
@@ -75,8 +77,33 @@ void reaver::despayre::cxx::_v1::cxx_linker::_build(reaver::despayre::_v1::conte
         }
     }();
 
+    return { "/bin/sh", "-c", "exec ${CXX} ${CXXFLAGS} ${LDFLAGS} -std=c++1z -o '" + output.string() + "' " + input_paths + additional_flags + flags + " " + utf8(ldflags) };
+}
+
+void reaver::despayre::cxx::_v1::cxx_linker::_build(reaver::despayre::_v1::context_ptr ctx, const boost::filesystem::path & out, reaver::despayre::_v1::binary_type type, const std::vector<boost::filesystem::path> & inputs, const std::string & additional_flags) const
+{
+    std::string message;
+
+    auto output = filesystem::make_relative(out);
+
+    switch (type)
+    {
+        case binary_type::executable:
+            message = "Building executable ";
+            break;
+
+        case binary_type::shared_library:
+            message = "Building shared library ";
+            break;
+
+        case binary_type::static_library:
+            assert(!"static library not implemented yet");
+    }
+
+    logger::dlog() << message << output.string() << ".";
+
     boost::filesystem::create_directories(output.parent_path());
-    std::vector<std::string> args = { "/bin/sh", "-c", "exec ${CXX} ${CXXFLAGS} ${LDFLAGS} -std=c++1z -o '" + output.string() + "' " + input_paths + additional_flags + flags + " " + utf8(ldflags) };
+    auto args = _command(out, type, inputs, additional_flags);
 
     using namespace boost::process::initializers;
     boost::process::pipe p = boost::process::create_pipe();
@@ -85,9 +112,9 @@ void reaver::despayre::cxx::_v1::cxx_linker::_build(reaver::despayre::_v1::conte
 
     {
         boost::iostreams::file_descriptor_sink sink{ p.sink, boost::iostreams::close_handle };
-        auto child = boost::process::execute(set_args(args), inherit_env(), bind_stdout(sink), close_stdin());
+        auto child = boost::process::execute(set_args(args), set_env(ctx->environment), bind_stdout(sink), close_stdin());
         auto exit_status = wait_for_exit(child);
-        exit_code = WEXITSTATUS(exit_status);
+        exit_code = WIFEXITED(exit_status) ? WEXITSTATUS(exit_status) : 128 + WTERMSIG(exit_status);
     }
 
     boost::iostreams::file_descriptor_source source{ p.source, boost::iostreams::close_handle };
@@ -99,9 +126,9 @@ void reaver::despayre::cxx::_v1::cxx_linker::_build(reaver::despayre::_v1::conte
         logger::dlog() << buffer;
     }
 
-    if (!exit_code)
+    if (exit_code)
     {
-        // TODO :P
+        throw build_failed{ "failed to link `" + output.string() + "`." };
     }
 }
 
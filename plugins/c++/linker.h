@@ -40,8 +40,11 @@ namespace reaver
 
             protected:
                 virtual void _build(context_ptr, const boost::filesystem::path &, binary_type, const std::vector<boost::filesystem::path> &, const std::string &) const override;
+                virtual std::uint64_t _command_signature(context_ptr, const boost::filesystem::path &, binary_type, const std::vector<boost::filesystem::path> &, const std::string &) const override;
 
             private:
+                std::vector<std::string> _command(const boost::filesystem::path &, binary_type, const std::vector<boost::filesystem::path> &, const std::string &) const;
+
                 std::shared_ptr<variable> _arguments;
             };
         }}
@@ -0,0 +1,390 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <reaver/exception.h>
+
+#include "despayre/runtime/build_log.h"
+
+namespace
+{
+    const char magic[8] = { 'd', 's', 'p', 'r', 'l', 'o', 'g', '2' };
+
+    enum record_kind : std::uint8_t
+    {
+        output_record = 1,
+        file_hash_record = 2
+    };
+
+    struct truncated_record {};
+
+    template<typename T>
+    void put(std::string & buffer, T value)
+    {
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void put_string(std::string & buffer, const std::string & str)
+    {
+        put<std::uint32_t>(buffer, str.size());
+        buffer += str;
+    }
+
+    class reader
+    {
+    public:
+        reader(const char * begin, const char * end) : _current{ begin }, _end{ end }
+        {
+        }
+
+        template<typename T>
+        T get()
+        {
+            if (static_cast<std::size_t>(_end - _current) < sizeof(T))
+            {
+                throw truncated_record{};
+            }
+
+            T ret;
+            std::memcpy(&ret, _current, sizeof(T));
+            _current += sizeof(T);
+            return ret;
+        }
+
+        std::string get_string()
+        {
+            auto size = get<std::uint32_t>();
+            if (static_cast<std::size_t>(_end - _current) < size)
+            {
+                throw truncated_record{};
+            }
+
+            std::string ret{ _current, _current + size };
+            _current += size;
+            return ret;
+        }
+
+    private:
+        const char * _current;
+        const char * _end;
+    };
+
+    bool write_all(int fd, const char * data, std::size_t size)
+    {
+        std::size_t written = 0;
+        while (written < size)
+        {
+            auto ret = ::write(fd, data + written, size - written);
+            if (ret <= 0)
+            {
+                return false;
+            }
+            written += ret;
+        }
+
+        return true;
+    }
+
+    // every record is framed as a 32 bit length followed by the body
+    void frame(std::string & buffer, const std::string & body)
+    {
+        put<std::uint32_t>(buffer, body.size());
+        buffer += body;
+    }
+
+    std::string encode(const boost::filesystem::path & output, const reaver::despayre::build_log::record & rec)
+    {
+        std::string body;
+        put<std::uint8_t>(body, output_record);
+        put<std::uint8_t>(body, rec.hashed);
+        put(body, rec.command_signature);
+        put(body, rec.output_hash);
+        put(body, rec.duration);
+        put_string(body, output.string());
+        put<std::uint32_t>(body, rec.inputs.size());
+        for (auto && input : rec.inputs)
+        {
+            put(body, input.hash);
+            put_string(body, input.path.string());
+        }
+
+        std::string ret;
+        frame(ret, body);
+        return ret;
+    }
+
+    std::string encode(const boost::filesystem::path & path, const reaver::despayre::build_log::file_hash & hash)
+    {
+        std::string body;
+        put<std::uint8_t>(body, file_hash_record);
+        put<std::uint64_t>(body, hash.inode);
+        put<std::uint64_t>(body, hash.size);
+        put(body, hash.last_write_time);
+        put(body, hash.hashed_at);
+        put(body, hash.hash);
+        put_string(body, path.string());
+
+        std::string ret;
+        frame(ret, body);
+        return ret;
+    }
+}
+
+reaver::despayre::_v1::build_log::build_log(boost::filesystem::path path) : _path{ std::move(path) }
+{
+    _load();
+}
+
+reaver::despayre::_v1::build_log::~build_log()
+{
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+    }
+}
+
+std::shared_ptr<const reaver::despayre::_v1::build_log::record> reaver::despayre::_v1::build_log::find(const boost::filesystem::path & output) const
+{
+    std::lock_guard<std::mutex> lock{ _lock };
+    auto it = _records.find(output);
+    if (it == _records.end())
+    {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void reaver::despayre::_v1::build_log::add(const boost::filesystem::path & output, reaver::despayre::_v1::build_log::record rec)
+{
+    auto buffer = encode(output, rec);
+
+    std::lock_guard<std::mutex> lock{ _lock };
+    _records[output] = std::make_shared<const record>(std::move(rec));
+    _append(buffer);
+}
+
+reaver::optional<reaver::despayre::_v1::build_log::file_hash> reaver::despayre::_v1::build_log::find_file_hash(const boost::filesystem::path & path) const
+{
+    std::lock_guard<std::mutex> lock{ _lock };
+    auto it = _file_hashes.find(path);
+    if (it == _file_hashes.end())
+    {
+        return none;
+    }
+    return it->second;
+}
+
+void reaver::despayre::_v1::build_log::add_file_hash(const boost::filesystem::path & path, reaver::despayre::_v1::build_log::file_hash hash)
+{
+    auto buffer = encode(path, hash);
+
+    std::lock_guard<std::mutex> lock{ _lock };
+    _file_hashes[path] = hash;
+    _append(buffer);
+}
+
+void reaver::despayre::_v1::build_log::_load()
+{
+    _fd = ::open(_path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (_fd < 0)
+    {
+        return;
+    }
+
+    struct stat buffer;
+    if (::fstat(_fd, &buffer) != 0)
+    {
+        throw exception{ logger::error } << "failed to stat the build log `" << _path.string() << "`.";
+    }
+
+    std::size_t size = buffer.st_size;
+    std::size_t valid = 0;
+
+    if (size >= sizeof(magic))
+    {
+        auto mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            throw exception{ logger::error } << "failed to map the build log `" << _path.string() << "`.";
+        }
+
+        auto data = static_cast<const char *>(mapping);
+        if (std::memcmp(data, magic, sizeof(magic)) == 0)
+        {
+            valid = sizeof(magic);
+
+            while (valid + sizeof(std::uint32_t) <= size)
+            {
+                std::uint32_t length;
+                std::memcpy(&length, data + valid, sizeof(length));
+
+                auto begin = data + valid + sizeof(length);
+                if (length > size - valid - sizeof(length))
+                {
+                    break;
+                }
+
+                try
+                {
+                    reader body{ begin, begin + length };
+
+                    switch (body.get<std::uint8_t>())
+                    {
+                        case output_record:
+                        {
+                            auto rec = std::make_shared<record>();
+                            rec->hashed = body.get<std::uint8_t>();
+                            rec->command_signature = body.get<std::uint64_t>();
+                            rec->output_hash = body.get<std::uint64_t>();
+                            rec->duration = body.get<std::uint64_t>();
+                            auto output = body.get_string();
+                            auto count = body.get<std::uint32_t>();
+                            rec->inputs.reserve(count);
+                            for (auto i = 0u; i < count; ++i)
+                            {
+                                auto hash = body.get<std::uint64_t>();
+                                rec->inputs.push_back({ body.get_string(), hash });
+                            }
+                            _records[std::move(output)] = std::move(rec);
+                            break;
+                        }
+
+                        case file_hash_record:
+                        {
+                            file_hash hash;
+                            hash.inode = body.get<std::uint64_t>();
+                            hash.size = body.get<std::uint64_t>();
+                            hash.last_write_time = body.get<std::int64_t>();
+                            hash.hashed_at = body.get<std::int64_t>();
+                            hash.hash = body.get<std::uint64_t>();
+                            _file_hashes[body.get_string()] = hash;
+                            break;
+                        }
+
+                        default:
+                            throw truncated_record{};
+                    }
+                }
+
+                catch (truncated_record &)
+                {
+                    break;
+                }
+
+                ++_record_count;
+                valid += sizeof(length) + length;
+            }
+        }
+
+        ::munmap(mapping, size);
+    }
+
+    // drop whatever was torn by an interrupted write, or the whole file if it isn't a build log
+    if (valid != size && ::ftruncate(_fd, valid) != 0)
+    {
+        throw exception{ logger::error } << "failed to truncate the build log `" << _path.string() << "`.";
+    }
+
+    if (valid == 0 && !write_all(_fd, magic, sizeof(magic)))
+    {
+        throw exception{ logger::error } << "failed to write to the build log `" << _path.string() << "`.";
+    }
+
+    if (_record_count > 1024 && _record_count > 2 * (_records.size() + _file_hashes.size()))
+    {
+        _compact();
+    }
+}
+
+void reaver::despayre::_v1::build_log::_compact()
+{
+    std::string buffer{ magic, sizeof(magic) };
+    for (auto && rec : _records)
+    {
+        buffer += encode(rec.first, *rec.second);
+    }
+    for (auto && hash : _file_hashes)
+    {
+        buffer += encode(hash.first, hash.second);
+    }
+
+    auto temporary = _path;
+    temporary += ".tmp";
+
+    auto fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    if (!write_all(fd, buffer.data(), buffer.size()))
+    {
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        return;
+    }
+    ::close(fd);
+
+    if (::rename(temporary.c_str(), _path.c_str()) != 0)
+    {
+        ::unlink(temporary.c_str());
+        return;
+    }
+
+    ::close(_fd);
+    _fd = ::open(_path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    _record_count = _records.size() + _file_hashes.size();
+}
+
+// must be called with _lock held (or from the constructor)
+void reaver::despayre::_v1::build_log::_append(const std::string & buffer)
+{
+    if (_fd < 0)
+    {
+        boost::filesystem::create_directories(_path.parent_path());
+        _fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (_fd < 0)
+        {
+            throw exception{ logger::error } << "failed to open the build log `" << _path.string() << "`.";
+        }
+
+        // another process might have created it in the meantime
+        struct stat status;
+        if (::fstat(_fd, &status) == 0 && status.st_size == 0 && !write_all(_fd, magic, sizeof(magic)))
+        {
+            throw exception{ logger::error } << "failed to write to the build log `" << _path.string() << "`.";
+        }
+    }
+
+    if (!write_all(_fd, buffer.data(), buffer.size()))
+    {
+        throw exception{ logger::error } << "failed to write to the build log `" << _path.string() << "`.";
+    }
+
+    ++_record_count;
+}
@@ -0,0 +1,234 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <reaver/logger.h>
+
+#include "despayre/runtime/cache_server.h"
+#include "despayre/runtime/hash.h"
+
+namespace
+{
+    // results kept per action key; the oldest ones are dropped first
+    const std::size_t max_results = 16;
+
+    std::string hex(std::uint64_t value)
+    {
+        std::stringstream stream;
+        stream << std::hex << std::setw(16) << std::setfill('0') << value;
+        return stream.str();
+    }
+
+    reaver::optional<std::string> read_file(const boost::filesystem::path & path)
+    {
+        std::ifstream file{ path.string(), std::ios::binary };
+        if (!file)
+        {
+            return reaver::none;
+        }
+
+        return std::string{ std::istreambuf_iterator<char>{ file.rdbuf() }, {} };
+    }
+
+    // readers never see partially written files
+    void write_file(const boost::filesystem::path & path, const std::string & contents)
+    {
+        boost::filesystem::create_directories(path.parent_path());
+
+        auto temporary = path;
+        temporary += "." + boost::filesystem::unique_path().string() + ".tmp";
+
+        {
+            std::ofstream file{ temporary.string(), std::ios::binary | std::ios::trunc };
+            file << contents;
+            if (!file.flush())
+            {
+                throw reaver::despayre::protocol_error{ "failed to write `" + temporary.string() + "`." };
+            }
+        }
+
+        boost::filesystem::rename(temporary, path);
+    }
+
+    std::vector<reaver::despayre::action_result> decode_results(const std::string & buffer)
+    {
+        reaver::despayre::message_reader reader{ buffer };
+
+        std::vector<reaver::despayre::action_result> results;
+        auto count = reader.get<std::uint32_t>();
+        for (auto i = 0u; i < count; ++i)
+        {
+            results.push_back(reaver::despayre::decode_action_result(reader));
+        }
+
+        return results;
+    }
+
+    bool same_inputs(const reaver::despayre::action_result & lhs, const reaver::despayre::action_result & rhs)
+    {
+        return std::equal(lhs.inputs.begin(), lhs.inputs.end(), rhs.inputs.begin(), rhs.inputs.end(), [](auto && l, auto && r) {
+            return l.path == r.path && l.hash == r.hash;
+        });
+    }
+
+    std::string status(reaver::despayre::cache_status value)
+    {
+        std::string body;
+        reaver::despayre::put_value(body, value);
+        return body;
+    }
+}
+
+reaver::despayre::_v1::cache_server::cache_server(boost::filesystem::path socket, boost::filesystem::path storage) : frame_server{ socket.string() }, _storage{ std::move(storage) }
+{
+    boost::filesystem::create_directories(_storage);
+}
+
+reaver::despayre::_v1::cache_server::~cache_server()
+{
+    _shutdown();
+}
+
+std::string reaver::despayre::_v1::cache_server::_handle(const std::string & request)
+{
+    try
+    {
+        message_reader reader{ request };
+        auto operation = reader.get<cache_operation>();
+        auto key = reader.get<std::uint64_t>();
+
+        switch (operation)
+        {
+            case cache_operation::get_blob:
+            {
+                auto contents = read_file(_blob_path(key));
+                if (!contents)
+                {
+                    return status(cache_status::not_found);
+                }
+
+                auto response = status(cache_status::ok);
+                put_string(response, *contents);
+                return response;
+            }
+
+            case cache_operation::put_blob:
+            {
+                auto contents = reader.get_string();
+                if (hash_bytes(contents.data(), contents.size()) != key)
+                {
+                    return status(cache_status::error);
+                }
+
+                auto path = _blob_path(key);
+                if (!boost::filesystem::exists(path))
+                {
+                    write_file(path, contents);
+                }
+
+                return status(cache_status::ok);
+            }
+
+            case cache_operation::get_action:
+            {
+                auto contents = read_file(_action_path(key));
+                if (!contents)
+                {
+                    return status(cache_status::not_found);
+                }
+
+                auto response = status(cache_status::ok);
+                response += *contents;
+                return response;
+            }
+
+            case cache_operation::put_action:
+            {
+                auto result = decode_action_result(reader);
+
+                // results referring to blobs the server doesn't have would only ever produce failed restores
+                for (auto && output : result.outputs)
+                {
+                    if (!boost::filesystem::exists(_blob_path(output.hash)))
+                    {
+                        return status(cache_status::error);
+                    }
+                }
+
+                auto path = _action_path(key);
+
+                std::lock_guard<std::mutex> lock{ _actions_lock };
+
+                auto results = [&]{
+                    auto contents = read_file(path);
+                    return contents ? decode_results(*contents) : std::vector<action_result>{};
+                }();
+
+                results.erase(std::remove_if(results.begin(), results.end(), [&](auto && other) { return same_inputs(other, result); }), results.end());
+                results.insert(results.begin(), std::move(result));
+                if (results.size() > max_results)
+                {
+                    results.resize(max_results);
+                }
+
+                std::string buffer;
+                put_value<std::uint32_t>(buffer, results.size());
+                for (auto && each : results)
+                {
+                    encode(buffer, each);
+                }
+                write_file(path, buffer);
+
+                return status(cache_status::ok);
+            }
+        }
+
+        return status(cache_status::error);
+    }
+
+    catch (protocol_error &)
+    {
+        return status(cache_status::error);
+    }
+
+    catch (boost::filesystem::filesystem_error & ex)
+    {
+        logger::dlog(logger::warning) << "cache server: " << ex.what();
+        return status(cache_status::error);
+    }
+}
+
+boost::filesystem::path reaver::despayre::_v1::cache_server::_blob_path(std::uint64_t hash) const
+{
+    auto name = hex(hash);
+    return _storage / "blobs" / name.substr(0, 2) / name;
+}
+
+boost::filesystem::path reaver::despayre::_v1::cache_server::_action_path(std::uint64_t key) const
+{
+    auto name = hex(key);
+    return _storage / "actions" / name.substr(0, 2) / name;
+}
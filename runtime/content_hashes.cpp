@@ -0,0 +1,56 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <time.h>
+
+#include "despayre/runtime/content_hashes.h"
+#include "despayre/runtime/hash.h"
+
+namespace
+{
+    // file times are taken from the kernel's coarse clock, which lags behind the system clock;
+    // a write right after reading a file could otherwise get an mtime older than the time it was read at
+    std::int64_t coarse_file_time()
+    {
+        ::timespec now;
+        ::clock_gettime(CLOCK_REALTIME_COARSE, &now);
+        return static_cast<std::int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    }
+}
+
+std::uint64_t reaver::despayre::_v1::content_hashes::hash(reaver::despayre::_v1::file_status_cache & file_status, const boost::filesystem::path & path)
+{
+    auto status = file_status.status(path);
+
+    auto known = _log.find_file_hash(path);
+    if (known && known->inode == status.inode && known->size == status.size && known->last_write_time == status.last_write_time && known->last_write_time < known->hashed_at)
+    {
+        return known->hash;
+    }
+
+    // taken before reading, so that anything written during the read counts as racy
+    auto hashed_at = coarse_file_time();
+    auto hash = hash_file(path);
+    _log.add_file_hash(path, { status.inode, status.size, status.last_write_time, hashed_at, hash });
+
+    return hash;
+}
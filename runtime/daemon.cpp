@@ -0,0 +1,327 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <iostream>
+
+#include <unistd.h>
+
+#include <reaver/logger.h>
+
+#include "despayre/runtime/daemon.h"
+#include "despayre/runtime/environment.h"
+#include "despayre/runtime/remote_cache.h"
+#include "despayre/runtime/remote_execution.h"
+
+std::string reaver::despayre::_v1::encode(const daemon_request & request)
+{
+    std::string buffer;
+    put_string(buffer, request.target);
+    put_string(buffer, request.output_directory);
+    put_value<std::uint64_t>(buffer, request.jobs);
+    put_value<std::uint8_t>(buffer, request.content_hashes);
+    put_string(buffer, request.remote_cache);
+    put_value<std::uint32_t>(buffer, request.workers.size());
+    for (auto && worker : request.workers)
+    {
+        put_string(buffer, worker);
+    }
+    put_value<std::uint64_t>(buffer, request.remote_jobs);
+    put_value<std::uint8_t>(buffer, request.stats);
+    put_string(buffer, request.working_directory);
+    put_value<std::uint32_t>(buffer, request.environment.size());
+    for (auto && variable : request.environment)
+    {
+        put_string(buffer, variable);
+    }
+    return buffer;
+}
+
+reaver::despayre::_v1::daemon_request reaver::despayre::_v1::decode_daemon_request(message_reader & reader)
+{
+    daemon_request request;
+    request.target = reader.get_string();
+    request.output_directory = reader.get_string();
+    request.jobs = reader.get<std::uint64_t>();
+    request.content_hashes = reader.get<std::uint8_t>();
+    request.remote_cache = reader.get_string();
+    request.workers.resize(reader.get<std::uint32_t>());
+    for (auto && worker : request.workers)
+    {
+        worker = reader.get_string();
+    }
+    request.remote_jobs = reader.get<std::uint64_t>();
+    request.stats = reader.get<std::uint8_t>();
+    request.working_directory = reader.get_string();
+    request.environment.resize(reader.get<std::uint32_t>());
+    for (auto && variable : request.environment)
+    {
+        variable = reader.get_string();
+    }
+    return request;
+}
+
+reaver::despayre::_v1::runtime_options reaver::despayre::_v1::make_runtime_options(const daemon_request & request)
+{
+    runtime_options options;
+    options.jobs = request.jobs ? request.jobs : default_job_count();
+    options.content_hashes = request.content_hashes;
+    if (!request.remote_cache.empty())
+    {
+        options.remote_cache = std::make_shared<unix_socket_cache>(request.remote_cache);
+    }
+    if (!request.workers.empty())
+    {
+        options.remote_jobs = request.remote_jobs;
+        options.remote_execution = std::make_shared<remote_executor>(request.workers);
+    }
+    return options;
+}
+
+// the buildfile is only analyzed for the first request, as that's what tells which output directory the globs have to skip
+reaver::despayre::_v1::build_daemon::build_daemon(boost::filesystem::path buildfile, std::string endpoint) : frame_server{ std::move(endpoint) }, _buildfile{ std::move(buildfile) }
+{
+}
+
+reaver::despayre::_v1::build_daemon::~build_daemon()
+{
+    _shutdown();
+}
+
+std::string reaver::despayre::_v1::build_daemon::_handle_connection(int connection, const std::string & request)
+{
+    message_reader reader{ request };
+    auto decoded = decode_daemon_request(reader);
+    auto fds = receive_fds(connection, 2);
+
+    std::string response;
+
+    // relative paths in the request (and in the buildfile) mean something else for a client somewhere else
+    boost::system::error_code error;
+    if (!boost::filesystem::equivalent(decoded.working_directory, boost::filesystem::current_path(), error))
+    {
+        ::close(fds[0]);
+        ::close(fds[1]);
+
+        put_value<std::uint8_t>(response, false);
+        return response;
+    }
+
+    std::lock_guard<std::mutex> lock{ _build_lock };
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    auto saved_stdout = ::dup(1);
+    auto saved_stderr = ::dup(2);
+    ::dup2(fds[0], 1);
+    ::dup2(fds[1], 2);
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    auto exit_code = _build(decoded);
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    ::dup2(saved_stdout, 1);
+    ::dup2(saved_stderr, 2);
+    ::close(saved_stdout);
+    ::close(saved_stderr);
+
+    put_value<std::uint8_t>(response, true);
+    put_value<std::int32_t>(response, exit_code);
+    return response;
+}
+
+int reaver::despayre::_v1::build_daemon::_build(const daemon_request & request)
+{
+    try
+    {
+        // the globs of the graph skip the output directory it was analyzed for
+        if (!_graph || _buildfile_changed() || _globs_changed() || request.output_directory != _output_directory)
+        {
+            _refresh(request.output_directory);
+        }
+
+        // contexts are only shared between builds asking for the same output directory, options and environment
+        auto key = request;
+        key.target.clear();
+        key.stats = false;
+
+        auto & ctx = _contexts[encode(key)];
+        if (!ctx)
+        {
+            // the environment is only ever handed to the commands, and to their signatures; the daemon's own stays as it is
+            auto options = make_runtime_options(request);
+            options.environment = request.environment;
+            ctx = _graph->make_context(request.output_directory, std::move(options));
+            ctx->file_status_maintained = true;
+        }
+
+        _forget_changes();
+
+        wait(_graph->build(request.target, ctx));
+
+        if (request.stats)
+        {
+            logger::dlog() << "file status cache: " << ctx->file_status.hits() << " hits, " << ctx->file_status.misses() << " misses.";
+        }
+
+        return 0;
+    }
+
+    catch (exception & ex)
+    {
+        ex.print(logger::default_logger());
+        return 2;
+    }
+
+    catch (std::exception & ex)
+    {
+        logger::dlog(logger::fatal) << ex.what();
+        return 1;
+    }
+}
+
+bool reaver::despayre::_v1::build_daemon::_buildfile_changed() const
+{
+    auto changed = [](const file_status & status, const file_status & known) {
+        return status.exists != known.exists
+            || status.last_write_time != known.last_write_time
+            || status.size != known.size
+            || status.inode != known.inode;
+    };
+
+    // the ignore file decides what the globs match just as much as the buildfile does
+    return changed(stat_file(_buildfile), _buildfile_status) || changed(stat_file(".despayreignore"), _ignore_file_status);
+}
+
+bool reaver::despayre::_v1::build_daemon::_globs_changed() const
+{
+    for (auto && directory : _graph->globbed_directories())
+    {
+        if (stat_file(directory.first).last_write_time != directory.second)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void reaver::despayre::_v1::build_daemon::_refresh(const std::string & output_directory)
+{
+    // the old contexts refer to targets of the old graph, so they can't outlive it
+    _contexts.clear();
+    _graph.reset();
+
+    _buildfile_status = stat_file(_buildfile);
+    _ignore_file_status = stat_file(".despayreignore");
+    _output_directory = output_directory;
+
+    // watched before anything is looked at, so that no change goes unnoticed; output directories are skipped, as they change with every build
+    _watcher.clear();
+    for (auto && directory : source_directories(boost::filesystem::current_path()))
+    {
+        _watcher.watch(directory);
+    }
+
+    _graph = std::make_unique<despayre>(_buildfile, boost::filesystem::current_path(), evaluation::eager, std::vector<boost::filesystem::path>{ _output_directory });
+}
+
+void reaver::despayre::_v1::build_daemon::_forget_changes()
+{
+    auto changes = _watcher.pending();
+
+    // a directory changes along with its entries
+    auto changed = changes.paths;
+    for (auto && path : changes.paths)
+    {
+        changed.insert(path.parent_path());
+    }
+
+    auto workspace = boost::filesystem::current_path();
+    for (auto && context : _contexts)
+    {
+        context.second->file_status.retain([&](const boost::filesystem::path & path) {
+            if (changes.overflow)
+            {
+                return false;
+            }
+
+            auto absolute = boost::filesystem::absolute(path, workspace).lexically_normal();
+            return _watcher.watching(absolute.parent_path()) && !changed.count(absolute);
+        });
+    }
+}
+
+reaver::optional<int> reaver::despayre::_v1::build_with_daemon(const daemon_request & request, const boost::filesystem::path & socket)
+{
+    if (!boost::filesystem::exists(boost::filesystem::symlink_status(socket)))
+    {
+        return none;
+    }
+
+    int fd = -1;
+    try
+    {
+        auto filled = request;
+        if (filled.working_directory.empty())
+        {
+            filled.working_directory = boost::filesystem::current_path().string();
+        }
+        if (filled.environment.empty())
+        {
+            filled.environment = process_environment();
+        }
+
+        fd = connect_unix_socket(socket);
+        write_frame(fd, encode(filled));
+
+        std::cout.flush();
+        std::cerr.flush();
+        send_fds(fd, { 1, 2 });
+
+        auto response = read_frame(fd);
+        ::close(fd);
+        if (!response)
+        {
+            return none;
+        }
+
+        message_reader reader{ *response };
+        if (!reader.get<std::uint8_t>())
+        {
+            return none;
+        }
+        return static_cast<int>(reader.get<std::int32_t>());
+    }
+
+    catch (protocol_error &)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return none;
+    }
+}
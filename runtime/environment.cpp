@@ -0,0 +1,48 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <unistd.h>
+
+#include "despayre/runtime/environment.h"
+
+std::vector<std::string> reaver::despayre::_v1::process_environment()
+{
+    std::vector<std::string> ret;
+    for (auto variable = environ; variable && *variable; ++variable)
+    {
+        ret.emplace_back(*variable);
+    }
+    return ret;
+}
+
+const char * reaver::despayre::_v1::find_variable(const std::vector<std::string> & environment, const std::string & name)
+{
+    for (auto && variable : environment)
+    {
+        if (variable.size() > name.size() && variable[name.size()] == '=' && variable.compare(0, name.size(), name) == 0)
+        {
+            return variable.c_str() + name.size() + 1;
+        }
+    }
+
+    return nullptr;
+}
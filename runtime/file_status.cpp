@@ -0,0 +1,77 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "despayre/runtime/file_status.h"
+
+reaver::despayre::_v1::file_status reaver::despayre::_v1::file_status_cache::status(const boost::filesystem::path & path)
+{
+    {
+        std::lock_guard<std::mutex> lock{ _lock };
+        auto it = _cache.find(path);
+        if (it != _cache.end())
+        {
+            ++_hits;
+            return it->second;
+        }
+    }
+
+    ++_misses;
+
+    auto status = stat_file(path);
+
+    std::lock_guard<std::mutex> lock{ _lock };
+    _cache.emplace(path, status);
+    return status;
+}
+
+reaver::despayre::_v1::file_status reaver::despayre::_v1::stat_file(const boost::filesystem::path & path)
+{
+    file_status status;
+    struct stat buffer;
+    if (::stat(path.c_str(), &buffer) == 0)
+    {
+        status.exists = true;
+        status.last_write_time = static_cast<std::int64_t>(buffer.st_mtim.tv_sec) * 1000000000 + buffer.st_mtim.tv_nsec;
+        status.size = buffer.st_size;
+        status.inode = buffer.st_ino;
+    }
+
+    return status;
+}
+
+void reaver::despayre::_v1::set_last_write_time(const boost::filesystem::path & path, std::int64_t time)
+{
+    ::timespec times[2];
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = time / 1000000000;
+    times[1].tv_nsec = time % 1000000000;
+
+    if (::utimensat(AT_FDCWD, path.c_str(), times, 0) != 0)
+    {
+        throw boost::filesystem::filesystem_error{ "failed to set the modification time", path, boost::system::error_code{ errno, boost::system::system_category() } };
+    }
+}
@@ -0,0 +1,224 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <reaver/exception.h>
+#include <reaver/logger.h>
+
+#include "despayre/runtime/file_watcher.h"
+
+namespace
+{
+    const std::uint32_t watched_events = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+}
+
+std::vector<boost::filesystem::path> reaver::despayre::_v1::source_directories(const boost::filesystem::path & root)
+{
+    std::vector<boost::filesystem::path> directories = { root };
+
+    boost::system::error_code error;
+    for (boost::filesystem::recursive_directory_iterator it{ root, error }, end; it != end; it.increment(error))
+    {
+        if (error)
+        {
+            break;
+        }
+
+        if (!boost::filesystem::is_directory(it->symlink_status()))
+        {
+            continue;
+        }
+
+        if (it->path().filename() == ".git" || boost::filesystem::exists(it->path() / ".despayre_log"))
+        {
+            it.no_push();
+            continue;
+        }
+
+        directories.push_back(it->path());
+    }
+
+    return directories;
+}
+
+reaver::despayre::_v1::file_watcher::file_watcher()
+{
+    _fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_fd < 0 || ::pipe2(_interrupt, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+        auto error = errno;
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+        }
+        throw exception{ logger::fatal } << "failed to set up file watching: " << std::strerror(error);
+    }
+}
+
+reaver::despayre::_v1::file_watcher::~file_watcher()
+{
+    ::close(_fd);
+    ::close(_interrupt[0]);
+    ::close(_interrupt[1]);
+}
+
+void reaver::despayre::_v1::file_watcher::watch(const boost::filesystem::path & directory)
+{
+    auto absolute = boost::filesystem::absolute(directory).lexically_normal();
+    if (!_watched.insert(absolute).second)
+    {
+        return;
+    }
+
+    auto descriptor = ::inotify_add_watch(_fd, absolute.c_str(), watched_events | IN_ONLYDIR);
+    if (descriptor < 0)
+    {
+        if (errno == ENOSPC)
+        {
+            logger::dlog(logger::warning) << "the inotify watch limit was reached; changes in `" << absolute.string() << "` won't be noticed.";
+        }
+        return;
+    }
+
+    _directories[descriptor] = std::move(absolute);
+}
+
+void reaver::despayre::_v1::file_watcher::clear()
+{
+    for (auto && directory : _directories)
+    {
+        ::inotify_rm_watch(_fd, directory.first);
+    }
+    _directories.clear();
+    _watched.clear();
+}
+
+reaver::despayre::_v1::file_changes reaver::despayre::_v1::file_watcher::wait(std::uint32_t quiet_ms)
+{
+    file_changes changes;
+
+    bool seen = false;
+    while (true)
+    {
+        ::pollfd fds[2] = { { _fd, POLLIN, 0 }, { _interrupt[0], POLLIN, 0 } };
+        auto ret = ::poll(fds, 2, seen ? static_cast<int>(quiet_ms) : -1);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw exception{ logger::fatal } << "failed to wait for file changes: " << std::strerror(errno);
+        }
+
+        if (fds[1].revents)
+        {
+            char buffer[64];
+            while (::read(_interrupt[0], buffer, sizeof(buffer)) > 0)
+            {
+            }
+            changes.interrupted = true;
+            return changes;
+        }
+
+        if (!ret)
+        {
+            // quiet for long enough
+            return changes;
+        }
+
+        _read(changes);
+        seen = seen || changes.overflow || !changes.paths.empty();
+    }
+}
+
+reaver::despayre::_v1::file_changes reaver::despayre::_v1::file_watcher::pending()
+{
+    file_changes changes;
+    _read(changes);
+    return changes;
+}
+
+void reaver::despayre::_v1::file_watcher::interrupt()
+{
+    char byte = 0;
+    while (::write(_interrupt[1], &byte, 1) < 0 && errno == EINTR)
+    {
+    }
+}
+
+void reaver::despayre::_v1::file_watcher::_read(file_changes & changes)
+{
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (true)
+    {
+        auto size = ::read(_fd, buffer, sizeof(buffer));
+        if (size <= 0)
+        {
+            return;
+        }
+
+        for (auto current = buffer; current < buffer + size; )
+        {
+            auto event = reinterpret_cast<const inotify_event *>(current);
+            current += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                changes.overflow = true;
+                continue;
+            }
+
+            auto it = _directories.find(event->wd);
+            if (it == _directories.end())
+            {
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED)
+            {
+                // the directory itself is gone; it's reported as changed, and can be watched again once it's back
+                changes.paths.insert(it->second);
+                _watched.erase(it->second);
+                _directories.erase(it);
+                continue;
+            }
+
+            if (event->len)
+            {
+                changes.paths.insert(it->second / event->name);
+            }
+            else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                changes.paths.insert(it->second);
+            }
+        }
+    }
+}
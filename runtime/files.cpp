@@ -20,6 +20,103 @@
  *
  **/
 
+#include <reaver/unit.h>
+
 #include "despayre/runtime/files.h"
 #include "despayre/runtime/executable.h"
 
+static auto files_operators_init = []() -> reaver::unit
+{
+    using namespace reaver::despayre;
+
+    register_operator(operation_type::addition, get_type_identifier<files>(), get_type_identifier<files>(), [](std::shared_ptr<variable> lhs, std::shared_ptr<variable> rhs) -> std::shared_ptr<variable> {
+        return lhs->as<files>()->unite(*rhs->as<files>());
+    });
+
+    register_operator(operation_type::removal, get_type_identifier<files>(), get_type_identifier<files>(), [](std::shared_ptr<variable> lhs, std::shared_ptr<variable> rhs) -> std::shared_ptr<variable> {
+        return lhs->as<files>()->remove(*rhs->as<files>());
+    });
+
+    return {};
+}();
+
+std::shared_ptr<reaver::despayre::_v1::files> reaver::despayre::_v1::files::unite(const reaver::despayre::_v1::files & other) const
+{
+    // a removal applies to the files it was made from, and not to whatever they are later joined with
+    if ((_globs.empty() && other._globs.empty()) || !_removed.empty() || !other._removed.empty())
+    {
+        std::vector<boost::filesystem::path> result;
+        std::set_union(paths().begin(), paths().end(), other.paths().begin(), other.paths().end(), std::back_inserter(result));
+        return std::make_shared<files>(std::move(result), sorted_tag{});
+    }
+
+    auto globs = _globs;
+    globs.insert(globs.end(), other._globs.begin(), other._globs.end());
+
+    std::vector<boost::filesystem::path> explicit_paths;
+    std::set_union(_explicit_paths().begin(), _explicit_paths().end(), other._explicit_paths().begin(), other._explicit_paths().end(), std::back_inserter(explicit_paths));
+
+    return std::make_shared<files>(std::move(globs), std::move(explicit_paths), std::vector<boost::filesystem::path>{});
+}
+
+std::shared_ptr<reaver::despayre::_v1::files> reaver::despayre::_v1::files::remove(const reaver::despayre::_v1::files & other) const
+{
+    // the globs of `other` become exclusions of the walks of these globs, which is only the same when
+    // - `other` is a plain union of globs and paths,
+    // - the explicit paths here don't need its globs walked, and
+    // - every walk here reaches whatever the globs of `other` match the same way their own walks would
+    auto push_down = !_globs.empty() && other._removed.empty() && (_explicit.empty() || other._globs.empty())
+        && std::all_of(other._globs.begin(), other._globs.end(), [&](auto && removed) {
+            return removed.query.excluded.empty() && std::all_of(_globs.begin(), _globs.end(), [&](auto && glob) {
+                return can_exclude(glob.query.pattern, removed.query.pattern);
+            });
+        });
+
+    if (!push_down)
+    {
+        std::vector<boost::filesystem::path> result;
+        std::set_difference(paths().begin(), paths().end(), other.paths().begin(), other.paths().end(), std::back_inserter(result));
+        return std::make_shared<files>(std::move(result), sorted_tag{});
+    }
+
+    auto globs = _globs;
+    for (auto && glob : globs)
+    {
+        for (auto && removed : other._globs)
+        {
+            glob.query.excluded.push_back(removed.query.pattern);
+        }
+    }
+
+    std::vector<boost::filesystem::path> explicit_paths;
+    std::set_difference(_explicit.begin(), _explicit.end(), other._explicit_paths().begin(), other._explicit_paths().end(), std::back_inserter(explicit_paths));
+
+    std::vector<boost::filesystem::path> removed;
+    std::set_union(_removed.begin(), _removed.end(), other._explicit_paths().begin(), other._explicit_paths().end(), std::back_inserter(removed));
+
+    return std::make_shared<files>(std::move(globs), std::move(explicit_paths), std::move(removed));
+}
+
+void reaver::despayre::_v1::files::_walk() const
+{
+    auto result = _explicit;
+
+    for (auto && glob : _globs)
+    {
+        auto walk = glob.options ? match_glob(glob.query, 0, *glob.options) : match_glob(glob.query);
+        if (glob.globbed_directories)
+        {
+            for (auto && directory : walk.directories)
+            {
+                glob.globbed_directories->emplace(std::move(directory.path), directory.last_write_time);
+            }
+        }
+
+        std::vector<boost::filesystem::path> merged;
+        std::set_union(result.begin(), result.end(), walk.matches.begin(), walk.matches.end(), std::back_inserter(merged));
+        result = std::move(merged);
+    }
+
+    _args.clear();
+    std::set_difference(result.begin(), result.end(), _removed.begin(), _removed.end(), std::back_inserter(_args));
+}
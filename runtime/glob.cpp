@@ -0,0 +1,701 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/algorithm/string/split.hpp>
+
+#include <reaver/exception.h>
+#include <reaver/logger.h>
+
+#include "despayre/runtime/glob.h"
+#include "despayre/runtime/file_status.h"
+
+namespace
+{
+    // bit i is set when the i-th component of the pattern is the next one to match
+    using match_state = std::uint64_t;
+
+    struct compiled_pattern
+    {
+        std::string prefix; // the literal directories the pattern starts with, with a trailing slash
+        std::vector<std::string> components;
+
+        bool is_absolute() const
+        {
+            return !prefix.empty() && prefix.front() == '/';
+        }
+
+        bool is_globstar(std::size_t i) const
+        {
+            return components[i] == "**";
+        }
+
+        // with FNM_PERIOD, a leading dot is only matched by a dot (or an escaped one)
+        bool matches_hidden() const
+        {
+            return std::any_of(components.begin(), components.end(), [](auto && component) {
+                return component.front() == '.' || component.front() == '\\';
+            });
+        }
+
+        // `**` may also match no directories at all
+        match_state closure(match_state state) const
+        {
+            for (std::size_t i = 0; i + 1 < components.size(); ++i)
+            {
+                if ((state & (match_state{ 1 } << i)) && is_globstar(i))
+                {
+                    state |= match_state{ 1 } << (i + 1);
+                }
+            }
+
+            return state;
+        }
+
+        match_state initial() const
+        {
+            return closure(1);
+        }
+
+        bool matches_file(match_state state, const char * name) const
+        {
+            auto last = components.size() - 1;
+            if (!(state & (match_state{ 1 } << last)))
+            {
+                return false;
+            }
+
+            if (is_globstar(last))
+            {
+                return name[0] != '.';
+            }
+
+            return fnmatch(components[last].c_str(), name, FNM_PERIOD) == 0;
+        }
+
+        match_state enter(match_state state, const char * name) const
+        {
+            match_state next = 0;
+
+            for (std::size_t i = 0; i < components.size(); ++i)
+            {
+                if (!(state & (match_state{ 1 } << i)))
+                {
+                    continue;
+                }
+
+                if (is_globstar(i))
+                {
+                    if (name[0] != '.')
+                    {
+                        next |= match_state{ 1 } << i;
+                    }
+                }
+
+                else if (i + 1 < components.size() && fnmatch(components[i].c_str(), name, FNM_PERIOD) == 0)
+                {
+                    next |= match_state{ 1 } << (i + 1);
+                }
+            }
+
+            return closure(next);
+        }
+
+        // whether every non-hidden file below a directory in `state`, that `last` matches, is matched too
+        bool covers(match_state state, const std::string & last) const
+        {
+            for (std::size_t i = 0; i < components.size(); ++i)
+            {
+                if (!(state & (match_state{ 1 } << i)) || !is_globstar(i))
+                {
+                    continue;
+                }
+
+                if (i + 1 == components.size() || (i + 2 == components.size() && (components[i + 1] == last || components[i + 1] == "*")))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    std::vector<std::string> split_components(const std::string & path)
+    {
+        std::vector<std::string> components;
+        boost::algorithm::split(components, path, [](char c) { return c == '/'; });
+        components.erase(std::remove_if(components.begin(), components.end(), [](auto && component) {
+            return component.empty() || component == ".";
+        }), components.end());
+        return components;
+    }
+
+    compiled_pattern compile(const std::string & pattern)
+    {
+        auto is_wildcard = [](const std::string & component) {
+            return component.find_first_of("*?[") != std::string::npos;
+        };
+
+        auto components = split_components(pattern);
+
+        compiled_pattern ret;
+        ret.prefix = pattern.size() && pattern.front() == '/' ? "/" : "";
+
+        auto it = components.begin();
+        for (; it != components.end() && std::next(it) != components.end() && !is_wildcard(*it); ++it)
+        {
+            ret.prefix += *it + "/";
+        }
+        ret.components.assign(it, components.end());
+
+        if (ret.components.size() > 64)
+        {
+            throw reaver::exception{ reaver::logger::error } << "glob pattern `" << pattern << "` has too many components.";
+        }
+
+        return ret;
+    }
+
+    // makes `excluded` match from the root of `pattern`, by turning the rest of its root into literal components
+    // fails when its root is elsewhere, in which case the walk can't tell what it matches
+    bool rebase(const compiled_pattern & pattern, compiled_pattern & excluded)
+    {
+        if (pattern.components.empty() || excluded.components.empty()
+            || pattern.is_absolute() != excluded.is_absolute()
+            || excluded.prefix.compare(0, pattern.prefix.size(), pattern.prefix) != 0)
+        {
+            return false;
+        }
+
+        auto literals = split_components(excluded.prefix.substr(pattern.prefix.size()));
+        if (literals.size() + excluded.components.size() > 64 || std::any_of(literals.begin(), literals.end(), [](auto && literal) {
+            return literal.find('\\') != std::string::npos;
+        }))
+        {
+            return false;
+        }
+
+        excluded.prefix = pattern.prefix;
+        excluded.components.insert(excluded.components.begin(), literals.begin(), literals.end());
+        return true;
+    }
+
+    // sorts like boost::filesystem::path does, which compares component by component
+    bool path_order(const std::string & lhs, const std::string & rhs)
+    {
+        return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](char l, char r) {
+            auto rank = [](char c) { return c == '/' ? 0 : static_cast<unsigned char>(c) + 1; };
+            return rank(l) < rank(r);
+        });
+    }
+
+    class walker
+    {
+    public:
+        walker(const compiled_pattern & pattern, std::vector<compiled_pattern> excluded, const reaver::despayre::glob_options & options, std::size_t threads)
+            : _pattern{ pattern }, _excluded{ std::move(excluded) }, _prunable{ !_pattern.matches_hidden() }, _ignored{ options.ignored }, _queues(threads), _results(threads)
+        {
+            for (auto && output : options.output_directories)
+            {
+                struct stat status;
+                if (::stat(output.c_str(), &status) == 0)
+                {
+                    _outputs.emplace_back(status.st_dev, status.st_ino);
+                }
+            }
+        }
+
+        ~walker()
+        {
+            if (_root >= 0)
+            {
+                ::close(_root);
+            }
+        }
+
+        reaver::despayre::glob_result run();
+
+    private:
+        struct directory
+        {
+            std::string path; // relative to the root, with a trailing slash unless it is the root
+            match_state state;
+            std::vector<match_state> excluded; // one for each excluded pattern
+        };
+
+        struct alignas(64) queue
+        {
+            std::mutex lock;
+            std::deque<directory> directories;
+        };
+
+        struct partial_result
+        {
+            std::vector<std::string> matches;
+            std::vector<reaver::despayre::globbed_directory> directories;
+        };
+
+        std::string _root_path() const
+        {
+            if (_pattern.prefix.empty())
+            {
+                return ".";
+            }
+
+            if (_pattern.prefix == "/")
+            {
+                return "/";
+            }
+
+            return _pattern.prefix.substr(0, _pattern.prefix.size() - 1);
+        }
+
+        // `path` is relative to the working directory, `at` to `fd`
+        bool _skipped(const char * name, const std::string & path, ino_t inode, int fd, const char * at) const;
+        void _push(std::size_t id, std::vector<directory> & directories);
+        bool _pop(std::size_t id, directory & dir);
+        void _work(std::size_t id);
+        void _read(std::size_t id, const directory & dir);
+        void _wake();
+
+        bool _excluded_file(const directory & dir, const char * name) const
+        {
+            for (std::size_t i = 0; i < _excluded.size(); ++i)
+            {
+                if (dir.excluded[i] && _excluded[i].matches_file(dir.excluded[i], name))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        const compiled_pattern & _pattern;
+        std::vector<compiled_pattern> _excluded;
+        // an excluded pattern can only stand in for a whole subtree when the pattern can't match hidden files there
+        bool _prunable;
+        std::vector<std::string> _ignored;
+        std::vector<std::pair<dev_t, ino_t>> _outputs;
+        int _root = -1;
+        std::vector<queue> _queues;
+        std::vector<partial_result> _results;
+        std::vector<std::thread> _helpers;
+        std::atomic<std::size_t> _pending{ 0 }; // pushed and not yet read
+        std::atomic<std::size_t> _queued{ 0 }; // pushed and not yet popped
+
+        // threads with nothing to pop wait here until there is something to steal, or the walk is over
+        std::mutex _idle_lock;
+        std::condition_variable _idle_condition;
+
+        // the first error of any thread; it ends the walk, and is rethrown by run once the helpers are joined
+        std::atomic<bool> _failed{ false };
+        std::exception_ptr _error;
+    };
+
+    reaver::despayre::glob_result walker::run()
+    {
+        using namespace reaver::despayre;
+
+        glob_result ret;
+
+        if (_pattern.components.empty())
+        {
+            return ret;
+        }
+
+        // the literal directories of the pattern aren't walked, but they can't lead anywhere the walk wouldn't go either
+        auto path = _pattern.is_absolute() ? std::string{ "/" } : std::string{};
+        for (auto && component : split_components(_pattern.prefix))
+        {
+            path += component;
+
+            struct stat status;
+            if (::stat(path.c_str(), &status) == 0 && (_skipped(component.c_str(), path, status.st_ino, AT_FDCWD, path.c_str())
+                || ::access((path + "/.despayre_log").c_str(), F_OK) == 0))
+            {
+                return ret;
+            }
+
+            path += "/";
+        }
+
+        _root = ::open(_root_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (_root < 0)
+        {
+            // nothing matches yet, but creating the root could change that
+            ret.directories.push_back({ _root_path(), stat_file(_root_path()).last_write_time });
+            return ret;
+        }
+
+        std::vector<directory> root{ { "", _pattern.initial(), {} } };
+        for (auto && excluded : _excluded)
+        {
+            root.front().excluded.push_back(excluded.initial());
+        }
+        _push(0, root);
+        _work(0);
+
+        for (auto && helper : _helpers)
+        {
+            helper.join();
+        }
+
+        if (_error)
+        {
+            std::rethrow_exception(_error);
+        }
+
+        std::vector<std::string> matches;
+        for (auto && result : _results)
+        {
+            matches.insert(matches.end(), std::make_move_iterator(result.matches.begin()), std::make_move_iterator(result.matches.end()));
+            ret.directories.insert(ret.directories.end(), std::make_move_iterator(result.directories.begin()), std::make_move_iterator(result.directories.end()));
+        }
+
+        std::sort(matches.begin(), matches.end(), path_order);
+        ret.matches.reserve(matches.size());
+        for (auto && match : matches)
+        {
+            ret.matches.emplace_back(_pattern.prefix + match);
+        }
+
+        return ret;
+    }
+
+    bool walker::_skipped(const char * name, const std::string & path, ino_t inode, int fd, const char * at) const
+    {
+        if (std::strcmp(name, ".git") == 0)
+        {
+            return true;
+        }
+
+        for (auto && output : _outputs)
+        {
+            struct stat status;
+            if (output.second == inode && ::fstatat(fd, at, &status, AT_SYMLINK_NOFOLLOW) == 0 && status.st_dev == output.first)
+            {
+                return true;
+            }
+        }
+
+        for (auto && ignored : _ignored)
+        {
+            if (ignored.find('/') == std::string::npos)
+            {
+                if (fnmatch(ignored.c_str(), name, FNM_PERIOD) == 0)
+                {
+                    return true;
+                }
+            }
+
+            // paths are relative to the working directory, which an absolute glob doesn't walk from
+            else if (!_pattern.is_absolute())
+            {
+                if (fnmatch(ignored.c_str() + (ignored.front() == '/'), path.c_str(), FNM_PATHNAME | FNM_PERIOD) == 0)
+                {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    void walker::_push(std::size_t id, std::vector<directory> & directories)
+    {
+        if (directories.empty())
+        {
+            return;
+        }
+
+        // counted before they are visible, so that nobody sees the walk as finished in between
+        _pending += directories.size();
+
+        {
+            std::lock_guard<std::mutex> lock{ _queues[id].lock };
+            std::move(directories.begin(), directories.end(), std::back_inserter(_queues[id].directories));
+            _queued += directories.size();
+        }
+
+        _wake();
+    }
+
+    bool walker::_pop(std::size_t id, directory & dir)
+    {
+        {
+            auto & own = _queues[id];
+            std::lock_guard<std::mutex> lock{ own.lock };
+            if (!own.directories.empty())
+            {
+                dir = std::move(own.directories.back());
+                own.directories.pop_back();
+                --_queued;
+                return true;
+            }
+        }
+
+        // steal the oldest directories, as those are the closest to the root and tend to have the most left below them
+        for (std::size_t i = 1; i < _queues.size(); ++i)
+        {
+            auto & other = _queues[(id + i) % _queues.size()];
+            std::lock_guard<std::mutex> lock{ other.lock };
+            if (!other.directories.empty())
+            {
+                dir = std::move(other.directories.front());
+                other.directories.pop_front();
+                --_queued;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void walker::_work(std::size_t id)
+    {
+        try
+        {
+            directory dir;
+
+            while (_pending.load() != 0 && !_failed.load())
+            {
+                // the helpers are only started once there is more than one directory to read, so single directory globs stay on the calling thread
+                if (id == 0 && _helpers.empty() && _queues.size() > 1 && _pending.load() > 1)
+                {
+                    for (std::size_t i = 1; i < _queues.size(); ++i)
+                    {
+                        _helpers.emplace_back([this, i]{ _work(i); });
+                    }
+                }
+
+                if (!_pop(id, dir))
+                {
+                    std::unique_lock<std::mutex> lock{ _idle_lock };
+                    _idle_condition.wait(lock, [&]{ return _queued.load() != 0 || _pending.load() == 0 || _failed.load(); });
+                    continue;
+                }
+
+                _read(id, dir);
+                if (--_pending == 0)
+                {
+                    _wake();
+                }
+            }
+        }
+
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock{ _idle_lock };
+            if (!_error)
+            {
+                _error = std::current_exception();
+            }
+            _failed = true;
+            _idle_condition.notify_all();
+        }
+    }
+
+    // the waiters check their condition with the lock held, so taking it here means none of them can miss the change that was just made
+    void walker::_wake()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ _idle_lock };
+        }
+        _idle_condition.notify_all();
+    }
+
+    void walker::_read(std::size_t id, const directory & dir)
+    {
+        auto fd = ::openat(_root, dir.path.empty() ? "." : dir.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        auto stream = ::fdopendir(fd);
+        if (!stream)
+        {
+            ::close(fd);
+            return;
+        }
+
+        auto & result = _results[id];
+        auto output = false;
+        std::vector<std::string> matches;
+        std::vector<directory> subdirectories;
+
+        while (auto entry = ::readdir(stream))
+        {
+            auto name = entry->d_name;
+            if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0)
+            {
+                continue;
+            }
+
+            // an output directory of some other build
+            if (std::strcmp(name, ".despayre_log") == 0)
+            {
+                output = true;
+            }
+
+            auto type = entry->d_type;
+            if (type == DT_UNKNOWN)
+            {
+                struct stat status;
+                if (::fstatat(fd, name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    continue;
+                }
+
+                type = S_ISREG(status.st_mode) ? DT_REG : S_ISDIR(status.st_mode) ? DT_DIR : S_ISLNK(status.st_mode) ? DT_LNK : DT_UNKNOWN;
+            }
+
+            // symlinks count as what they point to, unless that's a directory, which could lead anywhere (including back up)
+            if (type == DT_LNK)
+            {
+                struct stat status;
+                if (::fstatat(fd, name, &status, 0) != 0 || !S_ISREG(status.st_mode))
+                {
+                    continue;
+                }
+
+                type = DT_REG;
+            }
+
+            if (type == DT_REG)
+            {
+                if (_pattern.matches_file(dir.state, name) && !_excluded_file(dir, name))
+                {
+                    matches.push_back(dir.path + name);
+                }
+            }
+
+            else if (type == DT_DIR)
+            {
+                auto state = _pattern.enter(dir.state, name);
+                if (!state || _skipped(name, _pattern.prefix + dir.path + name, entry->d_ino, fd, name))
+                {
+                    continue;
+                }
+
+                directory subdirectory{ dir.path + name + "/", state, {} };
+                auto covered = false;
+                for (std::size_t i = 0; i < _excluded.size(); ++i)
+                {
+                    subdirectory.excluded.push_back(dir.excluded[i] ? _excluded[i].enter(dir.excluded[i], name) : 0);
+                    covered = covered || (_prunable && _excluded[i].covers(subdirectory.excluded.back(), _pattern.components.back()));
+                }
+
+                if (!covered)
+                {
+                    subdirectories.push_back(std::move(subdirectory));
+                }
+            }
+        }
+
+        if (output && !(dir.path.empty() && _pattern.prefix.empty()))
+        {
+            ::closedir(stream);
+            return;
+        }
+
+        result.matches.insert(result.matches.end(), std::make_move_iterator(matches.begin()), std::make_move_iterator(matches.end()));
+
+        // despayre's own outputs change with every build, so they don't invalidate globs
+        if (!output)
+        {
+            struct stat status;
+            if (::fstat(fd, &status) == 0)
+            {
+                auto path = dir.path.empty() ? _root_path() : _pattern.prefix + dir.path.substr(0, dir.path.size() - 1);
+                result.directories.push_back({ std::move(path), static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec });
+            }
+        }
+
+        ::closedir(stream);
+        _push(id, subdirectories);
+    }
+}
+
+std::vector<std::string> reaver::despayre::_v1::read_ignore_file(const boost::filesystem::path & path)
+{
+    std::vector<std::string> ret;
+
+    std::ifstream input{ path.string() };
+    std::string line;
+    while (std::getline(input, line))
+    {
+        while (!line.empty() && (line.back() == '/' || std::isspace(static_cast<unsigned char>(line.back()))))
+        {
+            line.pop_back();
+        }
+
+        if (!line.empty() && line.front() != '#')
+        {
+            ret.push_back(std::move(line));
+        }
+    }
+
+    return ret;
+}
+
+bool reaver::despayre::_v1::can_exclude(const std::string & pattern, const std::string & excluded)
+{
+    auto compiled = compile(excluded);
+    return rebase(compile(pattern), compiled);
+}
+
+reaver::despayre::_v1::glob_result reaver::despayre::_v1::match_glob(const reaver::despayre::_v1::glob_query & query, std::size_t threads, const reaver::despayre::_v1::glob_options & options)
+{
+    auto compiled = compile(query.pattern);
+
+    std::vector<compiled_pattern> excluded;
+    for (auto && pattern : query.excluded)
+    {
+        excluded.push_back(compile(pattern));
+        if (!rebase(compiled, excluded.back()))
+        {
+            throw exception{ logger::fatal } << "glob pattern `" << pattern << "` can't be excluded from the walk of `" << query.pattern << "`.";
+        }
+    }
+
+    walker walk{ compiled, std::move(excluded), options, threads ? threads : std::max(std::thread::hardware_concurrency(), 1u) };
+    return walk.run();
+}
@@ -0,0 +1,196 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <cstring>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <reaver/exception.h>
+
+#include "despayre/runtime/environment.h"
+#include "despayre/runtime/hash.h"
+
+namespace
+{
+    constexpr std::uint64_t prime1 = 11400714785074694791ull;
+    constexpr std::uint64_t prime2 = 14029467366897019727ull;
+    constexpr std::uint64_t prime3 = 1609587929392839161ull;
+    constexpr std::uint64_t prime4 = 9650029242287828579ull;
+    constexpr std::uint64_t prime5 = 2870177450012600261ull;
+
+    std::uint64_t rotate_left(std::uint64_t value, int count)
+    {
+        return (value << count) | (value >> (64 - count));
+    }
+
+    std::uint64_t read64(const unsigned char * ptr)
+    {
+        std::uint64_t ret;
+        std::memcpy(&ret, ptr, sizeof(ret));
+        return ret;
+    }
+
+    std::uint32_t read32(const unsigned char * ptr)
+    {
+        std::uint32_t ret;
+        std::memcpy(&ret, ptr, sizeof(ret));
+        return ret;
+    }
+
+    std::uint64_t round(std::uint64_t accumulator, std::uint64_t input)
+    {
+        accumulator += input * prime2;
+        accumulator = rotate_left(accumulator, 31);
+        return accumulator * prime1;
+    }
+
+    std::uint64_t merge_round(std::uint64_t accumulator, std::uint64_t value)
+    {
+        accumulator ^= round(0, value);
+        return accumulator * prime1 + prime4;
+    }
+}
+
+std::uint64_t reaver::despayre::_v1::hash_bytes(const void * data, std::size_t size, std::uint64_t seed)
+{
+    auto ptr = static_cast<const unsigned char *>(data);
+    auto end = ptr + size;
+
+    std::uint64_t hash;
+
+    if (size >= 32)
+    {
+        std::uint64_t lanes[4] = { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 };
+
+        auto limit = end - 32;
+        do
+        {
+            for (auto i = 0; i < 4; ++i)
+            {
+                lanes[i] = round(lanes[i], read64(ptr + i * 8));
+            }
+            ptr += 32;
+        } while (ptr <= limit);
+
+        hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) + rotate_left(lanes[3], 18);
+        for (auto lane : lanes)
+        {
+            hash = merge_round(hash, lane);
+        }
+    }
+
+    else
+    {
+        hash = seed + prime5;
+    }
+
+    hash += size;
+
+    while (ptr + 8 <= end)
+    {
+        hash ^= round(0, read64(ptr));
+        hash = rotate_left(hash, 27) * prime1 + prime4;
+        ptr += 8;
+    }
+
+    if (ptr + 4 <= end)
+    {
+        hash ^= read32(ptr) * prime1;
+        hash = rotate_left(hash, 23) * prime2 + prime3;
+        ptr += 4;
+    }
+
+    while (ptr < end)
+    {
+        hash ^= *ptr * prime5;
+        hash = rotate_left(hash, 11) * prime1;
+        ++ptr;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+std::uint64_t reaver::despayre::_v1::hash_file(const boost::filesystem::path & path)
+{
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw exception{ logger::error } << "failed to open `" << path.string() << "` for hashing.";
+    }
+
+    struct stat buffer;
+    if (::fstat(fd, &buffer) != 0)
+    {
+        ::close(fd);
+        throw exception{ logger::error } << "failed to stat `" << path.string() << "` for hashing.";
+    }
+
+    if (buffer.st_size == 0)
+    {
+        ::close(fd);
+        return hash_bytes(nullptr, 0);
+    }
+
+    auto mapping = ::mmap(nullptr, buffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        throw exception{ logger::error } << "failed to map `" << path.string() << "` for hashing.";
+    }
+
+    auto ret = hash_bytes(mapping, buffer.st_size);
+    ::munmap(mapping, buffer.st_size);
+
+    return ret;
+}
+
+std::uint64_t reaver::despayre::_v1::hash_command(const std::vector<std::string> & args, const std::vector<std::string> & names, const std::vector<std::string> & environment)
+{
+    // every piece is chained through the seed, so that moving a boundary between two pieces changes the result
+    std::uint64_t hash = hash_bytes(nullptr, 0, args.size());
+
+    for (auto && arg : args)
+    {
+        hash = hash_bytes(arg.data(), arg.size(), hash);
+    }
+
+    for (auto && name : names)
+    {
+        hash = hash_bytes(name.data(), name.size(), hash);
+
+        auto value = find_variable(environment, name);
+        hash = value ? hash_bytes(value, std::strlen(value), hash) : hash_bytes(nullptr, 0, ~hash);
+    }
+
+    return hash;
+}
@@ -0,0 +1,417 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <cerrno>
+#include <memory>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include "despayre/runtime/protocol.h"
+
+namespace
+{
+    // frames larger than this are refused, so that a corrupted length can't make anyone allocate gigabytes
+    const std::uint32_t max_frame_size = 1u << 30;
+
+    void write_all(int fd, const char * data, std::size_t size)
+    {
+        while (size)
+        {
+            auto ret = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (ret <= 0)
+            {
+                throw reaver::despayre::protocol_error{ "failed to write to a connection: " + std::string{ std::strerror(errno) } };
+            }
+
+            data += ret;
+            size -= ret;
+        }
+    }
+
+    // returns false if the connection was closed before anything was read
+    bool read_all(int fd, char * data, std::size_t size)
+    {
+        std::size_t done = 0;
+        while (done < size)
+        {
+            auto ret = ::recv(fd, data + done, size - done, 0);
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (ret == 0 && done == 0)
+            {
+                return false;
+            }
+
+            if (ret <= 0)
+            {
+                throw reaver::despayre::protocol_error{ ret == 0 ? "connection closed in the middle of a frame." : "failed to read from a connection: " + std::string{ std::strerror(errno) } };
+            }
+
+            done += ret;
+        }
+
+        return true;
+    }
+
+    void set_timeout(int fd, std::uint32_t timeout_ms)
+    {
+        if (timeout_ms)
+        {
+            timeval timeout{};
+            timeout.tv_sec = timeout_ms / 1000;
+            timeout.tv_usec = (timeout_ms % 1000) * 1000;
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        }
+    }
+
+    std::unique_ptr<addrinfo, void (*)(addrinfo *)> resolve(const std::string & host, const std::string & port, bool passive)
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+        addrinfo * result = nullptr;
+        auto error = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+        if (error != 0)
+        {
+            throw reaver::despayre::protocol_error{ "failed to resolve `" + host + ":" + port + "`: " + ::gai_strerror(error) };
+        }
+
+        return { result, ::freeaddrinfo };
+    }
+
+    // splits `host:port`, where the host may be a bracketed ipv6 address
+    std::pair<std::string, std::string> split_host(const std::string & address)
+    {
+        auto colon = address.rfind(':');
+        if (colon == std::string::npos)
+        {
+            throw reaver::despayre::protocol_error{ "`" + address + "` is missing a port." };
+        }
+
+        auto host = address.substr(0, colon);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+        {
+            host = host.substr(1, host.size() - 2);
+        }
+
+        return { host, address.substr(colon + 1) };
+    }
+
+    sockaddr_un socket_address(const boost::filesystem::path & path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+
+        auto string = path.string();
+        if (string.size() >= sizeof(address.sun_path))
+        {
+            throw reaver::despayre::protocol_error{ "socket path `" + string + "` is too long." };
+        }
+        std::memcpy(address.sun_path, string.c_str(), string.size() + 1);
+
+        return address;
+    }
+}
+
+void reaver::despayre::_v1::write_frame(int fd, const std::string & body)
+{
+    std::string frame;
+    frame.reserve(sizeof(std::uint32_t) + body.size());
+    put_value<std::uint32_t>(frame, body.size());
+    frame += body;
+
+    write_all(fd, frame.data(), frame.size());
+}
+
+reaver::optional<std::string> reaver::despayre::_v1::read_frame(int fd)
+{
+    std::uint32_t size;
+    if (!read_all(fd, reinterpret_cast<char *>(&size), sizeof(size)))
+    {
+        return none;
+    }
+
+    if (size > max_frame_size)
+    {
+        throw protocol_error{ "frame too large." };
+    }
+
+    std::string body(size, '\0');
+    if (size && !read_all(fd, &body[0], size))
+    {
+        throw protocol_error{ "connection closed in the middle of a frame." };
+    }
+
+    return body;
+}
+
+void reaver::despayre::_v1::send_fds(int socket, const std::vector<int> & fds)
+{
+    char byte = 0;
+    ::iovec data{ &byte, 1 };
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+
+    ::msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+
+    auto header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * fds.size());
+
+    ssize_t ret;
+    do
+    {
+        ret = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret != 1)
+    {
+        throw protocol_error{ "failed to pass file descriptors: " + std::string{ std::strerror(errno) } };
+    }
+}
+
+std::vector<int> reaver::despayre::_v1::receive_fds(int socket, std::size_t count)
+{
+    char byte;
+    ::iovec data{ &byte, 1 };
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * count));
+
+    ::msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+
+    ssize_t ret;
+    do
+    {
+        ret = ::recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret != 1)
+    {
+        throw protocol_error{ ret == 0 ? "connection closed while waiting for file descriptors." : "failed to receive file descriptors: " + std::string{ std::strerror(errno) } };
+    }
+
+    std::vector<int> fds;
+    for (auto header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+    {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+        {
+            auto received = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            auto begin = fds.size();
+            fds.resize(begin + received);
+            std::memcpy(fds.data() + begin, CMSG_DATA(header), received * sizeof(int));
+        }
+    }
+
+    if (fds.size() != count || (message.msg_flags & MSG_CTRUNC))
+    {
+        for (auto && fd : fds)
+        {
+            ::close(fd);
+        }
+        throw protocol_error{ "received an unexpected number of file descriptors." };
+    }
+
+    return fds;
+}
+
+int reaver::despayre::_v1::connect_unix_socket(const boost::filesystem::path & path, std::uint32_t timeout_ms)
+{
+    auto address = socket_address(path);
+
+    auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throw protocol_error{ "failed to create a socket: " + std::string{ std::strerror(errno) } };
+    }
+
+    set_timeout(fd, timeout_ms);
+
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        auto error = errno;
+        ::close(fd);
+        throw protocol_error{ "failed to connect to `" + path.string() + "`: " + std::strerror(error) };
+    }
+
+    return fd;
+}
+
+int reaver::despayre::_v1::listen_unix_socket(const boost::filesystem::path & path)
+{
+    auto address = socket_address(path);
+
+    // only remove the file if nobody is listening on it anymore
+    if (boost::filesystem::exists(path))
+    {
+        bool alive = false;
+        try
+        {
+            ::close(connect_unix_socket(path));
+            alive = true;
+        }
+        catch (protocol_error &)
+        {
+        }
+
+        if (alive)
+        {
+            throw protocol_error{ "`" + path.string() + "` is already in use." };
+        }
+
+        ::unlink(path.c_str());
+    }
+
+    auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throw protocol_error{ "failed to create a socket: " + std::string{ std::strerror(errno) } };
+    }
+
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0)
+    {
+        auto error = errno;
+        ::close(fd);
+        throw protocol_error{ "failed to listen on `" + path.string() + "`: " + std::strerror(error) };
+    }
+
+    return fd;
+}
+
+int reaver::despayre::_v1::connect_tcp_socket(const std::string & host, const std::string & port, std::uint32_t timeout_ms)
+{
+    auto addresses = resolve(host, port, false);
+
+    int error = 0;
+    for (auto address = addresses.get(); address; address = address->ai_next)
+    {
+        auto fd = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0)
+        {
+            error = errno;
+            continue;
+        }
+
+        set_timeout(fd, timeout_ms);
+
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+        {
+            // requests are single small frames; waiting to coalesce them only adds latency
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+
+        error = errno;
+        ::close(fd);
+    }
+
+    throw protocol_error{ "failed to connect to `" + host + ":" + port + "`: " + std::strerror(error) };
+}
+
+int reaver::despayre::_v1::listen_tcp_socket(const std::string & host, const std::string & port)
+{
+    // none of the servers authenticate their clients, so they aren't exposed to the network unless asked to
+    auto addresses = resolve(host.empty() ? "localhost" : host, port, true);
+
+    int error = 0;
+    for (auto address = addresses.get(); address; address = address->ai_next)
+    {
+        auto fd = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0)
+        {
+            error = errno;
+            continue;
+        }
+
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (::bind(fd, address->ai_addr, address->ai_addrlen) == 0 && ::listen(fd, SOMAXCONN) == 0)
+        {
+            return fd;
+        }
+
+        error = errno;
+        ::close(fd);
+    }
+
+    throw protocol_error{ "failed to listen on `" + host + ":" + port + "`: " + std::strerror(error) };
+}
+
+int reaver::despayre::_v1::connect_endpoint(const std::string & endpoint, std::uint32_t timeout_ms)
+{
+    if (endpoint.compare(0, 4, "tcp:") == 0)
+    {
+        auto address = split_host(endpoint.substr(4));
+        return connect_tcp_socket(address.first, address.second, timeout_ms);
+    }
+
+    if (endpoint.compare(0, 5, "unix:") == 0)
+    {
+        return connect_unix_socket(endpoint.substr(5), timeout_ms);
+    }
+
+    return connect_unix_socket(endpoint, timeout_ms);
+}
+
+int reaver::despayre::_v1::listen_endpoint(const std::string & endpoint)
+{
+    if (endpoint.compare(0, 4, "tcp:") == 0)
+    {
+        auto address = split_host(endpoint.substr(4));
+        return listen_tcp_socket(address.first, address.second);
+    }
+
+    if (endpoint.compare(0, 5, "unix:") == 0)
+    {
+        return listen_unix_socket(endpoint.substr(5));
+    }
+
+    return listen_unix_socket(endpoint);
+}
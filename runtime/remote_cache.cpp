@@ -0,0 +1,196 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <unistd.h>
+
+#include "despayre/runtime/remote_cache.h"
+
+namespace
+{
+    void put_file(std::string & buffer, const reaver::despayre::action_result::file & file)
+    {
+        reaver::despayre::put_value(buffer, file.hash);
+        reaver::despayre::put_value(buffer, file.mode);
+        reaver::despayre::put_string(buffer, file.path.string());
+    }
+
+    reaver::despayre::action_result::file get_file(reaver::despayre::message_reader & reader)
+    {
+        reaver::despayre::action_result::file file;
+        file.hash = reader.get<std::uint64_t>();
+        file.mode = reader.get<std::uint32_t>();
+        file.path = reader.get_string();
+        return file;
+    }
+
+    std::string request(reaver::despayre::cache_operation operation, std::uint64_t key)
+    {
+        std::string body;
+        reaver::despayre::put_value(body, operation);
+        reaver::despayre::put_value(body, key);
+        return body;
+    }
+}
+
+void reaver::despayre::_v1::encode(std::string & buffer, const reaver::despayre::_v1::action_result & result)
+{
+    put_value<std::uint32_t>(buffer, result.inputs.size());
+    for (auto && input : result.inputs)
+    {
+        put_file(buffer, input);
+    }
+
+    put_value<std::uint32_t>(buffer, result.outputs.size());
+    for (auto && output : result.outputs)
+    {
+        put_file(buffer, output);
+    }
+}
+
+reaver::despayre::_v1::action_result reaver::despayre::_v1::decode_action_result(reaver::despayre::_v1::message_reader & reader)
+{
+    action_result result;
+
+    auto inputs = reader.get<std::uint32_t>();
+    for (auto i = 0u; i < inputs; ++i)
+    {
+        result.inputs.push_back(get_file(reader));
+    }
+
+    auto outputs = reader.get<std::uint32_t>();
+    for (auto i = 0u; i < outputs; ++i)
+    {
+        result.outputs.push_back(get_file(reader));
+    }
+
+    return result;
+}
+
+reaver::despayre::_v1::unix_socket_cache::~unix_socket_cache()
+{
+    for (auto && fd : _idle)
+    {
+        ::close(fd);
+    }
+}
+
+reaver::optional<std::string> reaver::despayre::_v1::unix_socket_cache::get_blob(std::uint64_t hash)
+{
+    auto response = _request(request(cache_operation::get_blob, hash));
+    message_reader reader{ response };
+
+    if (reader.get<cache_status>() != cache_status::ok)
+    {
+        return none;
+    }
+
+    return reader.get_string();
+}
+
+void reaver::despayre::_v1::unix_socket_cache::put_blob(std::uint64_t hash, const std::string & contents)
+{
+    auto body = request(cache_operation::put_blob, hash);
+    put_string(body, contents);
+
+    auto response = _request(body);
+    message_reader reader{ response };
+
+    if (reader.get<cache_status>() != cache_status::ok)
+    {
+        throw protocol_error{ "the cache server refused a blob." };
+    }
+}
+
+std::vector<reaver::despayre::_v1::action_result> reaver::despayre::_v1::unix_socket_cache::get_action(std::uint64_t key)
+{
+    auto response = _request(request(cache_operation::get_action, key));
+    message_reader reader{ response };
+
+    std::vector<action_result> results;
+    if (reader.get<cache_status>() != cache_status::ok)
+    {
+        return results;
+    }
+
+    auto count = reader.get<std::uint32_t>();
+    for (auto i = 0u; i < count; ++i)
+    {
+        results.push_back(decode_action_result(reader));
+    }
+
+    return results;
+}
+
+void reaver::despayre::_v1::unix_socket_cache::put_action(std::uint64_t key, const reaver::despayre::_v1::action_result & result)
+{
+    auto body = request(cache_operation::put_action, key);
+    encode(body, result);
+
+    auto response = _request(body);
+    message_reader reader{ response };
+
+    if (reader.get<cache_status>() != cache_status::ok)
+    {
+        throw protocol_error{ "the cache server refused an action result." };
+    }
+}
+
+std::string reaver::despayre::_v1::unix_socket_cache::_request(const std::string & body)
+{
+    int fd = -1;
+
+    {
+        std::lock_guard<std::mutex> lock{ _lock };
+        if (!_idle.empty())
+        {
+            fd = _idle.back();
+            _idle.pop_back();
+        }
+    }
+
+    if (fd < 0)
+    {
+        fd = connect_unix_socket(_socket, _timeout);
+    }
+
+    try
+    {
+        write_frame(fd, body);
+        auto response = read_frame(fd);
+        if (!response)
+        {
+            throw protocol_error{ "the cache server closed the connection." };
+        }
+
+        std::lock_guard<std::mutex> lock{ _lock };
+        _idle.push_back(fd);
+
+        return std::move(*response);
+    }
+
+    catch (...)
+    {
+        // the state of the connection is unknown; don't reuse it
+        ::close(fd);
+        throw;
+    }
+}
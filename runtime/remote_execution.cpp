@@ -0,0 +1,154 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "despayre/runtime/remote_execution.h"
+
+std::string reaver::despayre::_v1::encode(const reaver::despayre::_v1::remote_action & action)
+{
+    std::string body;
+    put_value(body, execution_operation::execute);
+    put_value<std::uint32_t>(body, action.arguments.size());
+    for (auto && argument : action.arguments)
+    {
+        put_string(body, argument);
+    }
+    put_string(body, action.source_extension);
+    put_string(body, action.source);
+    return body;
+}
+
+reaver::despayre::_v1::remote_action reaver::despayre::_v1::decode_remote_action(reaver::despayre::_v1::message_reader & reader)
+{
+    remote_action action;
+    action.arguments.resize(reader.get<std::uint32_t>());
+    for (auto && argument : action.arguments)
+    {
+        argument = reader.get_string();
+    }
+    action.source_extension = reader.get_string();
+    action.source = reader.get_string();
+    return action;
+}
+
+reaver::despayre::_v1::remote_executor::remote_executor(std::vector<std::string> endpoints, std::uint32_t timeout_ms) : _timeout{ timeout_ms }
+{
+    for (auto && endpoint : endpoints)
+    {
+        _worker worker;
+        worker.endpoint = std::move(endpoint);
+        _workers.push_back(std::move(worker));
+    }
+}
+
+reaver::despayre::_v1::remote_executor::~remote_executor()
+{
+    for (auto && worker : _workers)
+    {
+        for (auto && fd : worker.idle)
+        {
+            ::close(fd);
+        }
+    }
+}
+
+reaver::despayre::_v1::remote_result reaver::despayre::_v1::remote_executor::execute(const reaver::despayre::_v1::remote_action & action)
+{
+    auto body = encode(action);
+
+    while (true)
+    {
+        _worker * worker = nullptr;
+        int fd = -1;
+
+        {
+            std::lock_guard<std::mutex> lock{ _lock };
+            for (auto && candidate : _workers)
+            {
+                if (!candidate.failed && (!worker || candidate.running < worker->running))
+                {
+                    worker = &candidate;
+                }
+            }
+
+            if (!worker)
+            {
+                throw protocol_error{ "no remote worker is available." };
+            }
+
+            ++worker->running;
+            if (!worker->idle.empty())
+            {
+                fd = worker->idle.back();
+                worker->idle.pop_back();
+            }
+        }
+
+        try
+        {
+            if (fd < 0)
+            {
+                fd = connect_endpoint(worker->endpoint, _timeout);
+            }
+
+            write_frame(fd, body);
+            auto response = read_frame(fd);
+            if (!response)
+            {
+                throw protocol_error{ "the worker closed the connection." };
+            }
+
+            message_reader reader{ *response };
+            if (reader.get<execution_status>() != execution_status::ok)
+            {
+                throw protocol_error{ "the worker failed to run an action." };
+            }
+
+            remote_result result;
+            result.exit_code = reader.get<std::int32_t>();
+            result.diagnostics = reader.get_string();
+            result.object = reader.get_string();
+
+            std::lock_guard<std::mutex> lock{ _lock };
+            --worker->running;
+            worker->idle.push_back(fd);
+
+            return result;
+        }
+
+        catch (protocol_error &)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+
+            // try the next one
+            std::lock_guard<std::mutex> lock{ _lock };
+            --worker->running;
+            worker->failed = true;
+        }
+    }
+}
@@ -0,0 +1,681 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <chrono>
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include <reaver/logger.h>
+
+#include "despayre/runtime/scheduler.h"
+#include "despayre/runtime/context.h"
+#include "despayre/runtime/hash.h"
+#include "despayre/semantics/target.h"
+
+reaver::despayre::_v1::job_scheduler::~job_scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock{ _state->lock };
+        _state->stop = true;
+    }
+    _state->ready_condition.notify_all();
+    _state->remote_condition.notify_all();
+    _state->cache_condition.notify_all();
+
+    for (auto workers : { &_workers, &_cache_workers })
+    {
+        for (auto && worker : *workers)
+        {
+            // the last reference to the context can be dropped by a job, on a worker thread
+            if (worker.get_id() == std::this_thread::get_id())
+            {
+                worker.detach();
+                continue;
+            }
+
+            worker.join();
+        }
+    }
+}
+
+reaver::future<> reaver::despayre::_v1::job_scheduler::schedule(reaver::despayre::_v1::context_ptr ctx, std::shared_ptr<reaver::despayre::_v1::target> root)
+{
+    // stats, hashes and reads the build log for the whole subgraph; done before taking the lock, so that running jobs aren't held up by it
+    // _add finds the results in ctx->target_states
+    target::_evaluate(ctx, root);
+
+    std::unique_lock<std::mutex> lock{ _state->lock };
+
+    std::vector<_node *> notify;
+    auto node = _add(*_state, ctx, root, notify);
+    if (!node)
+    {
+        return make_ready_future();
+    }
+
+    if (_workers.empty())
+    {
+        for (auto i = 0ull; i < _jobs; ++i)
+        {
+            _workers.emplace_back(&job_scheduler::_work, _state, false);
+        }
+
+        if (ctx->options.remote_execution)
+        {
+            for (auto i = 0ull; i < ctx->options.remote_jobs; ++i)
+            {
+                _workers.emplace_back(&job_scheduler::_work, _state, true);
+            }
+        }
+
+        if (ctx->options.remote_cache)
+        {
+            for (auto i = 0ull; i < _jobs; ++i)
+            {
+                _cache_workers.emplace_back(&job_scheduler::_cache_work, _state);
+            }
+        }
+    }
+
+    auto ret = node->build_future;
+    lock.unlock();
+    _state->ready_condition.notify_all();
+    _notify(notify);
+
+    return ret;
+}
+
+void reaver::despayre::_v1::job_scheduler::reset()
+{
+    std::unique_lock<std::mutex> lock{ _state->lock };
+    _state->idle_condition.wait(lock, [&]{ return !_state->unfinished; });
+    _state->nodes.clear();
+    _state->cancelled = false;
+}
+
+void reaver::despayre::_v1::job_scheduler::cancel()
+{
+    std::vector<_node *> notify;
+
+    std::unique_lock<std::mutex> lock{ _state->lock };
+    _state->cancelled = true;
+
+    auto error = std::make_exception_ptr(build_cancelled{});
+    for (auto queue : { &_state->ready, &_state->remote_ready })
+    {
+        for (auto && node : *queue)
+        {
+            _finish(*_state, node, error, notify);
+        }
+        queue->clear();
+    }
+    for (auto && node : _state->lookups)
+    {
+        _finish(*_state, node, error, notify);
+    }
+    _state->lookups.clear();
+    lock.unlock();
+
+    _notify(notify);
+}
+
+void reaver::despayre::_v1::job_scheduler::cancel(const std::unordered_set<std::shared_ptr<target>> & targets)
+{
+    std::vector<_node *> notify;
+
+    std::unique_lock<std::mutex> lock{ _state->lock };
+
+    auto error = std::make_exception_ptr(build_cancelled{});
+    for (auto && target : targets)
+    {
+        auto it = _state->nodes.find(target);
+        if (it == _state->nodes.end())
+        {
+            continue;
+        }
+
+        // a running one can still be queued again after a cache miss; the workers check the flag when they take it
+        auto node = it->second.get();
+        node->cancelled = true;
+        if (!node->running)
+        {
+            _finish(*_state, node, error, notify);
+        }
+    }
+    lock.unlock();
+
+    _notify(notify);
+}
+
+// must be called with the state lock held
+// returns nullptr when there is nothing to be done for the target
+reaver::despayre::_v1::job_scheduler::_node * reaver::despayre::_v1::job_scheduler::_add(reaver::despayre::_v1::job_scheduler::_shared_state & state, const reaver::despayre::_v1::context_ptr & ctx, const std::shared_ptr<reaver::despayre::_v1::target> & target, std::vector<_node *> & notify)
+{
+    auto it = state.nodes.find(target);
+    if (it != state.nodes.end())
+    {
+        return it->second.get();
+    }
+
+    if (target::_evaluate(ctx, target))
+    {
+        return nullptr;
+    }
+
+    auto pair = make_promise<void>();
+    auto owned = std::make_unique<_node>();
+    auto node = owned.get();
+    node->target = target;
+    node->ctx = ctx;
+    node->build_promise = std::move(pair.promise);
+    node->build_future = std::move(pair.future);
+
+    auto outs = target->outputs(ctx);
+    node->cacheable = !outs.empty() && ctx->options.remote_cache;
+    node->remote = ctx->options.remote_execution && ctx->options.remote_jobs && target->_remote_capable(ctx);
+    if (!outs.empty())
+    {
+        if (auto record = ctx->build_log.find(outs.front()))
+        {
+            node->expected_duration = record->duration;
+        }
+    }
+    state.nodes.emplace(target, std::move(owned));
+    ++state.unfinished;
+
+    for (auto && dep : target->dependencies(ctx))
+    {
+        auto dep_node = _add(state, ctx, dep, notify);
+        if (!dep_node || (dep_node->finished && !dep_node->error))
+        {
+            continue;
+        }
+
+        if (dep_node->error)
+        {
+            _finish(state, node, dep_node->error, notify);
+            return node;
+        }
+
+        ++node->pending_dependencies;
+        dep_node->dependents.push_back(node);
+    }
+
+    if (!node->pending_dependencies)
+    {
+        _make_ready(state, node);
+    }
+
+    return node;
+}
+
+// must be called with the state lock held
+// the nodes put into `notify` need to be passed to _notify after the lock is released
+void reaver::despayre::_v1::job_scheduler::_finish(reaver::despayre::_v1::job_scheduler::_shared_state & state, reaver::despayre::_v1::job_scheduler::_node * node, std::exception_ptr error, std::vector<_node *> & notify)
+{
+    if (node->finished)
+    {
+        return;
+    }
+
+    node->finished = true;
+    node->running = false;
+    node->error = error;
+    // whoever finishes a node holds a reference to its context too, so this is never the last one, which would destroy the scheduler under its own lock
+    node->ctx = nullptr;
+    notify.push_back(node);
+
+    if (!--state.unfinished)
+    {
+        state.idle_condition.notify_all();
+    }
+
+    for (auto && dependent : node->dependents)
+    {
+        if (error)
+        {
+            _finish(state, dependent, error, notify);
+            continue;
+        }
+
+        if (!--dependent->pending_dependencies && !dependent->finished)
+        {
+            _make_ready(state, dependent);
+        }
+    }
+}
+
+// must be called with the state lock held
+void reaver::despayre::_v1::job_scheduler::_make_ready(reaver::despayre::_v1::job_scheduler::_shared_state & state, reaver::despayre::_v1::job_scheduler::_node * node)
+{
+    if (node->cacheable && !state.cache_failed)
+    {
+        state.lookups.push_back(node);
+        state.cache_condition.notify_one();
+        return;
+    }
+
+    _enqueue(state, node);
+}
+
+// must be called with the state lock held
+void reaver::despayre::_v1::job_scheduler::_enqueue(reaver::despayre::_v1::job_scheduler::_shared_state & state, reaver::despayre::_v1::job_scheduler::_node * node)
+{
+    if (node->remote)
+    {
+        state.remote_ready.push_back(node);
+        std::push_heap(state.remote_ready.begin(), state.remote_ready.end(), _shorter_job{});
+        state.remote_condition.notify_one();
+        state.ready_condition.notify_one();
+        return;
+    }
+
+    state.ready.push_back(node);
+    std::push_heap(state.ready.begin(), state.ready.end(), _shorter_job{});
+    state.ready_condition.notify_one();
+}
+
+void reaver::despayre::_v1::job_scheduler::_notify(const std::vector<_node *> & finished_nodes)
+{
+    for (auto && finished : finished_nodes)
+    {
+        if (finished->error)
+        {
+            finished->build_promise.set_exception(finished->error);
+        }
+        else
+        {
+            finished->build_promise.set();
+        }
+    }
+}
+
+void reaver::despayre::_v1::job_scheduler::_work(std::shared_ptr<reaver::despayre::_v1::job_scheduler::_shared_state> state, bool remote)
+{
+    std::unique_lock<std::mutex> lock{ state->lock };
+
+    auto & condition = remote ? state->remote_condition : state->ready_condition;
+
+    while (true)
+    {
+        condition.wait(lock, [&]{ return state->stop || (!remote && !state->ready.empty()) || !state->remote_ready.empty(); });
+        if (state->stop)
+        {
+            return;
+        }
+
+        auto & queue = !remote && !state->ready.empty() ? state->ready : state->remote_ready;
+        std::pop_heap(queue.begin(), queue.end(), _shorter_job{});
+        auto node = queue.back();
+        queue.pop_back();
+
+        if (node->finished)
+        {
+            continue;
+        }
+
+        if (state->cancelled || node->cancelled)
+        {
+            std::vector<_node *> notify;
+            _finish(*state, node, std::make_exception_ptr(build_cancelled{}), notify);
+            lock.unlock();
+            _notify(notify);
+            lock.lock();
+            continue;
+        }
+
+        auto ctx = node->ctx;
+        node->running = true;
+        lock.unlock();
+
+        std::exception_ptr error;
+        bool trusted = false;
+        auto started = current_file_time();
+        try
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (remote)
+            {
+                node->target->_build_remote(ctx);
+            }
+            else
+            {
+                node->target->_build(ctx);
+            }
+            auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            trusted = node->target->_after_build(ctx, duration.count(), started);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        // only the results of successful builds are shared; a failed one never gets here, as _build throws
+        optional<_upload> upload;
+        if (!error && trusted && node->cacheable)
+        {
+            upload = _prepare_upload(ctx, node, started);
+        }
+
+        lock.lock();
+        if (upload && !state->cache_failed)
+        {
+            state->uploads.push_back(std::move(*upload));
+            state->cache_condition.notify_one();
+        }
+
+        std::vector<_node *> notify;
+        _finish(*state, node, error, notify);
+        lock.unlock();
+
+        _notify(notify);
+
+        ctx = nullptr;
+        lock.lock();
+    }
+}
+
+// 0 when the target can't be cached
+std::uint64_t reaver::despayre::_v1::job_scheduler::_action_key(const reaver::despayre::_v1::context_ptr & ctx, const std::shared_ptr<reaver::despayre::_v1::target> & target)
+{
+    auto signature = target->_command_signature(ctx);
+    if (!signature)
+    {
+        return 0;
+    }
+
+    std::vector<std::string> parts = { "despayre action 1", std::to_string(signature) };
+    for (auto && input : target->_declared_inputs(ctx))
+    {
+        parts.push_back(input.string());
+        parts.push_back(std::to_string(ctx->content_hashes.hash(ctx->file_status, input)));
+    }
+    for (auto && output : target->outputs(ctx))
+    {
+        parts.push_back(output.string());
+    }
+
+    return hash_command(parts, {}, {});
+}
+
+// throws protocol_error when the cache can't be reached
+bool reaver::despayre::_v1::job_scheduler::_restore(const reaver::despayre::_v1::context_ptr & ctx, reaver::despayre::_v1::job_scheduler::_node * node)
+{
+    auto & target = node->target;
+    auto & backend = ctx->options.remote_cache;
+
+    node->action_key = _action_key(ctx, target);
+    if (!node->action_key)
+    {
+        return false;
+    }
+
+    auto outs = target->outputs(ctx);
+
+    for (auto && result : backend->get_action(node->action_key))
+    {
+        auto matches = std::equal(outs.begin(), outs.end(), result.outputs.begin(), result.outputs.end(), [](auto && out, auto && file) { return out == file.path; })
+            && std::all_of(result.inputs.begin(), result.inputs.end(), [&](auto && input) {
+                return ctx->file_status.exists(input.path) && ctx->content_hashes.hash(ctx->file_status, input.path) == input.hash;
+            });
+
+        if (!matches)
+        {
+            continue;
+        }
+
+        // everything is fetched before anything is put in place, so that a failure midway leaves the old outputs alone
+        std::vector<std::pair<boost::filesystem::path, boost::filesystem::path>> staged;
+        auto discard = [&]{
+            for (auto && file : staged)
+            {
+                boost::system::error_code ec;
+                boost::filesystem::remove(file.first, ec);
+            }
+        };
+
+        bool complete = true;
+        for (auto && output : result.outputs)
+        {
+            auto blob = backend->get_blob(output.hash);
+            if (!blob || hash_bytes(blob->data(), blob->size()) != output.hash)
+            {
+                complete = false;
+                break;
+            }
+
+            boost::filesystem::create_directories(output.path.parent_path());
+            auto temporary = output.path;
+            temporary += "." + boost::filesystem::unique_path().string() + ".tmp";
+            staged.emplace_back(temporary, output.path);
+
+            std::ofstream file{ temporary.string(), std::ios::binary | std::ios::trunc };
+            file << *blob;
+            if (!file.flush() || ::chmod(temporary.c_str(), output.mode) != 0)
+            {
+                complete = false;
+                break;
+            }
+        }
+
+        if (!complete)
+        {
+            discard();
+            continue;
+        }
+
+        for (auto && file : staged)
+        {
+            boost::filesystem::rename(file.first, file.second);
+        }
+
+        target->_restored(ctx, fmap(result.inputs, [](auto && input) { return input.path; }));
+        return true;
+    }
+
+    return false;
+}
+
+reaver::optional<reaver::despayre::_v1::job_scheduler::_upload> reaver::despayre::_v1::job_scheduler::_prepare_upload(const reaver::despayre::_v1::context_ptr & ctx, reaver::despayre::_v1::job_scheduler::_node * node, std::int64_t started)
+{
+    try
+    {
+        auto key = node->action_key ? node->action_key : _action_key(ctx, node->target);
+        if (!key)
+        {
+            return none;
+        }
+
+        _upload upload;
+        upload.backend = ctx->options.remote_cache;
+        upload.key = key;
+
+        for (auto && input : node->target->inputs(ctx))
+        {
+            upload.result.inputs.push_back({ input, ctx->content_hashes.hash(ctx->file_status, input) });
+        }
+
+        for (auto && output : node->target->outputs(ctx))
+        {
+            struct ::stat status;
+            if (::stat(output.c_str(), &status) != 0)
+            {
+                return none;
+            }
+
+            // an output the build didn't write is left over from an earlier one, and doesn't belong under this key
+            // compared in whole seconds, as that's all some filesystems keep
+            if (status.st_mtim.tv_sec < started / 1000000000)
+            {
+                return none;
+            }
+
+            std::ifstream file{ output.string(), std::ios::binary };
+            std::string contents{ std::istreambuf_iterator<char>{ file.rdbuf() }, {} };
+            auto hash = hash_bytes(contents.data(), contents.size());
+
+            upload.result.outputs.push_back({ output, hash, static_cast<std::uint32_t>(status.st_mode & 07777) });
+            upload.blobs.emplace_back(hash, std::move(contents));
+        }
+
+        return std::move(upload);
+    }
+
+    catch (std::exception &)
+    {
+        // an output that can't be read isn't worth failing the build over
+        return none;
+    }
+}
+
+void reaver::despayre::_v1::job_scheduler::_cache_work(std::shared_ptr<reaver::despayre::_v1::job_scheduler::_shared_state> state)
+{
+    std::unique_lock<std::mutex> lock{ state->lock };
+
+    auto disable = [&]{
+        if (!state->cache_failed)
+        {
+            logger::dlog(logger::warning) << "the remote cache is unavailable; building everything locally.";
+        }
+        state->cache_failed = true;
+        state->uploads.clear();
+    };
+
+    while (true)
+    {
+        state->cache_condition.wait(lock, [&]{ return state->stop || !state->lookups.empty() || !state->uploads.empty(); });
+
+        if (!state->lookups.empty() && !state->stop)
+        {
+            auto node = state->lookups.front();
+            state->lookups.pop_front();
+
+            if (node->finished)
+            {
+                continue;
+            }
+
+            if (state->cancelled || node->cancelled)
+            {
+                std::vector<_node *> notify;
+                _finish(*state, node, std::make_exception_ptr(build_cancelled{}), notify);
+                lock.unlock();
+                _notify(notify);
+                lock.lock();
+                continue;
+            }
+
+            if (state->cache_failed)
+            {
+                _enqueue(*state, node);
+                continue;
+            }
+
+            auto ctx = node->ctx;
+            node->running = true;
+            lock.unlock();
+
+            bool restored = false;
+            bool failed = false;
+            std::exception_ptr error;
+            try
+            {
+                auto started = current_file_time();
+                restored = _restore(ctx, node);
+                if (restored)
+                {
+                    node->target->_after_build(ctx, node->expected_duration, started);
+                }
+            }
+            catch (protocol_error &)
+            {
+                failed = true;
+            }
+            catch (boost::filesystem::filesystem_error & ex)
+            {
+                logger::dlog(logger::warning) << "failed to restore outputs from the remote cache: " << ex.what();
+            }
+            catch (...)
+            {
+                // whatever went wrong will go wrong again (and be reported) when building locally
+            }
+
+            lock.lock();
+            node->running = false;
+            if (failed)
+            {
+                disable();
+            }
+
+            if (!restored)
+            {
+                _enqueue(*state, node);
+                lock.unlock();
+            }
+            else
+            {
+                std::vector<_node *> notify;
+                _finish(*state, node, nullptr, notify);
+                lock.unlock();
+                _notify(notify);
+            }
+
+            ctx = nullptr;
+            lock.lock();
+            continue;
+        }
+
+        if (!state->uploads.empty())
+        {
+            auto upload = std::move(state->uploads.front());
+            state->uploads.pop_front();
+            lock.unlock();
+
+            bool failed = false;
+            try
+            {
+                for (auto && blob : upload.blobs)
+                {
+                    upload.backend->put_blob(blob.first, blob.second);
+                }
+                upload.backend->put_action(upload.key, upload.result);
+            }
+            catch (protocol_error &)
+            {
+                failed = true;
+            }
+
+            lock.lock();
+            if (failed)
+            {
+                disable();
+            }
+            continue;
+        }
+
+        if (state->stop)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,130 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "despayre/runtime/server.h"
+#include "despayre/runtime/protocol.h"
+
+reaver::despayre::_v1::frame_server::frame_server(std::string endpoint) : _endpoint{ std::move(endpoint) }
+{
+    _listener = listen_endpoint(_endpoint);
+}
+
+reaver::despayre::_v1::frame_server::~frame_server()
+{
+    _shutdown();
+
+    ::close(_listener);
+
+    if (_endpoint.compare(0, 4, "tcp:") != 0)
+    {
+        ::unlink((_endpoint.compare(0, 5, "unix:") == 0 ? _endpoint.substr(5) : _endpoint).c_str());
+    }
+}
+
+void reaver::despayre::_v1::frame_server::run()
+{
+    while (!_stopped)
+    {
+        auto fd = ::accept4(_listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock{ _lock };
+        if (_stopped)
+        {
+            ::close(fd);
+            break;
+        }
+
+        _connections.push_back(fd);
+        std::thread{ &frame_server::_serve, this, fd }.detach();
+    }
+}
+
+void reaver::despayre::_v1::frame_server::stop()
+{
+    std::lock_guard<std::mutex> lock{ _lock };
+    if (_stopped.exchange(true))
+    {
+        return;
+    }
+
+    // wakes up the accept() in run() and the reads of the connection threads
+    ::shutdown(_listener, SHUT_RDWR);
+    for (auto && fd : _connections)
+    {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+}
+
+void reaver::despayre::_v1::frame_server::_shutdown()
+{
+    stop();
+
+    std::unique_lock<std::mutex> lock{ _lock };
+    _finished_condition.wait(lock, [&]{ return _connections.empty(); });
+}
+
+std::string reaver::despayre::_v1::frame_server::_handle(const std::string &)
+{
+    throw protocol_error{ "this server does not handle requests." };
+}
+
+std::string reaver::despayre::_v1::frame_server::_handle_connection(int, const std::string & request)
+{
+    return _handle(request);
+}
+
+void reaver::despayre::_v1::frame_server::_serve(int fd)
+{
+    try
+    {
+        while (auto request = read_frame(fd))
+        {
+            write_frame(fd, _handle_connection(fd, *request));
+        }
+    }
+
+    catch (protocol_error &)
+    {
+        // the client went away; nothing to clean up but the connection
+    }
+
+    std::lock_guard<std::mutex> lock{ _lock };
+    _connections.erase(std::remove(_connections.begin(), _connections.end(), fd), _connections.end());
+    ::close(fd);
+    _finished_condition.notify_all();
+}
@@ -0,0 +1,335 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <reaver/logger.h>
+
+#include "despayre/runtime/watch.h"
+
+namespace
+{
+    bool is_within(const boost::filesystem::path & path, const boost::filesystem::path & directory)
+    {
+        auto it = path.begin();
+        for (auto && component : directory)
+        {
+            if (it == path.end() || *it != component)
+            {
+                return false;
+            }
+            ++it;
+        }
+
+        return true;
+    }
+
+    void report(std::exception_ptr error)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+
+        catch (reaver::despayre::build_cancelled &)
+        {
+        }
+
+        catch (reaver::exception & ex)
+        {
+            ex.print(reaver::logger::default_logger());
+        }
+
+        catch (std::exception & ex)
+        {
+            reaver::logger::dlog(reaver::logger::error) << ex.what();
+        }
+    }
+}
+
+reaver::despayre::_v1::build_watcher::build_watcher(boost::filesystem::path buildfile, std::string target_name, std::string output_directory, runtime_options options, std::uint32_t quiet_ms)
+    : _buildfile{ boost::filesystem::absolute(buildfile).lexically_normal() },
+    _workspace{ boost::filesystem::current_path() },
+    _ignore_file{ _workspace / ".despayreignore" },
+    _target_name{ std::move(target_name) },
+    _output_directory{ std::move(output_directory) },
+    _output_path{ boost::filesystem::absolute(_output_directory).lexically_normal() },
+    _options{ std::move(options) },
+    _quiet{ quiet_ms }
+{
+}
+
+void reaver::despayre::_v1::build_watcher::run()
+{
+    _analyze();
+
+    while (!_stopped)
+    {
+        if (_graph)
+        {
+            _start_build();
+        }
+
+        auto changes = _watcher.wait(_quiet);
+
+        // whatever is still being built was asked for before the changes; don't start any more of what they affect,
+        // but let the rest finish, as the next build would only have to build it anyway
+        if (_context)
+        {
+            auto affected = _affected(changes);
+            if (affected)
+            {
+                _context->scheduler.cancel(*affected);
+            }
+            else
+            {
+                _context->scheduler.cancel();
+            }
+            _context->scheduler.reset();
+        }
+
+        if (!_stopped)
+        {
+            _apply(changes);
+        }
+    }
+}
+
+void reaver::despayre::_v1::build_watcher::stop()
+{
+    _stopped = true;
+    _watcher.interrupt();
+}
+
+void reaver::despayre::_v1::build_watcher::_analyze()
+{
+    if (_context)
+    {
+        _context->scheduler.cancel();
+        _context->scheduler.reset();
+    }
+
+    // the context holds on to targets of the graph, so it has to go first
+    _root = nullptr;
+    _context = nullptr;
+    _graph.reset();
+
+    _consumers.clear();
+    _input_names.clear();
+    _dependents.clear();
+    _indexed.clear();
+    _reindex.clear();
+    _watcher.clear();
+
+    _watcher.watch(_buildfile.parent_path());
+    for (auto && directory : source_directories(_workspace))
+    {
+        if (!_generated(directory))
+        {
+            _watcher.watch(directory);
+        }
+    }
+
+    try
+    {
+        _graph = std::make_unique<despayre>(_buildfile, _workspace, evaluation::eager, std::vector<boost::filesystem::path>{ _output_path });
+        _context = _graph->make_context(_output_directory, _options);
+        _root = _graph->find_target(_target_name);
+        _first_build = true;
+
+        _index(_root);
+        // nothing has been built yet, so everything can still discover new inputs
+        _reindex.assign(_indexed.begin(), _indexed.end());
+    }
+
+    catch (...)
+    {
+        report(std::current_exception());
+
+        _root = nullptr;
+        _context = nullptr;
+        _graph.reset();
+    }
+}
+
+void reaver::despayre::_v1::build_watcher::_start_build()
+{
+    try
+    {
+        auto build = _first_build ? _graph->build(_target_name, _context) : _root->build(_context);
+        _first_build = false;
+
+        build.then([]{ logger::dlog(logger::success) << "build finished; waiting for changes."; });
+        build.on_error([](std::exception_ptr error) { report(error); });
+    }
+
+    catch (...)
+    {
+        report(std::current_exception());
+    }
+}
+
+void reaver::despayre::_v1::build_watcher::_apply(const file_changes & changes)
+{
+    if (!_graph)
+    {
+        // the last analysis failed; any change might have fixed it
+        _analyze();
+        return;
+    }
+
+    for (auto && target : _reindex)
+    {
+        _index(target);
+    }
+    _reindex.clear();
+
+    auto affected = _affected(changes);
+    if (!affected)
+    {
+        _analyze();
+        return;
+    }
+
+    for (auto && path : changes.paths)
+    {
+        auto it = _input_names.find(path);
+        if (it == _input_names.end())
+        {
+            continue;
+        }
+
+        for (auto && name : it->second)
+        {
+            _context->file_status.invalidate(name);
+        }
+    }
+
+    // everything else keeps the state it was evaluated to, so the next build doesn't look at it at all
+    for (auto && target : *affected)
+    {
+        target->invalidate();
+        _context->target_states.erase(target);
+    }
+    _reindex.assign(affected->begin(), affected->end());
+}
+
+// only looks at what the watcher itself knows, so it's safe to call while a build is running; the index may be missing inputs
+// the running build is only now discovering, but those are found by _apply, once it's done
+reaver::optional<std::unordered_set<std::shared_ptr<reaver::despayre::_v1::target>>> reaver::despayre::_v1::build_watcher::_affected(const file_changes & changes) const
+{
+    if (changes.overflow)
+    {
+        return none;
+    }
+
+    std::unordered_set<std::shared_ptr<target>> affected;
+    for (auto && path : changes.paths)
+    {
+        // what the globs skip is as much a part of the graph as the buildfile
+        if (path == _buildfile || path == _ignore_file)
+        {
+            return none;
+        }
+
+        auto exists = boost::filesystem::exists(boost::filesystem::symlink_status(path));
+
+        auto it = _consumers.find(path);
+        if (it == _consumers.end())
+        {
+            // a new file might be matched by a glob; hidden files (like editors' swap files) and ones outside of the workspace can't
+            if (exists && is_within(path, _workspace) && !_generated(path) && path.filename().string().front() != '.')
+            {
+                return none;
+            }
+            continue;
+        }
+
+        // so might a removed one have been
+        if (!exists)
+        {
+            return none;
+        }
+
+        affected.insert(it->second.begin(), it->second.end());
+    }
+
+    std::vector<std::shared_ptr<target>> pending{ affected.begin(), affected.end() };
+    while (!pending.empty())
+    {
+        auto target = std::move(pending.back());
+        pending.pop_back();
+
+        auto it = _dependents.find(target);
+        if (it == _dependents.end())
+        {
+            continue;
+        }
+
+        for (auto && dependent : it->second)
+        {
+            if (affected.insert(dependent).second)
+            {
+                pending.push_back(dependent);
+            }
+        }
+    }
+
+    return affected;
+}
+
+void reaver::despayre::_v1::build_watcher::_index(const std::shared_ptr<target> & target)
+{
+    _indexed.insert(target);
+
+    for (auto && input : target->inputs(_context))
+    {
+        _add_input(target, input);
+    }
+
+    for (auto && dependency : target->dependencies(_context))
+    {
+        _dependents[dependency].insert(target);
+        if (_indexed.find(dependency) == _indexed.end())
+        {
+            _index(dependency);
+        }
+    }
+}
+
+void reaver::despayre::_v1::build_watcher::_add_input(const std::shared_ptr<target> & target, const boost::filesystem::path & input)
+{
+    auto absolute = boost::filesystem::absolute(input, _workspace).lexically_normal();
+
+    // outputs of other targets are followed through the dependencies instead
+    if (_generated(absolute))
+    {
+        return;
+    }
+
+    _consumers[absolute].insert(target);
+    _input_names[absolute].insert(input);
+    _watcher.watch(absolute.parent_path());
+}
+
+bool reaver::despayre::_v1::build_watcher::_generated(const boost::filesystem::path & absolute) const
+{
+    return is_within(absolute, _output_path);
+}
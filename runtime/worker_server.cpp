@@ -0,0 +1,226 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include "despayre/runtime/worker_server.h"
+
+namespace
+{
+    // options that load code into the compiler (or run other programs), or have it read or write files other than the source and the object
+    // an argument starting with one of these is turned down, whatever follows
+    const char * const refused_arguments[] = {
+        "@", "-o", "-B", "-specs", "--specs", "-wrapper", "-fplugin", "-load", "-Xclang",
+        "-Wa,", "-Wl,", "-Wp,", "-Xassembler", "-Xlinker", "-Xpreprocessor",
+        "-M", "-save-temps", "-fdump-", "-fprofile-", "-fstack-usage", "-fcallgraph-info", "-ftime-trace", "-fdebug-prefix-map", "--sysroot", "-isysroot"
+    };
+
+    bool refused(const std::string & argument)
+    {
+        for (auto && prefix : refused_arguments)
+        {
+            if (argument.compare(0, std::strlen(prefix), prefix) == 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+reaver::despayre::_v1::worker_server::worker_server(std::string endpoint, std::size_t jobs, std::string compiler) : frame_server{ std::move(endpoint) }, _jobs{ std::max<std::size_t>(jobs, 1) }, _compiler{ std::move(compiler) }
+{
+}
+
+reaver::despayre::_v1::worker_server::~worker_server()
+{
+    _shutdown();
+}
+
+std::string reaver::despayre::_v1::worker_server::_handle(const std::string & request)
+{
+    std::string response;
+
+    try
+    {
+        message_reader reader{ request };
+        if (reader.get<execution_operation>() != execution_operation::execute)
+        {
+            throw protocol_error{ "unknown operation." };
+        }
+        auto action = decode_remote_action(reader);
+
+        if (action.arguments.empty() || action.arguments.front() != _compiler
+            || std::any_of(action.arguments.begin() + 1, action.arguments.end(), refused)
+            || action.source_extension.find('/') != std::string::npos)
+        {
+            throw protocol_error{ "refused to run an action." };
+        }
+
+        std::unique_lock<std::mutex> lock{ _lock };
+        _slot_condition.wait(lock, [&]{ return _running < _jobs; });
+        ++_running;
+        lock.unlock();
+
+        optional<remote_result> result;
+        try
+        {
+            result = _execute(action);
+        }
+        catch (...)
+        {
+        }
+
+        lock.lock();
+        --_running;
+        _slot_condition.notify_one();
+        lock.unlock();
+
+        if (!result)
+        {
+            throw protocol_error{ "failed to run an action." };
+        }
+
+        put_value(response, execution_status::ok);
+        put_value(response, result->exit_code);
+        put_string(response, result->diagnostics);
+        put_string(response, result->object);
+    }
+
+    catch (protocol_error &)
+    {
+        response.clear();
+        put_value(response, execution_status::error);
+    }
+
+    return response;
+}
+
+reaver::despayre::_v1::remote_result reaver::despayre::_v1::worker_server::_execute(const reaver::despayre::_v1::remote_action & action)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("despayre-%%%%-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(directory);
+
+    struct cleanup
+    {
+        ~cleanup()
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(directory, ec);
+        }
+
+        boost::filesystem::path directory;
+    } remove_directory{ directory };
+
+    auto source = directory / ("source" + action.source_extension);
+    auto object = directory / "object.o";
+
+    {
+        std::ofstream file{ source.string(), std::ios::binary };
+        file << action.source;
+        if (!file.flush())
+        {
+            throw protocol_error{ "failed to write the source." };
+        }
+    }
+
+    auto arguments = action.arguments;
+    arguments.insert(arguments.end(), { "-o", object.string(), source.string() });
+
+    std::vector<char *> argv;
+    for (auto && argument : arguments)
+    {
+        argv.push_back(&argument[0]);
+    }
+    argv.push_back(nullptr);
+
+    int pipe[2];
+    if (::pipe2(pipe, O_CLOEXEC) != 0)
+    {
+        throw protocol_error{ "failed to run the action." };
+    }
+
+    // the compiler writes both of its streams into the pipe, and reads nothing
+    posix_spawn_file_actions_t actions;
+    ::posix_spawn_file_actions_init(&actions);
+    ::posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    ::posix_spawn_file_actions_adddup2(&actions, pipe[1], 1);
+    ::posix_spawn_file_actions_adddup2(&actions, pipe[1], 2);
+
+    pid_t pid;
+    auto error = ::posix_spawnp(&pid, argv.front(), &actions, nullptr, argv.data(), environ);
+    ::posix_spawn_file_actions_destroy(&actions);
+    ::close(pipe[1]);
+
+    if (error != 0)
+    {
+        ::close(pipe[0]);
+        throw protocol_error{ "failed to run the action." };
+    }
+
+    remote_result result;
+
+    char buffer[4096];
+    ssize_t size;
+    while ((size = ::read(pipe[0], buffer, sizeof(buffer))) != 0)
+    {
+        if (size < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        result.diagnostics.append(buffer, size);
+    }
+    ::close(pipe[0]);
+
+    int status;
+    while (::waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            throw protocol_error{ "failed to run the action." };
+        }
+    }
+    result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+    if (result.exit_code == 0)
+    {
+        std::ifstream file{ object.string(), std::ios::binary };
+        result.object.assign(std::istreambuf_iterator<char>{ file.rdbuf() }, {});
+    }
+
+    return result;
+}
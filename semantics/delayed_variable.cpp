@@ -20,7 +20,33 @@
  *
  **/
 
+#include <initializer_list>
+
 #include "despayre/semantics/delayed_variable.h"
+#include "despayre/semantics/semantics.h"
+
+namespace
+{
+    // null when the name doesn't exist, or when an unresolved variable is in the way; that one is then stored in `blocker`
+    std::shared_ptr<reaver::despayre::variable> look_up(const reaver::despayre::semantic_context & ctx, const std::vector<reaver::despayre::symbol> & name, std::shared_ptr<reaver::despayre::variable> * blocker = nullptr)
+    {
+        auto val = ctx.variables;
+        for (auto i = 0ull; i < name.size() && val; ++i)
+        {
+            if (!val->type())
+            {
+                if (blocker)
+                {
+                    *blocker = val;
+                }
+                return nullptr;
+            }
+
+            val = val->get_property(name[i]);
+        }
+        return val;
+    }
+}
 
 bool reaver::despayre::_v1::delayed_variable::try_resolve(reaver::despayre::_v1::semantic_context & ctx)
 {
@@ -30,19 +56,39 @@ bool reaver::despayre::_v1::delayed_variable::try_resolve(reaver::despayre::_v1:
         },
 
         [&](_delayed_reference_info & info) {
-            auto val = ctx.variables;
-            for (auto i = 0ull; i < info.referenced_id_expression.size() && val; ++i)
+            auto val = look_up(ctx, info.referenced_id_expression);
+
+            // a variable defined as a reference to itself, directly or not
+            if (!val || _pending(val).get() == this)
             {
-                val = val->get_property(info.referenced_id_expression[i]);
+                return false;
             }
 
-            if (!val)
+            _state = val;
+            return true;
+        },
+
+        [&](_thunk_info & info) {
+            // held on to, because assigning the state destroys the info
+            auto buildfile = info.buildfile;
+            auto & expr = *info.expr;
+
+            auto val = analyze_expression(ctx, buildfile->tree.tokens, expr);
+
+            // a thunk that is a reference to itself, directly or not; turned into a reference, so that it's reported like one
+            if (_pending(val).get() == this)
             {
+                std::vector<symbol> name;
+                for (auto && identifier : get<1>(expr.base).identifiers)
+                {
+                    name.push_back(buildfile->tree.tokens[identifier.token].name);
+                }
+
+                _state = _delayed_reference_info{ std::move(name) };
                 return false;
             }
 
-            _state = val;
-            ctx.unresolved.erase(ctx.unresolved.find(std::dynamic_pointer_cast<delayed_variable>(shared_from_this())));
+            _state = std::move(val);
             return true;
         },
 
@@ -51,8 +97,7 @@ bool reaver::despayre::_v1::delayed_variable::try_resolve(reaver::despayre::_v1:
             {
                 _state = instantiate(ctx, info.actual_type, info.arguments);
                 assert(get<0>(_state)->type());
-                ctx.unresolved.erase(ctx.unresolved.find(std::dynamic_pointer_cast<delayed_variable>(shared_from_this())));
-                return true;
+                    return true;
             }
 
             return false;
@@ -65,11 +110,7 @@ bool reaver::despayre::_v1::delayed_variable::try_resolve(reaver::despayre::_v1:
                 return false;
             }
 
-            auto val = ctx.variables;
-            for (auto i = 0ull; i < info.type_name.size() && val; ++i)
-            {
-                val = val->get_property(info.type_name[i]);
-            }
+            auto val = look_up(ctx, info.type_name);
 
             if (!val)
             {
@@ -82,7 +123,6 @@ bool reaver::despayre::_v1::delayed_variable::try_resolve(reaver::despayre::_v1:
             }
 
             _state = instantiate(ctx, val->as<type_descriptor_variable>()->identifier(), std::move(info.arguments));
-            ctx.unresolved.erase(ctx.unresolved.find(std::dynamic_pointer_cast<delayed_variable>(shared_from_this())));
             return true;
         },
 
@@ -103,12 +143,135 @@ bool reaver::despayre::_v1::delayed_variable::try_resolve(reaver::despayre::_v1:
                     break;
             }
 
-            ctx.unresolved.erase(ctx.unresolved.find(std::dynamic_pointer_cast<delayed_variable>(shared_from_this())));
             return true;
         }
     )));
 }
 
+std::shared_ptr<reaver::despayre::_v1::delayed_variable> reaver::despayre::_v1::delayed_variable::_pending(const std::shared_ptr<reaver::despayre::_v1::variable> & var)
+{
+    auto delayed = as_delayed(var);
+    if (!delayed || delayed->type())
+    {
+        return nullptr;
+    }
+
+    if (delayed->resolved())
+    {
+        return std::static_pointer_cast<delayed_variable>(delayed->_resolved());
+    }
+
+    return delayed;
+}
+
+const std::shared_ptr<reaver::despayre::_v1::variable> & reaver::despayre::_v1::delayed_variable::_resolved() const
+{
+    auto current = this;
+    for (auto next = as_delayed(get<0>(current->_state).get()); next && next->resolved(); next = as_delayed(get<0>(current->_state).get()))
+    {
+        current = next;
+    }
+
+    return get<0>(current->_state);
+}
+
+void reaver::despayre::_v1::delayed_variable::compress()
+{
+    if (!resolved())
+    {
+        return;
+    }
+
+    auto end = _resolved();
+
+    // the links keep each other alive, so hold on to the next one before repointing the current one
+    auto link = as_delayed(get<0>(_state));
+    _state = end;
+    while (link && link->resolved() && get<0>(link->_state) != end)
+    {
+        auto next = as_delayed(get<0>(link->_state));
+        link->_state = end;
+        link = std::move(next);
+    }
+}
+
+std::shared_ptr<reaver::despayre::_v1::delayed_variable> reaver::despayre::_v1::delayed_variable::pending_dependency(const reaver::despayre::_v1::semantic_context & ctx) const
+{
+    auto first_pending = [](auto && variables) -> std::shared_ptr<delayed_variable> {
+        for (auto && variable : variables)
+        {
+            if (auto pending = _pending(variable))
+            {
+                return pending;
+            }
+        }
+
+        return nullptr;
+    };
+
+    return get<0>(fmap(_state, make_overload_set(
+        [&](const std::shared_ptr<variable> &) {
+            return _pending(_resolved());
+        },
+
+        [&](const _delayed_reference_info & info) -> std::shared_ptr<delayed_variable> {
+            std::shared_ptr<variable> blocker;
+            auto val = look_up(ctx, info.referenced_id_expression, &blocker);
+            if (blocker)
+            {
+                return _pending(blocker);
+            }
+            return val ? _pending(val) : nullptr;
+        },
+
+        [&](const _thunk_info &) -> std::shared_ptr<delayed_variable> {
+            return nullptr;
+        },
+
+        [&](const _delayed_instantiation_info & info) {
+            return first_pending(info.arguments);
+        },
+
+        [&](const _delayed_type_info & info) {
+            return first_pending(info.arguments);
+        },
+
+        [&](const _delayed_operation_info & info) {
+            return first_pending(std::initializer_list<std::shared_ptr<variable>>{ info.lhs, info.rhs });
+        }
+    )));
+}
+
+std::vector<reaver::despayre::_v1::symbol> reaver::despayre::_v1::delayed_variable::looked_up_name() const
+{
+    return get<0>(fmap(_state, make_overload_set(
+        [&](const _delayed_reference_info & info) {
+            return info.referenced_id_expression;
+        },
+
+        [&](const _delayed_type_info & info) {
+            return info.type_name;
+        },
+
+        [&](const auto &) {
+            return std::vector<symbol>{};
+        }
+    )));
+}
+
+const reaver::despayre::_v1::expression * reaver::despayre::_v1::delayed_variable::thunk() const
+{
+    return get<0>(fmap(_state, make_overload_set(
+        [&](const _thunk_info & info) {
+            return info.expr;
+        },
+
+        [&](const auto &) -> const expression * {
+            return nullptr;
+        }
+    )));
+}
+
 std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::delayed_addition(std::shared_ptr<reaver::despayre::_v1::variable> lhs, std::shared_ptr<reaver::despayre::_v1::variable> rhs)
 {
     return std::make_shared<delayed_variable>(std::move(lhs), std::move(rhs), operation_type::addition);
@@ -64,7 +64,7 @@ void reaver::despayre::_v1::register_builtins(reaver::despayre::_v1::semantic_co
             { get_type_identifier<string>(), {} }
         })
     );
-    create_type<glob_tag>(ctx, U"glob", "<builtin>", &glob);
+    create_type<glob_tag>(ctx, U"glob", "<builtin>", generate_glob(ctx));
 
     create_type<executable>(
         ctx,
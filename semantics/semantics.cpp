@@ -20,6 +20,10 @@
  *
  **/
 
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+
 #include <reaver/prelude/functor.h>
 #include <reaver/overloads.h>
 
@@ -28,16 +32,83 @@
 #include "despayre/semantics/string.h"
 #include "despayre/semantics/delayed_variable.h"
 #include "despayre/semantics/namespace.h"
+#include "despayre/semantics/import.h"
+
+namespace
+{
+    std::vector<reaver::despayre::symbol> names(const std::vector<reaver::despayre::token> & tokens, const reaver::despayre::id_expression & expr)
+    {
+        std::vector<reaver::despayre::symbol> ret;
+        ret.reserve(expr.identifiers.size());
+        for (auto && identifier : expr.identifiers)
+        {
+            ret.push_back(tokens[identifier.token].name);
+        }
+        return ret;
+    }
+
+    // the variable the last identifier of `lhs` is to be added to; creates the namespaces on the way
+    std::shared_ptr<reaver::despayre::variable> parent_of(reaver::despayre::semantic_context & ctx, const std::vector<reaver::despayre::token> & tokens, const reaver::despayre::id_expression & lhs)
+    {
+        auto val = ctx.variables;
+
+        for (auto i = 0ull; i < lhs.identifiers.size() - 1; ++i)
+        {
+            auto name = tokens[lhs.identifiers[i].token].name;
+            auto nested = val->get_property(name);
+            if (nested)
+            {
+                val = nested;
+                continue;
+            }
+
+            auto ns = std::make_shared<reaver::despayre::name_space>();
+            val->add_property(name, ns);
+            val = ns;
+        }
+
+        return val;
+    }
+
+    // imports load plugins, which register their types in the context they are analyzed in, so expressions with imports anywhere in them are never left to thunks
+    bool imports(const reaver::despayre::semantic_context & ctx, const std::vector<reaver::despayre::token> & tokens, const reaver::despayre::expression & expr)
+    {
+        using namespace reaver::despayre;
+
+        auto simple_imports = [&](const simple_expression & simple) {
+            return reaver::get<0>(reaver::fmap(simple, reaver::make_overload_set(
+                [&](const instantiation & inst) {
+                    auto val = ctx.variables;
+                    for (auto i = 0ull; i < inst.type_name.identifiers.size() && val && val->type(); ++i)
+                    {
+                        val = val->get_property(tokens[inst.type_name.identifiers[i].token].name);
+                    }
+
+                    if (val && val->type() == get_type_identifier<type_descriptor_variable>() && val->as<type_descriptor_variable>()->identifier() == get_type_identifier<import_tag>())
+                    {
+                        return true;
+                    }
 
-using var_map = std::unordered_map<std::u32string, std::shared_ptr<reaver::despayre::_v1::variable>>;
+                    return std::any_of(inst.arguments.begin(), inst.arguments.end(), [&](auto && arg) { return imports(ctx, tokens, arg); });
+                },
 
-std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::analyze_expression(reaver::despayre::_v1::semantic_context & ctx, const reaver::despayre::_v1::expression & expr)
+                [&](const auto &) {
+                    return false;
+                }
+            )));
+        };
+
+        return simple_imports(expr.base) || std::any_of(expr.operations.begin(), expr.operations.end(), [&](auto && op) { return simple_imports(op.operand); });
+    }
+}
+
+std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::analyze_expression(reaver::despayre::_v1::semantic_context & ctx, const std::vector<reaver::despayre::_v1::token> & tokens, const reaver::despayre::_v1::expression & expr)
 {
-    auto lhs = analyze_simple_expression(ctx, expr.base);
+    auto lhs = analyze_simple_expression(ctx, tokens, expr.base);
 
     for (auto && op : expr.operations)
     {
-        auto rhs = analyze_simple_expression(ctx, op.operand);
+        auto rhs = analyze_simple_expression(ctx, tokens, op.operand);
         switch (op.operation)
         {
             case operation_type::addition:
@@ -51,25 +122,32 @@ std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::analyze_
 
         if (lhs->type() == nullptr)
         {
-            ctx.unresolved.emplace(std::dynamic_pointer_cast<delayed_variable>(lhs), range_type{ expr.range.start(), op.range.end() });
+            ctx.unresolved.emplace(delayed_variable::as_delayed(lhs), range_type{ expr.range.start(), op.range.end() });
         }
     }
 
     return lhs;
 }
 
-std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::analyze_simple_expression(semantic_context & ctx, const reaver::despayre::_v1::simple_expression & expr)
+std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::analyze_simple_expression(semantic_context & ctx, const std::vector<reaver::despayre::_v1::token> & tokens, const reaver::despayre::_v1::simple_expression & expr)
 {
     return get<0>(fmap(expr, make_overload_set(
         [&](const string_node & str) -> std::shared_ptr<variable> {
-            return std::make_shared<string>(str.value.string);
+            return std::make_shared<string>(utf32(tokens[str.token].string));
         },
 
         [&](const id_expression & expr) -> std::shared_ptr<variable> {
             auto val = ctx.variables;
             for (auto i = 0ull; i < expr.identifiers.size() && val; ++i)
             {
-                val = val->get_property(expr.identifiers[i].value.string);
+                // the members of unresolved variables aren't known yet; looked up again once they are
+                if (!val->type())
+                {
+                    val = nullptr;
+                    break;
+                }
+
+                val = val->get_property(tokens[expr.identifiers[i].token].name);
             }
 
             if (val)
@@ -77,25 +155,26 @@ std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::analyze_
                 return val;
             }
 
-            auto unresolved = std::make_shared<delayed_variable>(
-                fmap(expr.identifiers, [](auto && ident) { return ident.value.string; })
-            );
+            auto unresolved = std::make_shared<delayed_variable>(names(tokens, expr));
             ctx.unresolved.emplace(unresolved, expr.range);
             return unresolved;
         },
 
         [&](const instantiation & inst) -> std::shared_ptr<variable> {
-            auto instance = instantiate(
-                ctx,
-                fmap(inst.type_name.identifiers, [](auto && arg){ return arg.value.string; }),
-                fmap(inst.arguments, [&](auto && arg) { return analyze_expression(ctx, arg); })
-            );
+            std::vector<std::shared_ptr<variable>> arguments;
+            arguments.reserve(inst.arguments.size());
+            for (auto && arg : inst.arguments)
+            {
+                arguments.push_back(analyze_expression(ctx, tokens, arg));
+            }
+
+            auto instance = instantiate(ctx, names(tokens, inst.type_name), std::move(arguments));
 
             if (instance->type() == nullptr)
             {
                 // ugly; figure out a better way to do this
                 // without spilling semantic_context to the constructor
-                ctx.unresolved.emplace(std::dynamic_pointer_cast<delayed_variable>(instance), inst.range);
+                ctx.unresolved.emplace(delayed_variable::as_delayed(instance), inst.range);
             }
 
             return instance;
@@ -109,59 +188,313 @@ std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::analyze_
     )));
 }
 
-reaver::despayre::_v1::semantic_context reaver::despayre::_v1::analyze(const std::vector<reaver::despayre::_v1::assignment> & parse_tree)
+void reaver::despayre::_v1::analyze_assignment(reaver::despayre::_v1::semantic_context & ctx, const std::vector<reaver::despayre::_v1::token> & tokens, const reaver::despayre::_v1::assignment & assignment)
 {
-    semantic_context ctx;
-    ctx.variables = std::make_shared<name_space>();
-    register_builtins(ctx);
+    auto rhs_value = analyze_expression(ctx, tokens, assignment.rhs);
+    auto & lhs = assignment.lhs;
+
+    parent_of(ctx, tokens, lhs)->add_property(tokens[lhs.identifiers.back().token].name, rhs_value);
 
-    for (auto && assignment : parse_tree)
+    if (rhs_value->type() && rhs_value->type()->is_target_type)
     {
-        auto rhs_value = analyze_expression(ctx, assignment.rhs);
-        auto & lhs = assignment.lhs;
-        auto val = ctx.variables;
+        std::string name;
+        for (auto && identifier : lhs.identifiers)
+        {
+            if (!name.empty())
+            {
+                name += '.';
+            }
+            name += tokens[identifier.token].string.to_string();
+        }
 
-        for (auto i = 0ull; i < lhs.identifiers.size() - 1; ++i)
+        ctx.targets.emplace(intern(name), rhs_value->as_target());
+    }
+}
+
+void reaver::despayre::_v1::resolve(reaver::despayre::_v1::semantic_context & ctx)
+{
+    // every variable is tried once, and then once more each time the variable it waits on is resolved
+    std::vector<std::shared_ptr<delayed_variable>> worklist;
+    worklist.reserve(ctx.unresolved.size());
+    for (auto && u : ctx.unresolved)
+    {
+        worklist.push_back(u.first);
+    }
+
+    std::unordered_map<delayed_variable *, std::vector<std::shared_ptr<delayed_variable>>> waiting;
+    std::vector<std::shared_ptr<delayed_variable>> done;
+
+    // forcing a thunk analyzes its expression, which leaves delayed variables of its own; they are queued along with it
+    auto force_thunk = [&](const std::shared_ptr<delayed_variable> & thunk) {
+        decltype(ctx.unresolved) left;
+        std::swap(left, ctx.unresolved);
+        auto forced = thunk->try_resolve(ctx);
+        std::swap(left, ctx.unresolved);
+
+        for (auto && u : left)
         {
-            auto nested = val->get_property(lhs.identifiers[i].value.string);
-            if (nested)
+            worklist.push_back(u.first);
+            ctx.unresolved.insert(u);
+        }
+
+        return forced;
+    };
+
+    while (!worklist.empty())
+    {
+        auto current = std::move(worklist.back());
+        worklist.pop_back();
+
+        if (auto dependency = current->pending_dependency(ctx))
+        {
+            // delayed variables created by constructors, not by the analyzer, aren't tracked until something waits on them
+            if (ctx.unresolved.find(dependency) == ctx.unresolved.end())
             {
-                val = nested;
-                continue;
+                ctx.unresolved.emplace(dependency, ctx.unresolved.at(current));
+                worklist.push_back(dependency);
             }
 
-            auto ns = std::make_shared<name_space>();
-            val->add_property(lhs.identifiers[i].value.string, ns);
-            val = ns;
+            waiting[dependency.get()].push_back(std::move(current));
+            continue;
         }
 
-        val->add_property(lhs.identifiers.back().value.string, rhs_value);
+        // when this fails, the variable looks up a name that doesn't exist, or is a thunk that refers to itself; it's reported below
+        if (!(current->thunk() ? force_thunk(current) : current->resolved() || current->try_resolve(ctx)))
+        {
+            continue;
+        }
 
-        if (rhs_value->type() && rhs_value->type()->is_target_type)
+        // resolved to something that isn't yet, like the value of a thunk that was just forced; this is woken again once that is
+        if (current->pending_dependency(ctx))
         {
-            ctx.targets.emplace(
-                boost::join(fmap(assignment.lhs.identifiers, [](auto && i) { return i.value.string; }), U"."),
-                std::dynamic_pointer_cast<target>(rhs_value));
+            worklist.push_back(std::move(current));
+            continue;
         }
+
+        ctx.unresolved.erase(current);
+
+        auto waiters = waiting.find(current.get());
+        if (waiters != waiting.end())
+        {
+            std::move(waiters->second.begin(), waiters->second.end(), std::back_inserter(worklist));
+            waiting.erase(waiters);
+        }
+
+        done.push_back(std::move(current));
+    }
+
+    // chains of references are only complete now; shorten them while this is the only thread looking at them
+    for (auto && variable : done)
+    {
+        variable->compress();
     }
 
-    std::size_t previous = 0;
-    while (previous != ctx.unresolved.size())
+    if (ctx.unresolved.empty())
+    {
+        return;
+    }
+
+    // the variables waiting on others would only repeat their errors, so report the ones that are stuck by themselves, and the cycles
+    enum class verdict
+    {
+        waiting,
+        stuck,
+        cycle
+    };
+
+    std::unordered_map<delayed_variable *, verdict> verdicts;
+    for (auto && u : ctx.unresolved)
     {
-        previous = ctx.unresolved.size();
+        std::vector<delayed_variable *> chain;
+        auto current = u.first;
+        while (current && verdicts.find(current.get()) == verdicts.end())
+        {
+            verdicts.emplace(current.get(), verdict::waiting);
+            chain.push_back(current.get());
+            current = current->pending_dependency(ctx);
+        }
+
+        if (!current)
+        {
+            verdicts[chain.back()] = verdict::stuck;
+        }
 
-        for (auto && u : ctx.unresolved)
+        // the chain ran into itself, not into one walked before
+        else if (std::find(chain.begin(), chain.end(), current.get()) != chain.end())
         {
-            if (u.first->try_resolve(ctx))
+            for (auto it = std::find(chain.begin(), chain.end(), current.get()); it != chain.end(); ++it)
             {
+                verdicts[*it] = verdict::cycle;
+            }
+        }
+    }
+
+    std::vector<std::pair<range_type, std::string>> errors;
+    for (auto && u : ctx.unresolved)
+    {
+        switch (verdicts[u.first.get()])
+        {
+            case verdict::waiting:
+                break;
+
+            case verdict::stuck:
+            {
+                std::string name;
+                for (auto && part : u.first->looked_up_name())
+                {
+                    if (!name.empty())
+                    {
+                        name += '.';
+                    }
+                    name += part.string().to_string();
+                }
+
+                errors.emplace_back(u.second, name.empty() ? "could not have been resolved" : "`" + name + "` could not have been resolved");
+                break;
+            }
+
+            case verdict::cycle:
+                errors.emplace_back(u.second, "depends on itself");
                 break;
+        }
+    }
+
+    std::sort(errors.begin(), errors.end(), [](auto && lhs, auto && rhs) { return lhs.first.start().offset < rhs.first.start().offset; });
+
+    exception error{ logger::fatal };
+    error << "some variables could not have been resolved:";
+    for (auto && e : errors)
+    {
+        error << "\n    " << file_range{ ctx.file, e.first } << ": " << e.second;
+    }
+    throw error;
+}
+
+void reaver::despayre::_v1::force(reaver::despayre::_v1::semantic_context & ctx, const std::shared_ptr<reaver::despayre::_v1::variable> & var)
+{
+    auto delayed = delayed_variable::as_delayed(var);
+    if (!delayed || delayed->type())
+    {
+        return;
+    }
+
+    auto thunk = delayed->thunk();
+    ctx.unresolved.emplace(delayed, thunk ? thunk->range : range_type{});
+    resolve(ctx);
+}
+
+void reaver::despayre::_v1::force_all(reaver::despayre::_v1::semantic_context & ctx, const std::shared_ptr<reaver::despayre::_v1::variable> & var)
+{
+    // a forced thunk can turn out to be a namespace, with thunks of its own, so this goes on until a walk finds nothing left to force
+    for (auto forced = true; forced; )
+    {
+        forced = false;
+
+        std::vector<std::shared_ptr<variable>> pending{ var };
+        // namespaces can be reached more than once, through variables that alias them
+        std::unordered_set<const name_space *> visited;
+
+        while (!pending.empty())
+        {
+            auto current = std::move(pending.back());
+            pending.pop_back();
+
+            auto delayed = delayed_variable::as_delayed(current);
+            if (delayed && !delayed->type())
+            {
+                auto thunk = delayed->thunk();
+                ctx.unresolved.emplace(delayed, thunk ? thunk->range : range_type{});
+                forced = true;
+                continue;
+            }
+
+            if (current->type() == get_type_identifier<name_space>())
+            {
+                auto ns = current->as<name_space>();
+                if (visited.insert(ns.get()).second)
+                {
+                    for (auto && member : ns->properties())
+                    {
+                        pending.push_back(member.second);
+                    }
+                }
             }
         }
+
+        resolve(ctx);
+    }
+}
+
+namespace
+{
+    reaver::despayre::semantic_context make_context(reaver::despayre::glob_options options)
+    {
+        reaver::despayre::semantic_context ctx;
+        ctx.walk_options = std::make_shared<const reaver::despayre::glob_options>(std::move(options));
+        ctx.variables = std::make_shared<reaver::despayre::name_space>();
+        register_builtins(ctx);
+        return ctx;
+    }
+}
+
+reaver::despayre::_v1::semantic_context reaver::despayre::_v1::analyze(const reaver::despayre::_v1::parse_tree & tree, reaver::despayre::_v1::glob_options options)
+{
+    auto ctx = make_context(std::move(options));
+
+    for (auto && assignment : tree.assignments)
+    {
+        analyze_assignment(ctx, tree.tokens, assignment);
+    }
+
+    resolve(ctx);
+    return ctx;
+}
+
+reaver::despayre::_v1::semantic_context reaver::despayre::_v1::analyze(reaver::despayre::_v1::token_stream tokens, reaver::despayre::_v1::evaluation mode, reaver::despayre::_v1::glob_options options)
+{
+    auto ctx = make_context(std::move(options));
+    ctx.file = tokens.file();
+
+    if (mode == evaluation::eager)
+    {
+        // only a single assignment is ever held in the arena
+        arena nodes;
+        parse(std::move(tokens), nodes, [&](const std::vector<token> & lexed, const assignment & assignment) {
+            analyze_assignment(ctx, lexed, assignment);
+        });
+
+        resolve(ctx);
+        return ctx;
+    }
+
+    // thunks refer to their expressions for as long as they aren't forced, so the whole parse tree is kept
+    std::vector<token> lexed;
+    while (auto token = tokens.next())
+    {
+        lexed.push_back(std::move(*token));
+    }
+
+    auto buildfile = std::make_shared<parsed_buildfile>();
+    buildfile->tree = parse(std::move(lexed), buildfile->nodes, ctx.file);
+    const auto & tree = buildfile->tree;
+
+    for (auto && assignment : tree.assignments)
+    {
+        if (imports(ctx, tree.tokens, assignment.rhs))
+        {
+            analyze_assignment(ctx, tree.tokens, assignment);
+            continue;
+        }
+
+        auto & lhs = assignment.lhs;
+        parent_of(ctx, tree.tokens, lhs)->add_property(tree.tokens[lhs.identifiers.back().token].name, std::make_shared<delayed_variable>(buildfile, assignment.rhs));
     }
 
-    if (!ctx.unresolved.empty())
+    // resolving the imports forces whatever they depend on; the plugins only read their arguments once the build starts, so those are forced along
+    resolve(ctx);
+    for (auto && init : ctx.plugin_initializers)
     {
-        throw exception{ logger::fatal } << "some variables could not have been resolved; first at " << ctx.unresolved.begin()->second;
+        force_all(ctx, init.context);
     }
 
     return ctx;
@@ -0,0 +1,473 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+
+#include "despayre/semantics/snapshot.h"
+#include "despayre/semantics/semantics.h"
+#include "despayre/semantics/string.h"
+#include "despayre/semantics/namespace.h"
+#include "despayre/semantics/basic.h"
+#include "despayre/semantics/import.h"
+#include "despayre/runtime/files.h"
+#include "despayre/runtime/executable.h"
+#include "despayre/runtime/shared_library.h"
+#include "despayre/runtime/file_status.h"
+#include "despayre/runtime/protocol.h"
+
+namespace
+{
+    const std::string snapshot_magic = "despayre-graph-1";
+
+    // variables are stored in post order, so every reference points at an already loaded node
+    enum class node_kind : std::uint8_t
+    {
+        string,
+        name_space,
+        print,
+        aggregate,
+        files,
+        executable,
+        shared_library,
+        plugin
+    };
+
+    class snapshot_encoder
+    {
+    public:
+        // returns none when the variable (or anything it refers to) can't be stored
+        reaver::optional<std::uint32_t> add(const std::shared_ptr<reaver::despayre::variable> & var)
+        {
+            using namespace reaver::despayre;
+
+            auto type = var->type();
+
+            if (type == get_type_identifier<string>())
+            {
+                return _add(var->as<string>(), [&](auto && str, std::string & node) {
+                    put_value(node, node_kind::string);
+                    put_string(node, utf8(str->value()));
+                    return true;
+                });
+            }
+
+            if (type == get_type_identifier<name_space>())
+            {
+                return _add(var->as<name_space>(), [&](auto && ns, std::string & node) {
+                    put_value(node, node_kind::name_space);
+
+                    std::vector<std::pair<symbol, std::uint32_t>> properties;
+                    for (auto && property : ns->properties())
+                    {
+                        // those are registered again on load
+                        if (property.second->type() == get_type_identifier<type_descriptor_variable>())
+                        {
+                            continue;
+                        }
+
+                        auto id = this->add(property.second);
+                        if (!id)
+                        {
+                            return false;
+                        }
+                        properties.emplace_back(property.first, *id);
+                    }
+
+                    put_value<std::uint32_t>(node, properties.size());
+                    for (auto && property : properties)
+                    {
+                        put_string(node, property.first.string().to_string());
+                        put_value(node, property.second);
+                    }
+                    return true;
+                });
+            }
+
+            if (type == get_type_identifier<print>())
+            {
+                return _add(var->as<print>(), [&](auto && p, std::string & node) {
+                    put_value(node, node_kind::print);
+                    return this->_add_all(p->arguments(), node);
+                });
+            }
+
+            if (type == get_type_identifier<aggregate>())
+            {
+                return _add(var->as<aggregate>(), [&](auto && agg, std::string & node) {
+                    put_value(node, node_kind::aggregate);
+                    return this->_add_all(agg->dependencies(nullptr), node);
+                });
+            }
+
+            if (type == get_type_identifier<files>())
+            {
+                return _add(var->as<files>(), [&](auto && f, std::string & node) {
+                    put_value(node, node_kind::files);
+                    put_value<std::uint32_t>(node, f->paths().size());
+                    for (auto && path : f->paths())
+                    {
+                        put_string(node, path.string());
+                    }
+                    return true;
+                });
+            }
+
+            if (type == get_type_identifier<executable>())
+            {
+                return _add(var->as<executable>(), [&](auto && exe, std::string & node) {
+                    put_value(node, node_kind::executable);
+                    put_string(node, utf8(exe->name()));
+                    return this->_add_all(exe->dependencies(nullptr), node);
+                });
+            }
+
+            if (type == get_type_identifier<shared_library>())
+            {
+                return _add(var->as<shared_library>(), [&](auto && lib, std::string & node) {
+                    put_value(node, node_kind::shared_library);
+                    put_string(node, utf8(lib->name()));
+                    return this->_add_all(lib->dependencies(nullptr), node);
+                });
+            }
+
+            if (type == get_type_identifier<plugin_namespace>())
+            {
+                return _add(var->as<plugin_namespace>(), [&](auto && plugin, std::string & node) {
+                    put_value(node, node_kind::plugin);
+                    put_string(node, utf8(plugin->name()));
+
+                    auto arguments = this->add(plugin->arguments());
+                    if (!arguments)
+                    {
+                        return false;
+                    }
+                    put_value(node, *arguments);
+                    return true;
+                });
+            }
+
+            return reaver::none;
+        }
+
+        reaver::optional<std::uint32_t> id(const std::shared_ptr<reaver::despayre::variable> & var) const
+        {
+            auto it = _ids.find(var.get());
+            if (it == _ids.end())
+            {
+                return reaver::none;
+            }
+            return it->second;
+        }
+
+        std::uint32_t count = 0;
+        std::string nodes;
+
+    private:
+        // none while the variable is being encoded, to catch cycles
+        std::unordered_map<const reaver::despayre::variable *, reaver::optional<std::uint32_t>> _ids;
+
+        template<typename T, typename F>
+        reaver::optional<std::uint32_t> _add(std::shared_ptr<T> var, F encode)
+        {
+            auto it = _ids.find(var.get());
+            if (it != _ids.end())
+            {
+                return it->second;
+            }
+
+            _ids.emplace(var.get(), reaver::none);
+
+            std::string node;
+            if (!encode(var, node))
+            {
+                return reaver::none;
+            }
+
+            auto id = count++;
+            nodes += node;
+            _ids[var.get()] = id;
+            return id;
+        }
+
+        template<typename T>
+        bool _add_all(const std::vector<std::shared_ptr<T>> & vars, std::string & node)
+        {
+            std::vector<std::uint32_t> ids;
+            for (auto && var : vars)
+            {
+                auto id = add(var);
+                if (!id)
+                {
+                    return false;
+                }
+                ids.push_back(*id);
+            }
+
+            reaver::despayre::put_value<std::uint32_t>(node, ids.size());
+            for (auto id : ids)
+            {
+                reaver::despayre::put_value(node, id);
+            }
+            return true;
+        }
+    };
+
+    void merge_namespaces(const std::shared_ptr<reaver::despayre::variable> & into, const std::shared_ptr<reaver::despayre::variable> & from)
+    {
+        using namespace reaver::despayre;
+
+        for (auto && property : from->as<name_space>()->properties())
+        {
+            auto existing = into->get_property(property.first);
+            if (!existing)
+            {
+                into->add_property(property.first, property.second);
+                continue;
+            }
+
+            if (existing->type() == get_type_identifier<name_space>() && property.second->type() == get_type_identifier<name_space>())
+            {
+                merge_namespaces(existing, property.second);
+            }
+        }
+    }
+}
+
+bool reaver::despayre::_v1::save_snapshot(const reaver::despayre::_v1::semantic_context & ctx, const boost::filesystem::path & path, std::uint64_t buildfile_hash)
+{
+    snapshot_encoder encoder;
+
+    auto root = encoder.add(ctx.variables);
+    if (!root)
+    {
+        return false;
+    }
+
+    std::string body;
+    put_string(body, snapshot_magic);
+    put_value(body, buildfile_hash);
+
+    put_value<std::uint32_t>(body, ctx.globbed_directories->size());
+    for (auto && directory : *ctx.globbed_directories)
+    {
+        put_string(body, directory.first.string());
+        put_value(body, directory.second);
+    }
+
+    put_value(body, encoder.count);
+    body += encoder.nodes;
+    put_value(body, *root);
+
+    put_value<std::uint32_t>(body, ctx.targets.size());
+    for (auto && target : ctx.targets)
+    {
+        auto id = encoder.id(target.second);
+        if (!id)
+        {
+            return false;
+        }
+
+        put_string(body, target.first.string().to_string());
+        put_value(body, *id);
+    }
+
+    // written aside and renamed, so that a concurrent run never reads half a snapshot
+    auto temporary = path;
+    temporary += ".tmp";
+
+    {
+        std::ofstream output{ temporary.string(), std::ios::binary | std::ios::trunc };
+        output.write(body.data(), body.size());
+        if (!output)
+        {
+            return false;
+        }
+    }
+
+    boost::system::error_code error;
+    boost::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+reaver::optional<reaver::despayre::_v1::semantic_context> reaver::despayre::_v1::load_snapshot(const boost::filesystem::path & path, std::uint64_t buildfile_hash, reaver::despayre::_v1::glob_options options)
+{
+    std::ifstream input{ path.string(), std::ios::binary };
+    if (!input)
+    {
+        return none;
+    }
+
+    std::string body{ std::istreambuf_iterator<char>{ input.rdbuf() }, std::istreambuf_iterator<char>{} };
+
+    try
+    {
+        message_reader reader{ body };
+        if (reader.get_string() != snapshot_magic || reader.get<std::uint64_t>() != buildfile_hash)
+        {
+            return none;
+        }
+
+        semantic_context ctx;
+
+        auto directory_count = reader.get<std::uint32_t>();
+        for (auto i = 0u; i < directory_count; ++i)
+        {
+            boost::filesystem::path directory = reader.get_string();
+            auto last_write_time = reader.get<std::int64_t>();
+
+            if (stat_file(directory).last_write_time != last_write_time)
+            {
+                return none;
+            }
+
+            ctx.globbed_directories->emplace(std::move(directory), last_write_time);
+        }
+
+        ctx.walk_options = std::make_shared<const glob_options>(std::move(options));
+        ctx.variables = std::make_shared<name_space>();
+        register_builtins(ctx);
+
+        std::vector<std::shared_ptr<variable>> nodes;
+        auto get_node = [&]() {
+            auto id = reader.get<std::uint32_t>();
+            if (id >= nodes.size())
+            {
+                throw protocol_error{ "invalid node reference." };
+            }
+            return nodes[id];
+        };
+
+        auto get_nodes = [&]() {
+            std::vector<std::shared_ptr<variable>> ret(reader.get<std::uint32_t>());
+            for (auto && node : ret)
+            {
+                node = get_node();
+            }
+            return ret;
+        };
+
+        auto node_count = reader.get<std::uint32_t>();
+        nodes.reserve(node_count);
+        for (auto i = 0u; i < node_count; ++i)
+        {
+            switch (reader.get<node_kind>())
+            {
+                case node_kind::string:
+                    nodes.push_back(std::make_shared<string>(utf32(reader.get_string())));
+                    break;
+
+                case node_kind::name_space:
+                {
+                    auto ns = std::make_shared<name_space>();
+                    auto property_count = reader.get<std::uint32_t>();
+                    for (auto j = 0u; j < property_count; ++j)
+                    {
+                        auto name = intern(reader.get_string());
+                        ns->add_property(name, get_node());
+                    }
+                    nodes.push_back(std::move(ns));
+                    break;
+                }
+
+                case node_kind::print:
+                    nodes.push_back(std::make_shared<print>(get_nodes()));
+                    break;
+
+                case node_kind::aggregate:
+                    nodes.push_back(std::make_shared<aggregate>(get_nodes()));
+                    break;
+
+                case node_kind::files:
+                {
+                    std::vector<boost::filesystem::path> paths(reader.get<std::uint32_t>());
+                    for (auto && path : paths)
+                    {
+                        path = reader.get_string();
+                    }
+                    nodes.push_back(std::make_shared<files>(std::move(paths)));
+                    break;
+                }
+
+                case node_kind::executable:
+                {
+                    std::vector<std::shared_ptr<variable>> arguments = { std::make_shared<string>(utf32(reader.get_string())) };
+                    auto dependencies = get_nodes();
+                    arguments.insert(arguments.end(), dependencies.begin(), dependencies.end());
+                    nodes.push_back(std::make_shared<executable>(std::move(arguments)));
+                    break;
+                }
+
+                case node_kind::shared_library:
+                {
+                    std::vector<std::shared_ptr<variable>> arguments = { std::make_shared<string>(utf32(reader.get_string())) };
+                    auto dependencies = get_nodes();
+                    arguments.insert(arguments.end(), dependencies.begin(), dependencies.end());
+                    nodes.push_back(std::make_shared<shared_library>(std::move(arguments)));
+                    break;
+                }
+
+                case node_kind::plugin:
+                {
+                    auto name = utf32(reader.get_string());
+                    nodes.push_back(import_plugin(ctx, std::move(name), get_node()));
+                    break;
+                }
+
+                default:
+                    throw protocol_error{ "invalid node kind." };
+            }
+        }
+
+        auto root = get_node();
+        if (root->type() != get_type_identifier<name_space>())
+        {
+            throw protocol_error{ "the root of the graph is not a namespace." };
+        }
+        merge_namespaces(ctx.variables, root);
+
+        auto target_count = reader.get<std::uint32_t>();
+        for (auto i = 0u; i < target_count; ++i)
+        {
+            auto name = intern(reader.get_string());
+            auto node = get_node();
+            if (!node->type()->is_target_type)
+            {
+                throw protocol_error{ "a target of the graph is not a target." };
+            }
+            ctx.targets.emplace(name, node->as_target());
+        }
+
+        if (!reader.empty())
+        {
+            throw protocol_error{ "trailing data after the graph." };
+        }
+
+        return std::move(ctx);
+    }
+
+    catch (protocol_error &)
+    {
+        return none;
+    }
+}
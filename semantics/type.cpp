@@ -31,7 +31,7 @@ using type_identifier = reaver::despayre::_v1::type_identifier;
 using type_descriptor = reaver::despayre::_v1::type_descriptor;
 using variable_ptr = std::shared_ptr<reaver::despayre::_v1::variable>;
 
-void reaver::despayre::_v1::_detail::_save_identifier(reaver::despayre::_v1::semantic_context & ctx, const std::vector<std::u32string> & name, type_identifier id)
+void reaver::despayre::_v1::_detail::_save_identifier(reaver::despayre::_v1::semantic_context & ctx, const std::vector<reaver::despayre::_v1::symbol> & name, type_identifier id)
 {
     auto val = ctx.variables;
     for (auto i = 0ull; i < name.size() - 1; ++i)
@@ -56,7 +56,7 @@ void reaver::despayre::_v1::_detail::_save_descriptor(semantic_context & ctx, ty
     ctx.type_descriptors.emplace(id, type_descriptor{ std::move(name), std::move(source_module), type_constructor });
 }
 
-variable_ptr reaver::despayre::_v1::instantiate(const semantic_context & ctx, const std::vector<std::u32string> & name, std::vector<variable_ptr> variables)
+variable_ptr reaver::despayre::_v1::instantiate(const semantic_context & ctx, const std::vector<reaver::despayre::_v1::symbol> & name, std::vector<variable_ptr> variables)
 {
     auto val = ctx.variables;
     for (auto i = 0ull; i < name.size() && val; ++i)
@@ -20,44 +20,93 @@
  *
  **/
 
+#include <reaver/unit.h>
+
 #include "despayre/semantics/variable.h"
 #include "despayre/semantics/target.h"
+#include "despayre/semantics/string.h"
 
 std::shared_ptr<reaver::despayre::_v1::target> reaver::despayre::_v1::variable::as_target()
 {
     if (type() && type()->is_target_type)
     {
-        return std::dynamic_pointer_cast<target>(_shared_this());
+        return std::static_pointer_cast<target>(_shared_this());
     }
 
     throw std::bad_cast{};
 }
 
-std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::variable::operator+(std::shared_ptr<reaver::despayre::_v1::variable> other)
+namespace
 {
-    auto it = _operator_plus_call_table.find(other->type());
-    if (it != _operator_plus_call_table.end())
+    struct operator_key
+    {
+        reaver::despayre::operation_type operation;
+        reaver::despayre::type_identifier lhs;
+        reaver::despayre::type_identifier rhs;
+
+        bool operator==(const operator_key & other) const
+        {
+            return operation == other.operation && lhs == other.lhs && rhs == other.rhs;
+        }
+    };
+
+    struct operator_key_hash
+    {
+        std::size_t operator()(const operator_key & key) const
+        {
+            std::hash<reaver::despayre::type_identifier> hasher;
+            return hasher(key.lhs) * 31 + hasher(key.rhs) * 2 + static_cast<std::size_t>(key.operation);
+        }
+    };
+
+    // filled by static initializers, and by plugins as they are loaded; only read after that
+    std::unordered_map<operator_key, reaver::despayre::operator_handler *, operator_key_hash> & operator_table()
     {
-        return it->second(_shared_this(), other);
+        static std::unordered_map<operator_key, reaver::despayre::operator_handler *, operator_key_hash> table;
+        return table;
     }
+}
+
+void reaver::despayre::_v1::register_operator(reaver::despayre::_v1::operation_type operation, reaver::despayre::_v1::type_identifier lhs, reaver::despayre::_v1::type_identifier rhs, reaver::despayre::_v1::operator_handler * handler)
+{
+    operator_table()[{ operation, lhs, rhs }] = handler;
+}
 
-    it = other->_operator_plus_call_table.find(type());
-    if (it != other->_operator_plus_call_table.end())
+reaver::despayre::_v1::operator_handler * reaver::despayre::_v1::find_operator(reaver::despayre::_v1::operation_type operation, reaver::despayre::_v1::type_identifier lhs, reaver::despayre::_v1::type_identifier rhs)
+{
+    // an operand that isn't resolved yet makes the whole operation wait for it
+    if (!lhs || !rhs)
     {
-        return it->second(other, _shared_this());
+        return operation == operation_type::addition ? delayed_addition : delayed_removal;
     }
 
-    // delayed_variable solution; it does currently look like a hack, doesn't it?
-    it = _shared_this()->_operator_plus_call_table.find(other->type());
-    if (it != _shared_this()->_operator_plus_call_table.end())
+    auto & table = operator_table();
+    auto it = table.find({ operation, lhs, rhs });
+    return it != table.end() ? it->second : nullptr;
+}
+
+static auto builtin_operators_init = []() -> reaver::unit
+{
+    using namespace reaver::despayre;
+
+    register_operator(operation_type::addition, get_type_identifier<string>(), get_type_identifier<string>(), [](std::shared_ptr<variable> lhs, std::shared_ptr<variable> rhs) -> std::shared_ptr<variable> {
+        return std::make_shared<string>(lhs->as<string>()->value() + rhs->as<string>()->value());
+    });
+
+    return {};
+}();
+
+std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::variable::operator+(std::shared_ptr<reaver::despayre::_v1::variable> other)
+{
+    if (auto handler = find_operator(operation_type::addition, type(), other->type()))
     {
-        return it->second(_shared_this(), other);
+        return handler(_shared_this(), other);
     }
 
-    it = other->_shared_this()->_operator_plus_call_table.find(type());
-    if (it != other->_shared_this()->_operator_plus_call_table.end())
+    // a handler registered for the types the other way around is used too, with the operands swapped to match it
+    if (auto handler = find_operator(operation_type::addition, other->type(), type()))
     {
-        return it->second(other, _shared_this());
+        return handler(other, _shared_this());
     }
 
     // TODO: throw an exception
@@ -66,20 +115,11 @@ std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::variable
 
 std::shared_ptr<reaver::despayre::_v1::variable> reaver::despayre::_v1::variable::operator-(std::shared_ptr<reaver::despayre::_v1::variable> other)
 {
-    auto it = _operator_minus_call_table.find(other->type());
-    if (it != _operator_minus_call_table.end())
-    {
-        return it->second(_shared_this(), other);
-    }
-
-    // delayed_variable solution; it does currently look like a hack, doesn't it?
-    it = _shared_this()->_operator_minus_call_table.find(other->type());
-    if (it != _shared_this()->_operator_minus_call_table.end())
+    if (auto handler = find_operator(operation_type::removal, type(), other->type()))
     {
-        return it->second(_shared_this(), other);
+        return handler(_shared_this(), other);
     }
 
     // TODO: throw an exception
     assert(0);
 }
-
@@ -0,0 +1,77 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <fstream>
+
+#include <reaver/mayfly.h>
+
+#include "despayre/runtime/content_hashes.h"
+
+#include "helpers.h"
+
+namespace
+{
+    // rewrites the file without changing its inode, size or mtime, like a write within the same tick of the clock would
+    void rewrite(const boost::filesystem::path & path, const std::string & contents)
+    {
+        auto time = reaver::despayre::stat_file(path).last_write_time;
+        std::ofstream{ path.string() } << contents;
+        reaver::despayre::set_last_write_time(path, time);
+    }
+}
+
+MAYFLY_BEGIN_SUITE("content hashes");
+
+MAYFLY_ADD_TESTCASE("racily clean files", []()
+{
+    using namespace reaver::despayre;
+
+    temporary_directory directory;
+    auto file = directory.path / "file";
+
+    build_log log{ directory.path / "log" };
+    content_hashes hashes{ log, true };
+
+    // a fresh stat cache every time, as every build has
+    auto hash = [&]{
+        file_status_cache file_status;
+        return hashes.hash(file_status, file);
+    };
+
+    // modified long before it was hashed; the hash is trusted as long as the file looks the same
+    directory.write("file", "aaaa");
+    set_last_write_time(file, current_file_time() - 10000000000);
+    auto first = hash();
+
+    rewrite(file, "bbbb");
+    MAYFLY_CHECK(hash() == first);
+
+    // modified no earlier than it was hashed; it could have changed again without the mtime showing it
+    set_last_write_time(file, current_file_time() + 10000000000);
+    auto second = hash();
+    MAYFLY_CHECK(second != first);
+
+    rewrite(file, "cccc");
+    MAYFLY_CHECK(hash() != second);
+});
+
+MAYFLY_END_SUITE;
@@ -0,0 +1,109 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <thread>
+
+#include <reaver/mayfly.h>
+
+#include "despayre/runtime/daemon.h"
+
+#include "helpers.h"
+
+namespace
+{
+    reaver::despayre::daemon_request request(std::string target)
+    {
+        reaver::despayre::daemon_request ret;
+        ret.target = std::move(target);
+        ret.output_directory = "output";
+        ret.jobs = 1;
+        return ret;
+    }
+
+    int build(std::string target)
+    {
+        auto exit_code = reaver::despayre::build_with_daemon(request(std::move(target)));
+        return exit_code ? *exit_code : -1;
+    }
+}
+
+MAYFLY_BEGIN_SUITE("daemon");
+
+MAYFLY_ADD_TESTCASE("request encoding", []()
+{
+    using namespace reaver::despayre;
+
+    auto original = request("foo.bar");
+    original.remote_cache = "cache.socket";
+    original.workers = { "tcp:localhost:1234", "worker.socket" };
+    original.remote_jobs = 8;
+    original.stats = true;
+    original.working_directory = "/some/where";
+    original.environment = { "CXX=clang++", "CXXFLAGS=-O2 -g" };
+
+    auto encoded = encode(original);
+    message_reader reader{ encoded };
+    auto decoded = decode_daemon_request(reader);
+
+    MAYFLY_CHECK(reader.empty());
+    MAYFLY_CHECK(decoded.target == original.target);
+    MAYFLY_CHECK(decoded.output_directory == original.output_directory);
+    MAYFLY_CHECK(decoded.jobs == original.jobs);
+    MAYFLY_CHECK(decoded.remote_cache == original.remote_cache);
+    MAYFLY_CHECK(decoded.workers == original.workers);
+    MAYFLY_CHECK(decoded.remote_jobs == original.remote_jobs);
+    MAYFLY_CHECK(decoded.stats);
+    MAYFLY_CHECK(decoded.working_directory == original.working_directory);
+    MAYFLY_CHECK(decoded.environment == original.environment);
+});
+
+MAYFLY_ADD_TESTCASE("builds", []()
+{
+    using namespace reaver::despayre;
+
+    workspace directory;
+    MAYFLY_CHECK(build("hello") == -1);
+
+    directory.write("buildfile", "hello = debug_print(\"hello\")\n");
+
+    build_daemon server{ "buildfile" };
+    std::thread thread{ [&]{ server.run(); } };
+
+    MAYFLY_CHECK(build("hello") == 0);
+    MAYFLY_CHECK(build("hello") == 0);
+    MAYFLY_CHECK(build("goodbye") == 2);
+
+    // the daemon has to notice the buildfile changing
+    directory.write("buildfile", "hello = debug_print(\"hello\")\ngoodbye = debug_print(\"goodbye\")\n");
+    MAYFLY_CHECK(build("goodbye") == 0);
+
+    // a client elsewhere is turned down, and has to build on its own
+    auto elsewhere = request("hello");
+    elsewhere.working_directory = directory.previous.string();
+    MAYFLY_CHECK(!build_with_daemon(elsewhere));
+    MAYFLY_CHECK(build("hello") == 0);
+
+    server.stop();
+    thread.join();
+});
+
+MAYFLY_END_SUITE;
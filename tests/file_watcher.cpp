@@ -0,0 +1,107 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <thread>
+
+#include <reaver/mayfly.h>
+
+#include "despayre/runtime/file_watcher.h"
+
+#include "helpers.h"
+
+MAYFLY_BEGIN_SUITE("file watcher");
+
+MAYFLY_ADD_TESTCASE("changes", []()
+{
+    using namespace reaver::despayre;
+
+    temporary_directory directory;
+    boost::filesystem::create_directory(directory.path / "nested");
+    file_watcher watcher;
+    watcher.watch(directory.path);
+
+    directory.write("first", "1");
+    directory.write("second", "2");
+    // not watched, as watching isn't recursive
+    directory.write("nested/third", "3");
+
+    auto changes = watcher.wait(50);
+    MAYFLY_CHECK(!changes.overflow);
+    MAYFLY_CHECK(!changes.interrupted);
+    MAYFLY_CHECK(changes.paths.size() == 2);
+    MAYFLY_CHECK(changes.paths.count(directory.path / "first"));
+    MAYFLY_CHECK(changes.paths.count(directory.path / "second"));
+
+    boost::filesystem::rename(directory.path / "first", directory.path / "renamed");
+    changes = watcher.wait(50);
+    MAYFLY_CHECK(changes.paths.size() == 2);
+    MAYFLY_CHECK(changes.paths.count(directory.path / "first"));
+    MAYFLY_CHECK(changes.paths.count(directory.path / "renamed"));
+});
+
+MAYFLY_ADD_TESTCASE("pending changes", []()
+{
+    using namespace reaver::despayre;
+
+    temporary_directory directory;
+    boost::filesystem::create_directory(directory.path / "nested");
+    file_watcher watcher;
+    watcher.watch(directory.path);
+    watcher.watch(directory.path / "nested");
+
+    MAYFLY_CHECK(watcher.pending().paths.empty());
+
+    directory.write("first", "1");
+    auto changes = watcher.pending();
+    MAYFLY_CHECK(changes.paths.size() == 1);
+    MAYFLY_CHECK(changes.paths.count(directory.path / "first"));
+    MAYFLY_CHECK(watcher.pending().paths.empty());
+
+    MAYFLY_CHECK(watcher.watching(directory.path / "nested"));
+    boost::filesystem::remove_all(directory.path / "nested");
+    changes = watcher.pending();
+    MAYFLY_CHECK(changes.paths.count(directory.path / "nested"));
+    MAYFLY_CHECK(!watcher.watching(directory.path / "nested"));
+});
+
+MAYFLY_ADD_TESTCASE("interrupt", []()
+{
+    using namespace reaver::despayre;
+
+    temporary_directory directory;
+    boost::filesystem::create_directory(directory.path / "nested");
+    file_watcher watcher;
+    watcher.watch(directory.path);
+
+    std::thread interrupt{ [&]{
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        watcher.interrupt();
+    } };
+
+    auto changes = watcher.wait(50);
+    interrupt.join();
+
+    MAYFLY_CHECK(changes.interrupted);
+    MAYFLY_CHECK(changes.paths.empty());
+});
+
+MAYFLY_END_SUITE;
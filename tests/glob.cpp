@@ -0,0 +1,190 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <set>
+
+#include <reaver/mayfly.h>
+
+#include "despayre/runtime/files.h"
+#include "despayre/runtime/glob.h"
+#include "despayre/semantics/semantics.h"
+
+#include "helpers.h"
+
+namespace
+{
+    // symlinked directories are never followed, but symlinked files are matched
+    struct glob_workspace : workspace
+    {
+        glob_workspace() : workspace{ "a.cpp", "b.h", "src/x.cpp", "src/.hidden.cpp", "src/deep/y.cpp", "src/deep/er/z.cpp", "src/deep/er/z.h", ".git/objects/o.cpp", "output/.despayre_log", "output/obj/o.cpp", "stage/o.cpp", "tests/t.cpp", "tests/unit/u.cpp", "tests/unit/u.h" }
+        {
+            boost::filesystem::create_directory_symlink(path / "src", path / "link");
+            boost::filesystem::create_symlink(path / "a.cpp", path / "src/linked.cpp");
+        }
+    };
+
+    std::vector<std::string> matches(const reaver::despayre::glob_query & query, std::size_t threads = 0, const reaver::despayre::glob_options & options = {})
+    {
+        std::vector<std::string> ret;
+        for (auto && path : reaver::despayre::match_glob(query, threads, options).matches)
+        {
+            ret.push_back(path.string());
+        }
+        return ret;
+    }
+}
+
+MAYFLY_BEGIN_SUITE("glob");
+
+MAYFLY_ADD_TESTCASE("single directory", []()
+{
+    glob_workspace ws;
+
+    MAYFLY_CHECK(matches({ "*.cpp" }) == (std::vector<std::string>{ "a.cpp" }));
+    MAYFLY_CHECK(matches({ "src/*.cpp" }) == (std::vector<std::string>{ "src/linked.cpp", "src/x.cpp" }));
+    MAYFLY_CHECK(matches({ "./src/.*.cpp" }) == (std::vector<std::string>{ "src/.hidden.cpp" }));
+    MAYFLY_CHECK(matches({ "src/deep/er/z.cpp" }) == (std::vector<std::string>{ "src/deep/er/z.cpp" }));
+    MAYFLY_CHECK(matches({ "missing/*.cpp" }).empty());
+});
+
+MAYFLY_ADD_TESTCASE("recursive", []()
+{
+    glob_workspace ws;
+
+    // the order is the one boost::filesystem::path uses, so `src/deep/...` comes before `src/linked.cpp`
+    std::vector<std::string> expected = { "a.cpp", "src/deep/er/z.cpp", "src/deep/y.cpp", "src/linked.cpp", "src/x.cpp", "stage/o.cpp", "tests/t.cpp", "tests/unit/u.cpp" };
+    MAYFLY_CHECK(matches({ "**/*.cpp" }) == expected);
+    MAYFLY_CHECK(matches({ "**/*.cpp" }, 1) == expected);
+    MAYFLY_CHECK(matches({ "**/*.cpp" }, 8) == expected);
+
+    MAYFLY_CHECK(matches({ "src/**/*.cpp" }) == (std::vector<std::string>{ "src/deep/er/z.cpp", "src/deep/y.cpp", "src/linked.cpp", "src/x.cpp" }));
+    MAYFLY_CHECK(matches({ "src/**/er/*" }) == (std::vector<std::string>{ "src/deep/er/z.cpp", "src/deep/er/z.h" }));
+    MAYFLY_CHECK(matches({ "src/*/y.cpp" }) == (std::vector<std::string>{ "src/deep/y.cpp" }));
+    MAYFLY_CHECK(matches({ "src/deep/**" }) == (std::vector<std::string>{ "src/deep/er/z.cpp", "src/deep/er/z.h", "src/deep/y.cpp" }));
+});
+
+MAYFLY_ADD_TESTCASE("globbed directories", []()
+{
+    glob_workspace ws;
+
+    auto directories = [](const std::string & pattern) {
+        std::set<std::string> ret;
+        for (auto && directory : reaver::despayre::match_glob(pattern).directories)
+        {
+            ret.insert(directory.path.string());
+        }
+        return ret;
+    };
+
+    MAYFLY_CHECK(directories("src/*.cpp") == (std::set<std::string>{ "src" }));
+    MAYFLY_CHECK(directories("**/*.cpp") == (std::set<std::string>{ ".", "src", "src/deep", "src/deep/er", "stage", "tests", "tests/unit" }));
+    MAYFLY_CHECK(directories("missing/*.cpp") == (std::set<std::string>{ "missing" }));
+});
+
+MAYFLY_ADD_TESTCASE("ignored directories", []()
+{
+    using namespace reaver::despayre;
+
+    glob_workspace ws;
+
+    // `.git` and directories with a build log are never entered, even when asked for
+    MAYFLY_CHECK(matches({ ".git/*/*.cpp" }).empty());
+    MAYFLY_CHECK(matches({ "*/obj/*.cpp" }).empty());
+    MAYFLY_CHECK(matches({ "output/obj/*.cpp" }).empty());
+
+    glob_options options;
+    options.output_directories = { ws.path / "stage" };
+    options.ignored = { "deep", "/tests/unit" };
+    MAYFLY_CHECK(matches({ "**/*.cpp" }, 0, options) == (std::vector<std::string>{ "a.cpp", "src/linked.cpp", "src/x.cpp", "tests/t.cpp" }));
+
+    // the glob builtin walks with the options the buildfile was analyzed with
+    auto ctx = analyze(token_stream{ "sources = glob(\"**/*.cpp\")" }, evaluation::eager, options);
+    MAYFLY_CHECK(ctx.variables->get_property(U"sources")->as<files>()->paths() == (std::vector<boost::filesystem::path>{ "a.cpp", "src/linked.cpp", "src/x.cpp", "tests/t.cpp" }));
+
+    ws.write(".despayreignore", "# comment\n\nsrc/deep/\n  \nstage\n");
+    MAYFLY_CHECK(read_ignore_file(ws.path / ".despayreignore") == (std::vector<std::string>{ "src/deep", "stage" }));
+    MAYFLY_CHECK(read_ignore_file(ws.path / "missing").empty());
+});
+
+MAYFLY_ADD_TESTCASE("exclusions", []()
+{
+    using namespace reaver::despayre;
+
+    glob_workspace ws;
+
+    MAYFLY_CHECK(can_exclude("**/*.cpp", "tests/**/*.cpp"));
+    MAYFLY_CHECK(can_exclude("src/**/*.cpp", "src/deep/*.cpp"));
+    MAYFLY_CHECK(can_exclude("**/*.cpp", "a.cpp"));
+    MAYFLY_CHECK(!can_exclude("src/**/*.cpp", "**/*.cpp"));
+    MAYFLY_CHECK(!can_exclude("**/*.cpp", "/tmp/**/*.cpp"));
+
+    MAYFLY_CHECK(matches({ "**/*.cpp", { "tests/**/*.cpp", "src/deep/*.cpp", "a.cpp" } }) == (std::vector<std::string>{ "src/deep/er/z.cpp", "src/linked.cpp", "src/x.cpp", "stage/o.cpp" }));
+    MAYFLY_CHECK(matches({ "**", { "**/*.cpp" } }) == (std::vector<std::string>{ "b.h", "src/deep/er/z.h", "tests/unit/u.h" }));
+
+    // a subtree an exclusion matches everything in isn't walked at all
+    auto walk = match_glob({ "**/*.cpp", { "tests/**/*.cpp", "src/**" } });
+    std::set<std::string> directories;
+    for (auto && directory : walk.directories)
+    {
+        directories.insert(directory.path.string());
+    }
+    MAYFLY_CHECK(directories == (std::set<std::string>{ ".", "stage" }));
+
+    // ...unless the pattern can match files that the exclusion wouldn't
+    MAYFLY_CHECK(matches({ "**/.*.cpp", { "src/**/*.cpp" } }) == (std::vector<std::string>{ "src/.hidden.cpp" }));
+});
+
+MAYFLY_ADD_TESTCASE("removals pushed into walks", []()
+{
+    using namespace reaver::despayre;
+
+    glob_workspace ws;
+
+    auto make_glob = [](std::string pattern) {
+        return std::make_shared<files>(std::vector<files::pending_glob>{ { { std::move(pattern), {} }, nullptr } }, std::vector<boost::filesystem::path>{}, std::vector<boost::filesystem::path>{});
+    };
+    auto make_files = [](std::vector<boost::filesystem::path> paths) {
+        return std::make_shared<files>(std::move(paths));
+    };
+    auto strings = [](const std::shared_ptr<files> & f) {
+        std::vector<std::string> ret;
+        for (auto && path : f->paths())
+        {
+            ret.push_back(path.string());
+        }
+        return ret;
+    };
+
+    auto main_sources = make_files({ "a.cpp" })->unite(*make_glob("src/deep/**/*.cpp"));
+    auto lib_sources = make_glob("**/*.cpp")->remove(*main_sources)->remove(*make_glob("tests/**/*.cpp"))->remove(*make_files({ "stage/o.cpp" }));
+    MAYFLY_CHECK(strings(lib_sources) == (std::vector<std::string>{ "src/linked.cpp", "src/x.cpp" }));
+
+    // the ones that can't be pushed down are still removed
+    auto headers = make_glob("src/**/*.h")->remove(*make_glob("**/z.h"));
+    MAYFLY_CHECK(headers->paths().empty());
+    auto removed_twice = make_glob("**/*.cpp")->remove(*make_glob("src/**/*.cpp")->remove(*make_files({ "src/x.cpp" })));
+    MAYFLY_CHECK(strings(removed_twice) == (std::vector<std::string>{ "a.cpp", "src/x.cpp", "stage/o.cpp", "tests/t.cpp", "tests/unit/u.cpp" }));
+    auto joined = make_glob("tests/*.cpp")->remove(*make_files({ "tests/t.cpp" }))->unite(*make_glob("tests/**/u.cpp"));
+    MAYFLY_CHECK(strings(joined) == (std::vector<std::string>{ "tests/unit/u.cpp" }));
+});
+
+MAYFLY_END_SUITE;
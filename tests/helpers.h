@@ -0,0 +1,76 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#pragma once
+
+#include <fstream>
+#include <initializer_list>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+// a fresh directory, removed with everything in it at the end of the test
+struct temporary_directory
+{
+    temporary_directory()
+    {
+        boost::filesystem::create_directories(path);
+    }
+
+    ~temporary_directory()
+    {
+        boost::filesystem::remove_all(path);
+    }
+
+    temporary_directory(const temporary_directory &) = delete;
+    temporary_directory & operator=(const temporary_directory &) = delete;
+
+    void write(const boost::filesystem::path & file, const std::string & contents = {})
+    {
+        boost::filesystem::create_directories((path / file).parent_path());
+        std::ofstream{ (path / file).string() } << contents;
+    }
+
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+};
+
+// a temporary directory with the given (empty) files in it, which the test moves into for its duration,
+// as buildfiles, globs and the daemon all work relative to the working directory
+struct workspace : temporary_directory
+{
+    workspace(std::initializer_list<boost::filesystem::path> files = {}) : previous{ boost::filesystem::current_path() }
+    {
+        for (auto && file : files)
+        {
+            write(file);
+        }
+
+        boost::filesystem::current_path(path);
+    }
+
+    ~workspace()
+    {
+        boost::filesystem::current_path(previous);
+    }
+
+    boost::filesystem::path previous;
+};
@@ -0,0 +1,169 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <sstream>
+#include <utility>
+
+#include <reaver/mayfly.h>
+
+#include "despayre/parser/lexer.h"
+
+namespace
+{
+    std::vector<reaver::despayre::scan_implementation> supported_implementations()
+    {
+        using namespace reaver::despayre;
+
+        std::vector<scan_implementation> ret;
+        for (auto implementation : { scan_implementation::scalar, scan_implementation::sse2, scan_implementation::avx2 })
+        {
+            if (get_scanner(implementation))
+            {
+                ret.push_back(implementation);
+            }
+        }
+        return ret;
+    }
+
+    // the line and column of the byte at `offset`, the slow way
+    std::pair<std::uint32_t, std::uint32_t> line_and_column(const std::string & buildfile, std::size_t offset)
+    {
+        std::uint32_t line = 1;
+        std::uint32_t column = 1;
+        for (std::size_t i = 0; i < offset; ++i)
+        {
+            if (buildfile[i] == '\n')
+            {
+                ++line;
+                column = 1;
+            }
+            else if ((static_cast<unsigned char>(buildfile[i]) & 0xc0) != 0x80)
+            {
+                ++column;
+            }
+        }
+        return { line, column };
+    }
+}
+
+MAYFLY_BEGIN_SUITE("lexer");
+
+MAYFLY_ADD_TESTCASE("utf-8 positions", []()
+{
+    using namespace reaver::despayre;
+
+    std::string buildfile = "a = \"żółw\"\n  b = \"\\\"\"";
+    auto tokens = tokenize(buildfile);
+    MAYFLY_REQUIRE(tokens.size() == 6);
+
+    MAYFLY_CHECK(tokens[2].string == "żółw");
+    MAYFLY_CHECK(tokens[2].range.start().offset == 4);
+    MAYFLY_CHECK(tokens[2].range.end().offset == 13);
+    MAYFLY_CHECK(tokens[2].range.end().column == 11);
+
+    MAYFLY_CHECK(tokens[3].string == "b");
+    MAYFLY_CHECK(tokens[3].range.start().line == 2);
+    MAYFLY_CHECK(tokens[3].range.start().column == 3);
+
+    // escapes are kept as they were
+    MAYFLY_CHECK(tokens[5].string == "\\\"");
+});
+
+MAYFLY_ADD_TESTCASE("lexer errors", []()
+{
+    using namespace reaver::despayre;
+
+    MAYFLY_CHECK_THROWS_TYPE(unterminated_string, tokenize("a = \"b"));
+    MAYFLY_CHECK_THROWS_TYPE(unterminated_string, tokenize("a = \"b\nc\""));
+    MAYFLY_CHECK_THROWS_TYPE(unterminated_comment, tokenize("a = b /* c"));
+    MAYFLY_CHECK(tokenize("a /* b */ = // c\n d").size() == 3);
+});
+
+MAYFLY_ADD_TESTCASE("file names in diagnostics", []()
+{
+    using namespace reaver::despayre;
+
+    std::string file = "sub/buildfile";
+    position start;
+    start.offset = 4;
+    start.line = 2;
+    start.column = 3;
+    range_type range{ start, start + 1 };
+
+    std::ostringstream os;
+    os << file_range{ file, range };
+    MAYFLY_CHECK(os.str() == "sub/buildfile:2:3 (4)");
+
+    token_stream stream{ "a = \"b", file };
+    MAYFLY_CHECK(stream.file() == file);
+    try
+    {
+        while (stream.next())
+        {
+        }
+        MAYFLY_CHECK(false);
+    }
+    catch (unterminated_string & ex)
+    {
+        MAYFLY_CHECK(ex.file == file);
+        MAYFLY_CHECK(ex.range.start().column == 5);
+    }
+});
+
+MAYFLY_ADD_TESTCASE("scanners", []()
+{
+    using namespace reaver::despayre;
+
+    // runs long enough to cross vector boundaries, with the interesting bytes at every alignment
+    std::string buildfile;
+    for (auto i = 0; i < 40; ++i)
+    {
+        buildfile += std::string(i, ' ') + "a" + std::to_string(i) + std::string(i % 3, '\t') + "=\n\r\"" + std::string(i, 'x') + "\\\"ó" + std::string(i, 'y') + "\"";
+        buildfile += " // " + std::string(i, 'z') + "ź\n/* " + std::string(i, '*') + "\n" + std::string(2 * i, 'w') + "ż */";
+    }
+
+    auto expected = tokenize(buildfile, *get_scanner(scan_implementation::scalar));
+    MAYFLY_REQUIRE(expected.size() == 120);
+
+    for (auto implementation : supported_implementations())
+    {
+        auto tokens = tokenize(buildfile, *get_scanner(implementation));
+        MAYFLY_REQUIRE(tokens.size() == expected.size());
+
+        for (auto i = 0u; i < tokens.size(); ++i)
+        {
+            MAYFLY_CHECK(tokens[i].type == expected[i].type);
+            MAYFLY_CHECK(tokens[i].string == expected[i].string);
+            MAYFLY_CHECK(tokens[i].range.start().offset == expected[i].range.start().offset);
+            MAYFLY_CHECK(tokens[i].range.end().line == expected[i].range.end().line);
+            MAYFLY_CHECK(tokens[i].range.end().column == expected[i].range.end().column);
+
+            auto start = line_and_column(buildfile, tokens[i].range.start().offset);
+            MAYFLY_CHECK(tokens[i].range.start().line == start.first);
+            MAYFLY_CHECK(tokens[i].range.start().column == start.second);
+        }
+
+        MAYFLY_CHECK_THROWS_TYPE(unterminated_string, tokenize("a = \"" + std::string(100, 'x'), *get_scanner(implementation)));
+    }
+});
+
+MAYFLY_END_SUITE;
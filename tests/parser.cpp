@@ -20,259 +20,167 @@
  *
  **/
 
+#include <algorithm>
+
 #include <reaver/mayfly.h>
 
 #include "despayre/parser/parser.h"
 
 namespace
 {
-    auto parse(const std::u32string & string)
+    using namespace reaver::despayre;
+
+    std::string dump(const std::vector<token> & tokens, const expression & expr);
+
+    std::string dump(const std::vector<token> & tokens, const id_expression & expr)
+    {
+        std::string ret;
+        for (auto && identifier : expr.identifiers)
+        {
+            if (!ret.empty())
+            {
+                ret += '.';
+            }
+            ret += tokens[identifier.token].string.to_string();
+        }
+        return ret;
+    }
+
+    std::string dump(const std::vector<token> & tokens, const simple_expression & expr)
+    {
+        return reaver::get<0>(reaver::fmap(expr, reaver::make_overload_set(
+            [&](const string_node & str) {
+                return "\"" + tokens[str.token].string.to_string() + "\"";
+            },
+
+            [&](const id_expression & id) {
+                return dump(tokens, id);
+            },
+
+            [&](const instantiation & inst) {
+                std::string ret = dump(tokens, inst.type_name) + "(";
+                for (auto && arg : inst.arguments)
+                {
+                    if (&arg != &inst.arguments.front())
+                    {
+                        ret += ", ";
+                    }
+                    ret += dump(tokens, arg);
+                }
+                return ret + ")";
+            }
+        )));
+    }
+
+    std::string dump(const std::vector<token> & tokens, const expression & expr)
     {
-        return reaver::despayre::parse(reaver::despayre::tokenize(string, ""));
+        auto ret = dump(tokens, expr.base);
+        for (auto && op : expr.operations)
+        {
+            ret += op.operation == operation_type::addition ? " + " : " - ";
+            ret += dump(tokens, op.operand);
+        }
+        return ret;
     }
 
-    using parse_type = decltype(parse(U""));
+    // renders the parse tree back in a normalized form; one assignment per line
+    std::string dump(const std::string & string)
+    {
+        arena nodes;
+        auto tree = parse(tokenize(string), nodes);
+
+        std::string ret;
+        for (auto && assignment : tree.assignments)
+        {
+            ret += dump(tree.tokens, assignment.lhs) + " = " + dump(tree.tokens, assignment.rhs) + "\n";
+        }
+        return ret;
+    }
 }
 
 MAYFLY_BEGIN_SUITE("parser");
 
 MAYFLY_ADD_TESTCASE("empty input", []()
 {
-    MAYFLY_CHECK(parse(U"") == parse_type{});
+    MAYFLY_CHECK(dump("") == "");
 });
 
 MAYFLY_ADD_TESTCASE("assignments", []()
 {
-    using namespace reaver::despayre;
-
-    MAYFLY_CHECK(parse(UR"(a = b)") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{
-                {}, id_expression{ {}, { identifier{ {}, { token_type::identifier, U"b", {} } } } }, {}
-            }
-        }
-    });
-
-    MAYFLY_CHECK(parse(UR"(a = "b")") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{
-                {}, string_node{ {}, { token_type::string, U"b", {} } }, {}
-            }
-        }
-    });
-
-    MAYFLY_CHECK(parse(UR"(a.b.c = "b")") == parse_type{
-        assignment{ {},
-            id_expression{ {}, {
-                identifier{ {}, { token_type::identifier, U"a", {} } },
-                identifier{ {}, { token_type::identifier, U"b", {} } },
-                identifier{ {}, { token_type::identifier, U"c", {} } },
-            }},
-            expression{
-                {}, string_node{ {}, { token_type::string, U"b", {} } }, {}
-            }
-        }
-    });
-
-    MAYFLY_CHECK(parse(UR"(a.b.c = d.e)") == parse_type{
-        assignment{ {},
-            id_expression{ {}, {
-                identifier{ {}, { token_type::identifier, U"a", {} } },
-                identifier{ {}, { token_type::identifier, U"b", {} } },
-                identifier{ {}, { token_type::identifier, U"c", {} } },
-            }},
-            expression{
-                {}, id_expression{ {}, {
-                    identifier{ {}, { token_type::identifier, U"d", {} } },
-                    identifier{ {}, { token_type::identifier, U"e", {} } },
-                }}, {}
-            }
-        }
-    });
+    MAYFLY_CHECK(dump(R"(a = b)") == "a = b\n");
+    MAYFLY_CHECK(dump(R"(a = "b")") == "a = \"b\"\n");
+    MAYFLY_CHECK(dump(R"(a.b.c = "b")") == "a.b.c = \"b\"\n");
+    MAYFLY_CHECK(dump(R"(a.b.c = d.e)") == "a.b.c = d.e\n");
 });
 
 MAYFLY_ADD_TESTCASE("instantiations", []()
 {
-    using namespace reaver::despayre;
-
-    MAYFLY_CHECK(parse(UR"(a = b())") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{
-                {}, instantiation{ {},
-                    id_expression{ {}, { identifier{ {}, { token_type::identifier, U"b", {} } } } },
-                    {}
-                }, {}
-            }
-        }
-    });
-
-    MAYFLY_CHECK(parse(UR"(a = a.b())") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{
-                {}, instantiation{ {},
-                    id_expression{ {}, {
-                        identifier{ {}, { token_type::identifier, U"a", {} } },
-                        identifier{ {}, { token_type::identifier, U"b", {} } }
-                    }},
-                    {}
-                }, {}
-            }
-        }
-    });
-
-    MAYFLY_CHECK(parse(UR"(a = a("abc"))") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{
-                {}, instantiation{ {},
-                    id_expression{ {}, {
-                        identifier{ {}, { token_type::identifier, U"a", {} } }
-                    }},
-                    {
-                        expression{ {}, string_node{ {}, { token_type::string, UR"(abc)", {} } }, {} }
-                    }
-                }, {}
-            }
-        }
-    });
-
-    MAYFLY_CHECK(parse(UR"(a = a("abc", "def"))") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{
-                {}, instantiation{ {},
-                    id_expression{ {}, {
-                        identifier{ {}, { token_type::identifier, U"a", {} } }
-                    }},
-                    {
-                        expression{ {}, string_node{ {}, { token_type::string, UR"(abc)", {} } }, {} },
-                        expression{ {}, string_node{ {}, { token_type::string, UR"(def)", {} } }, {} }
-                    }
-                }, {}
-            }
-        }
-    });
-
-    MAYFLY_CHECK(parse(UR"(a = a(abc))") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{
-                {}, instantiation{ {},
-                    id_expression{ {}, {
-                        identifier{ {}, { token_type::identifier, U"a", {} } }
-                    }},
-                    {
-                        expression{ {}, id_expression{ {}, { identifier{ {}, { token_type::identifier, U"abc", {} } } } }, {} }
-                    }
-                }, {}
-            }
-        }
-    });
-
-    MAYFLY_CHECK(parse(UR"(a = a(abc, x(yz, "uv")))") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{
-                {}, instantiation{ {},
-                    id_expression{ {}, {
-                        identifier{ {}, { token_type::identifier, U"a", {} } }
-                    }},
-                    {
-                        expression{ {}, id_expression{ {}, { identifier{ {}, { token_type::identifier, U"abc", {} } } } }, {} },
-                        expression{
-                            {}, instantiation{ {},
-                                id_expression{ {}, {
-                                    identifier{ {}, { token_type::identifier, U"x", {} } }
-                                }},
-                                {
-                                    expression{ {}, id_expression{ {}, {
-                                        identifier{ {}, { token_type::identifier, U"yz", {} } }
-                                    }}, {} },
-                                    expression{ {}, string_node{ {}, { token_type::string, UR"(uv)", {} } }, {} }
-                                }
-                            }, {}
-                        }
-                    }
-                }, {}
-            }
-        }
-    });
+    MAYFLY_CHECK(dump(R"(a = b())") == "a = b()\n");
+    MAYFLY_CHECK(dump(R"(a = a.b())") == "a = a.b()\n");
+    MAYFLY_CHECK(dump(R"(a = a("abc"))") == "a = a(\"abc\")\n");
+    MAYFLY_CHECK(dump(R"(a = a("abc", "def"))") == "a = a(\"abc\", \"def\")\n");
+    MAYFLY_CHECK(dump(R"(a = a(abc))") == "a = a(abc)\n");
+    MAYFLY_CHECK(dump(R"(a = a(abc, x(yz, "uv")))") == "a = a(abc, x(yz, \"uv\"))\n");
+    MAYFLY_CHECK(dump(R"(a = a(b + c(d - e), f))") == "a = a(b + c(d - e), f)\n");
 });
 
 MAYFLY_ADD_TESTCASE("multiple assignments", []()
 {
-    using namespace reaver::despayre;
-
-    MAYFLY_CHECK(parse(UR"(a = b c = d)") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{ {}, id_expression{ {}, { identifier{ {}, { token_type::identifier, U"b", {} } } } }, {} }
-        },
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"c", {} } } } },
-            expression{ {}, id_expression{ {}, { identifier{ {}, { token_type::identifier, U"d", {} } } } }, {} }
-        }
-    });
+    MAYFLY_CHECK(dump(R"(a = b c = d)") == "a = b\nc = d\n");
 });
 
 MAYFLY_ADD_TESTCASE("complex expressions", []()
 {
-    using namespace reaver::despayre;
+    MAYFLY_CHECK(dump(R"(a = b + c)") == "a = b + c\n");
+    MAYFLY_CHECK(dump(R"(a = b - c)") == "a = b - c\n");
+    MAYFLY_CHECK(dump(R"(a = b + c + d)") == "a = b + c + d\n");
+    MAYFLY_CHECK(dump(R"(a = b + c - d)") == "a = b + c - d\n");
+});
 
-    MAYFLY_CHECK(parse(UR"(a = b + c)") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{ {},
-                id_expression{ {}, { identifier{ {}, { token_type::identifier, U"b", {} } } } },
-                {
-                    operation{ {}, operation_type::addition, { id_expression{ {}, { identifier{ {}, { token_type::identifier, U"c", {} } } } } } }
-                }
-            }
-        }
-    });
+MAYFLY_ADD_TESTCASE("ranges", []()
+{
+    std::string source = "a.b = c(\"d\") + e";
+    arena nodes;
+    auto tree = parse(tokenize(source), nodes);
+
+    MAYFLY_REQUIRE(tree.assignments.size() == 1);
+    auto & assignment = tree.assignments.front();
+    MAYFLY_CHECK(assignment.range.start().offset == 0);
+    MAYFLY_CHECK(assignment.range.end().offset == source.size());
+    MAYFLY_CHECK(assignment.lhs.range.end().offset == 3);
+    MAYFLY_CHECK(assignment.rhs.operations.size() == 1);
+    MAYFLY_CHECK(assignment.rhs.operations.front().range.start().offset == 13);
+});
 
-    MAYFLY_CHECK(parse(UR"(a = b - c)") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{ {},
-                id_expression{ {}, { identifier{ {}, { token_type::identifier, U"b", {} } } } },
-                {
-                    operation{ {}, operation_type::removal, { id_expression{ {}, { identifier{ {}, { token_type::identifier, U"c", {} } } } } } }
-                }
-            }
-        }
-    });
+MAYFLY_ADD_TESTCASE("arena reuse", []()
+{
+    arena nodes;
+    parse(tokenize("a = b(c, d) + e(f)"), nodes);
+    auto capacity = nodes.capacity();
+    MAYFLY_CHECK(capacity != 0);
+
+    nodes.reset();
+    parse(tokenize("a = b(c, d) + e(f)"), nodes);
+    MAYFLY_CHECK(nodes.capacity() == capacity);
+});
 
-    MAYFLY_CHECK(parse(UR"(a = b + c + d)") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{ {},
-                id_expression{ {}, { identifier{ {}, { token_type::identifier, U"b", {} } } } },
-                {
-                    operation{ {}, operation_type::addition, { id_expression{ {}, { identifier{ {}, { token_type::identifier, U"c", {} } } } } } },
-                    operation{ {}, operation_type::addition, { id_expression{ {}, { identifier{ {}, { token_type::identifier, U"d", {} } } } } } }
-                }
-            }
-        }
+MAYFLY_ADD_TESTCASE("streaming", []()
+{
+    std::string source = "a = b(c, d) + e(f) g.h = \"i\" - j k = l";
+    arena nodes;
+
+    std::string dumped;
+    std::size_t largest_window = 0;
+    parse(token_stream{ source }, nodes, [&](const std::vector<token> & tokens, const assignment & assignment) {
+        dumped += dump(tokens, assignment.lhs) + " = " + dump(tokens, assignment.rhs) + "\n";
+        largest_window = std::max(largest_window, tokens.size());
     });
 
-    MAYFLY_CHECK(parse(UR"(a = b + c - d)") == parse_type{
-        assignment{ {},
-            id_expression{ {}, { identifier{ {}, { token_type::identifier, U"a", {} } } } },
-            expression{ {},
-                id_expression{ {}, { identifier{ {}, { token_type::identifier, U"b", {} } } } },
-                {
-                    operation{ {}, operation_type::addition, { id_expression{ {}, { identifier{ {}, { token_type::identifier, U"c", {} } } } } } },
-                    operation{ {}, operation_type::removal, { id_expression{ {}, { identifier{ {}, { token_type::identifier, U"d", {} } } } } } }
-                }
-            }
-        }
-    });
+    MAYFLY_CHECK(dumped == dump(source));
+    // the tokens of the longest assignment, and a single token of lookahead
+    MAYFLY_CHECK(largest_window == 14);
+
+    MAYFLY_CHECK_THROWS_TYPE(reaver::despayre::expectation_failure, parse(token_stream{ "a = b c" }, nodes, [](auto &&, auto &&) {}));
 });
 
 MAYFLY_END_SUITE;
-
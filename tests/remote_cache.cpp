@@ -0,0 +1,121 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <thread>
+
+#include <reaver/mayfly.h>
+
+#include "despayre/runtime/cache_server.h"
+#include "despayre/runtime/hash.h"
+
+#include "helpers.h"
+
+namespace
+{
+    struct server_fixture
+    {
+        server_fixture() : server{ directory.path / "socket", directory.path / "storage" },
+            thread{ [&]{ server.run(); } }
+        {
+        }
+
+        ~server_fixture()
+        {
+            server.stop();
+            thread.join();
+        }
+
+        temporary_directory directory;
+        reaver::despayre::cache_server server;
+        std::thread thread;
+    };
+
+    reaver::despayre::action_result result(std::uint64_t input_hash, std::uint64_t output_hash)
+    {
+        reaver::despayre::action_result ret;
+        ret.inputs.push_back({ "header.h", input_hash });
+        ret.outputs.push_back({ "output/source.cpp.o", output_hash, 0644 });
+        return ret;
+    }
+}
+
+MAYFLY_BEGIN_SUITE("remote cache");
+
+MAYFLY_ADD_TESTCASE("blobs", []()
+{
+    using namespace reaver::despayre;
+
+    server_fixture fixture;
+    unix_socket_cache cache{ fixture.directory.path / "socket" };
+
+    std::string contents = "some object file";
+    auto hash = hash_bytes(contents.data(), contents.size());
+
+    MAYFLY_CHECK(!cache.get_blob(hash));
+
+    cache.put_blob(hash, contents);
+    auto blob = cache.get_blob(hash);
+    MAYFLY_REQUIRE(blob);
+    MAYFLY_CHECK(*blob == contents);
+
+    MAYFLY_CHECK_THROWS_TYPE(protocol_error, cache.put_blob(hash + 1, contents));
+    MAYFLY_CHECK(!cache.get_blob(hash + 1));
+});
+
+MAYFLY_ADD_TESTCASE("actions", []()
+{
+    using namespace reaver::despayre;
+
+    server_fixture fixture;
+    unix_socket_cache cache{ fixture.directory.path / "socket" };
+
+    std::string contents = "some object file";
+    auto hash = hash_bytes(contents.data(), contents.size());
+
+    MAYFLY_CHECK(cache.get_action(1).empty());
+
+    // results must not refer to blobs the server doesn't have
+    MAYFLY_CHECK_THROWS_TYPE(protocol_error, cache.put_action(1, result(2, hash)));
+
+    cache.put_blob(hash, contents);
+    cache.put_action(1, result(2, hash));
+    cache.put_action(1, result(3, hash));
+
+    auto results = cache.get_action(1);
+    MAYFLY_REQUIRE(results.size() == 2);
+    MAYFLY_CHECK(results[0].inputs.front().hash == 3);
+    MAYFLY_CHECK(results[1].inputs.front().hash == 2);
+    MAYFLY_CHECK(results[0].outputs.front().path == "output/source.cpp.o");
+    MAYFLY_CHECK(results[0].outputs.front().hash == hash);
+    MAYFLY_CHECK(results[0].outputs.front().mode == 0644);
+
+    // a result with the same inputs replaces the old one
+    cache.put_action(1, result(2, hash));
+    results = cache.get_action(1);
+    MAYFLY_REQUIRE(results.size() == 2);
+    MAYFLY_CHECK(results[0].inputs.front().hash == 2);
+    MAYFLY_CHECK(results[1].inputs.front().hash == 3);
+
+    MAYFLY_CHECK(cache.get_action(2).empty());
+});
+
+MAYFLY_END_SUITE;
@@ -0,0 +1,138 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <thread>
+
+#include <reaver/mayfly.h>
+
+#include "despayre/runtime/worker_server.h"
+
+#include "helpers.h"
+
+namespace
+{
+    struct worker_fixture
+    {
+        worker_fixture() : endpoint{ (directory.path / "socket").string() },
+            server{ endpoint, 2, "sh" },
+            thread{ [&]{ server.run(); } }
+        {
+        }
+
+        ~worker_fixture()
+        {
+            server.stop();
+            thread.join();
+        }
+
+        temporary_directory directory;
+        std::string endpoint;
+        reaver::despayre::worker_server server;
+        std::thread thread;
+    };
+
+    // the worker appends `-o <object> <source>` to the arguments; the fixture's worker only runs sh
+    reaver::despayre::remote_action action(std::string script)
+    {
+        reaver::despayre::remote_action ret;
+        ret.arguments = { "sh", "-c", script, "sh" };
+        ret.source_extension = ".ii";
+        ret.source = "int main() {}\n";
+        return ret;
+    }
+}
+
+MAYFLY_BEGIN_SUITE("remote execution");
+
+MAYFLY_ADD_TESTCASE("actions", []()
+{
+    using namespace reaver::despayre;
+
+    worker_fixture fixture;
+    remote_executor executor{ { fixture.endpoint } };
+
+    auto result = executor.execute(action(R"(cat "$3" > "$2"; echo warning)"));
+    MAYFLY_CHECK(result.exit_code == 0);
+    MAYFLY_CHECK(result.object == "int main() {}\n");
+    MAYFLY_CHECK(result.diagnostics == "warning\n");
+
+    result = executor.execute(action(R"(echo error; exit 3)"));
+    MAYFLY_CHECK(result.exit_code == 3);
+    MAYFLY_CHECK(result.object.empty());
+    MAYFLY_CHECK(result.diagnostics == "error\n");
+});
+
+MAYFLY_ADD_TESTCASE("refused actions", []()
+{
+    using namespace reaver::despayre;
+
+    // a refused action fails the worker, like any other error would
+    auto refused = [](remote_action action) {
+        worker_fixture fixture;
+        remote_executor executor{ { fixture.endpoint } };
+        try
+        {
+            executor.execute(action);
+        }
+        catch (protocol_error &)
+        {
+            return true;
+        }
+        return false;
+    };
+
+    auto other_program = action(R"(cat "$3" > "$2")");
+    other_program.arguments.front() = "bash";
+    MAYFLY_CHECK(refused(other_program));
+
+    auto plugin = action(R"(cat "$3" > "$2")");
+    plugin.arguments.push_back("-fplugin=evil.so");
+    MAYFLY_CHECK(refused(plugin));
+
+    auto escaping = action(R"(cat "$3" > "$2")");
+    escaping.source_extension = "/../../escaped.ii";
+    MAYFLY_CHECK(refused(escaping));
+
+    auto encoded = encode(action("true"));
+    message_reader reader{ encoded };
+    MAYFLY_CHECK(reader.get<execution_operation>() == execution_operation::execute);
+    MAYFLY_CHECK(decode_remote_action(reader).arguments == (std::vector<std::string>{ "sh", "-c", "true", "sh" }));
+});
+
+MAYFLY_ADD_TESTCASE("failing workers", []()
+{
+    using namespace reaver::despayre;
+
+    worker_fixture fixture;
+    auto missing = (fixture.directory.path / "missing").string();
+
+    remote_executor executor{ { missing, fixture.endpoint } };
+    for (auto i = 0; i < 3; ++i)
+    {
+        MAYFLY_CHECK(executor.execute(action(R"(cat "$3" > "$2")")).object == "int main() {}\n");
+    }
+
+    remote_executor unavailable{ { missing } };
+    MAYFLY_CHECK_THROWS_TYPE(protocol_error, unavailable.execute(action(R"(cat "$3" > "$2")")));
+});
+
+MAYFLY_END_SUITE;
@@ -0,0 +1,142 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <reaver/mayfly.h>
+
+#include "despayre/semantics/semantics.h"
+#include "despayre/semantics/string.h"
+
+namespace
+{
+    std::u32string value_of(const reaver::despayre::semantic_context & ctx, std::u32string name)
+    {
+        return ctx.variables->get_property(name)->as<reaver::despayre::string>()->value();
+    }
+}
+
+MAYFLY_BEGIN_SUITE("semantics");
+
+MAYFLY_ADD_TESTCASE("forward references", []()
+{
+    using namespace reaver::despayre;
+
+    auto ctx = analyze(token_stream{ R"(
+a = b + c
+b = d
+c = "!"
+d = e.f
+e.f = "hi"
+)" });
+
+    MAYFLY_CHECK(ctx.unresolved.empty());
+    MAYFLY_CHECK(value_of(ctx, U"a") == U"hi!");
+    MAYFLY_CHECK(value_of(ctx, U"b") == U"hi");
+});
+
+MAYFLY_ADD_TESTCASE("long chains", []()
+{
+    using namespace reaver::despayre;
+
+    // every variable refers to the one defined after it
+    std::string buildfile;
+    for (auto i = 0; i < 20000; ++i)
+    {
+        buildfile += "v" + std::to_string(i) + " = v" + std::to_string(i + 1) + " + \"\"\n";
+    }
+    buildfile += "v20000 = \"end\"\n";
+
+    auto ctx = analyze(token_stream{ buildfile });
+    MAYFLY_CHECK(value_of(ctx, U"v0") == U"end");
+});
+
+MAYFLY_ADD_TESTCASE("operators", []()
+{
+    using namespace reaver::despayre;
+
+    // the operands keep their order when the left one isn't resolved yet
+    auto ctx = analyze(token_stream{ R"(
+a = b + "!"
+b = "hi"
+c = "hi" + d
+d = "!"
+)" });
+
+    MAYFLY_CHECK(value_of(ctx, U"a") == U"hi!");
+    MAYFLY_CHECK(value_of(ctx, U"c") == U"hi!");
+
+    auto lhs = std::make_shared<string>(U"a");
+    auto sum = *lhs + std::make_shared<string>(U"b");
+    MAYFLY_CHECK(sum->as<string>()->value() == U"ab");
+    MAYFLY_CHECK(find_operator(operation_type::removal, get_type_identifier<string>(), get_type_identifier<string>()) == nullptr);
+});
+
+MAYFLY_ADD_TESTCASE("unresolved names", []()
+{
+    using namespace reaver::despayre;
+
+    MAYFLY_CHECK_THROWS_TYPE(reaver::exception, analyze(token_stream{ "a = b + c" }));
+    MAYFLY_CHECK_THROWS_TYPE(reaver::exception, analyze(token_stream{ "a = b b = a" }));
+    MAYFLY_CHECK_THROWS_TYPE(reaver::exception, analyze(token_stream{ "a = b + \"\" b = c c = a" }));
+});
+
+MAYFLY_ADD_TESTCASE("lazy evaluation", []()
+{
+    using namespace reaver::despayre;
+
+    auto buildfile = R"(
+a = b + c
+b = d
+c = "!"
+d = e.f
+e.f = "hi"
+broken = missing + "?"
+sources = glob("tests/**/*.cpp")
+)";
+
+    // nothing is analyzed until it's forced, so neither the broken variable nor the glob get in the way
+    auto ctx = analyze(token_stream{ buildfile }, evaluation::lazy);
+    MAYFLY_CHECK(ctx.globbed_directories->empty());
+
+    auto a = ctx.variables->get_property(U"a");
+    force(ctx, a);
+    MAYFLY_CHECK(a->as<string>()->value() == U"hi!");
+    MAYFLY_CHECK(value_of(ctx, U"b") == U"hi");
+    MAYFLY_CHECK(ctx.globbed_directories->empty());
+
+    MAYFLY_CHECK_THROWS_TYPE(reaver::exception, force(ctx, ctx.variables->get_property(U"broken")));
+
+    auto cycle = analyze(token_stream{ "a = b b = a" }, evaluation::lazy);
+    MAYFLY_CHECK_THROWS_TYPE(reaver::exception, force(cycle, cycle.variables->get_property(U"a")));
+
+    std::string chain;
+    for (auto i = 0; i < 20000; ++i)
+    {
+        chain += "v" + std::to_string(i) + " = v" + std::to_string(i + 1) + "\n";
+    }
+    chain += "v20000 = \"end\"\n";
+
+    auto long_chain = analyze(token_stream{ chain }, evaluation::lazy);
+    force(long_chain, long_chain.variables->get_property(U"v0"));
+    MAYFLY_CHECK(value_of(long_chain, U"v0") == U"end");
+});
+
+MAYFLY_END_SUITE;
@@ -0,0 +1,118 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <reaver/mayfly.h>
+
+#include "despayre/despayre.h"
+#include "despayre/runtime/files.h"
+#include "despayre/semantics/basic.h"
+
+#include "helpers.h"
+
+namespace
+{
+    const std::string buildfile = R"(
+greeting.text = "hello"
+sources = glob("src/*.cpp") - files("src/skipped.cpp")
+hello = debug_print(greeting.text)
+all = aggregate(hello, sources)
+)";
+
+    std::uint64_t hash(const std::string & str)
+    {
+        return reaver::despayre::hash_bytes(str.data(), str.size());
+    }
+}
+
+MAYFLY_BEGIN_SUITE("snapshot");
+
+MAYFLY_ADD_TESTCASE("round trip", []()
+{
+    using namespace reaver::despayre;
+
+    workspace ws;
+    ws.write("buildfile", buildfile);
+    ws.write("src/a.cpp", "");
+    ws.write("src/skipped.cpp", "");
+
+    despayre::load("buildfile", "output/.despayre_graph");
+    MAYFLY_REQUIRE(boost::filesystem::exists("output/.despayre_graph"));
+
+    auto loaded = load_snapshot("output/.despayre_graph", hash(buildfile));
+    MAYFLY_REQUIRE(loaded);
+
+    auto greeting = loaded->variables->get_property(U"greeting");
+    MAYFLY_REQUIRE(greeting);
+    MAYFLY_CHECK(greeting->get_property(U"text")->as<string>()->value() == U"hello");
+
+    auto sources = loaded->variables->get_property(U"sources")->as<files>();
+    MAYFLY_CHECK(sources->paths() == std::vector<boost::filesystem::path>{ "src/a.cpp" });
+
+    MAYFLY_REQUIRE(loaded->targets.count(intern("all")));
+    auto all = loaded->targets.at(intern("all"));
+    MAYFLY_REQUIRE(all->dependencies(nullptr).size() == 2);
+    // shared variables stay shared
+    MAYFLY_CHECK(all->dependencies(nullptr)[1] == sources);
+    MAYFLY_CHECK(loaded->targets.at(intern("hello")) == all->dependencies(nullptr)[0]);
+
+    // the builtins are there again
+    MAYFLY_CHECK(loaded->variables->get_property(U"glob"));
+});
+
+MAYFLY_ADD_TESTCASE("invalidation", []()
+{
+    using namespace reaver::despayre;
+
+    workspace ws;
+    ws.write("buildfile", buildfile);
+    ws.write("src/a.cpp", "");
+
+    despayre::load("buildfile", "output/.despayre_graph");
+    MAYFLY_CHECK(load_snapshot("output/.despayre_graph", hash(buildfile)));
+    MAYFLY_CHECK(!load_snapshot("output/.despayre_graph", hash(buildfile + " ")));
+
+    // a new file may change what the glob matches
+    ws.write("src/b.cpp", "");
+    set_last_write_time("src", current_file_time() + 1000000000);
+    MAYFLY_CHECK(!load_snapshot("output/.despayre_graph", hash(buildfile)));
+});
+
+MAYFLY_ADD_TESTCASE("builds outliving their graph", []()
+{
+    using namespace reaver::despayre;
+
+    workspace ws;
+    ws.write("buildfile", buildfile);
+
+    // the graph, and with it the last reference to the contexts of both builds, is gone before they are waited for
+    auto builds = []{
+        auto graph = despayre::load("buildfile", "output/.despayre_graph");
+        auto first = graph.build("hello", "output");
+        auto second = graph.build("hello", "output");
+        return std::make_pair(first, second);
+    }();
+
+    wait(builds.first);
+    wait(builds.second);
+});
+
+MAYFLY_END_SUITE;
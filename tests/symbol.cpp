@@ -0,0 +1,81 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <string>
+
+#include <reaver/mayfly.h>
+
+#include "despayre/parser/symbol.h"
+#include "despayre/semantics/symbol_map.h"
+
+MAYFLY_BEGIN_SUITE("symbols");
+
+MAYFLY_ADD_TESTCASE("interning", []()
+{
+    using namespace reaver::despayre;
+
+    auto flags = intern("flags");
+    MAYFLY_CHECK(intern("flags") == flags);
+    MAYFLY_CHECK(intern(U"flags") == flags);
+    MAYFLY_CHECK(intern("ldflags") != flags);
+    MAYFLY_CHECK(flags.string() == "flags");
+
+    MAYFLY_CHECK(intern("") == symbol{});
+    MAYFLY_CHECK(symbol{}.string().empty());
+
+    MAYFLY_CHECK(intern(U"żółw").string() == "żółw");
+});
+
+MAYFLY_ADD_TESTCASE("symbol maps", []()
+{
+    using namespace reaver::despayre;
+
+    symbol_map<int> map;
+    MAYFLY_CHECK(map.find(intern("a")) == nullptr);
+
+    // enough to go through a few rehashes
+    for (auto i = 0; i < 1000; ++i)
+    {
+        MAYFLY_CHECK(map.emplace(intern("member_" + std::to_string(i)), i));
+    }
+
+    MAYFLY_CHECK(!map.emplace(intern("member_10"), -1));
+    MAYFLY_CHECK(map.size() == 1000);
+
+    auto ok = true;
+    for (auto i = 0; i < 1000; ++i)
+    {
+        auto found = map.find(intern("member_" + std::to_string(i)));
+        ok = ok && found && *found == i;
+    }
+    MAYFLY_CHECK(ok);
+    MAYFLY_CHECK(map.find(intern("member_1000")) == nullptr);
+
+    auto expected = 0;
+    for (auto && entry : map)
+    {
+        ok = ok && entry.second == expected++;
+    }
+    MAYFLY_CHECK(ok);
+});
+
+MAYFLY_END_SUITE;
@@ -0,0 +1,64 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <csignal>
+#include <thread>
+
+#include <pthread.h>
+
+#include <reaver/logger.h>
+
+#include "despayre/runtime/cache_server.h"
+
+int main(int argc, char ** argv) try
+{
+    if (argc != 3)
+    {
+        throw reaver::exception{ reaver::logger::fatal } << "usage: " << argv[0] << " <socket> <storage directory>";
+    }
+
+    // blocked in every thread, so that they are only ever received by the sigwait below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    reaver::despayre::cache_server server{ argv[1], argv[2] };
+    std::thread serve{ [&]{ server.run(); } };
+
+    int signal;
+    sigwait(&signals, &signal);
+
+    server.stop();
+    serve.join();
+}
+catch (reaver::exception & ex)
+{
+    ex.print(reaver::logger::default_logger());
+    return 2;
+}
+catch (std::exception & ex)
+{
+    reaver::logger::dlog(reaver::logger::fatal) << ex.what();
+    return 1;
+}
@@ -0,0 +1,113 @@
+/**
+ * Despayre License
+ *
+ * Copyright © 2016 Michał "Griwes" Dominiak
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation is required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ **/
+
+#include <csignal>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+
+#include <reaver/logger.h>
+
+#include "despayre/runtime/scheduler.h"
+#include "despayre/runtime/worker_server.h"
+
+int main(int argc, char ** argv) try
+{
+    std::size_t jobs = reaver::despayre::default_job_count();
+    std::string endpoint;
+    // the only program the worker runs; clients have to name it the same way (their CXX)
+    auto cxx = std::getenv("CXX");
+    std::string compiler = cxx && *cxx ? cxx : "c++";
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg.compare(0, 2, "-j") == 0)
+        {
+            if (arg.size() == 2)
+            {
+                if (++i == argc)
+                {
+                    throw reaver::exception{ reaver::logger::fatal } << "`-j` requires a job count.";
+                }
+                arg += argv[i];
+            }
+
+            jobs = std::stoull(arg.substr(2));
+            continue;
+        }
+
+        if (arg == "--compiler")
+        {
+            if (++i == argc)
+            {
+                throw reaver::exception{ reaver::logger::fatal } << "`--compiler` requires a command.";
+            }
+
+            compiler = argv[i];
+            continue;
+        }
+
+        if (!endpoint.empty())
+        {
+            endpoint.clear();
+            break;
+        }
+
+        endpoint = std::move(arg);
+    }
+
+    if (endpoint.empty())
+    {
+        throw reaver::exception{ reaver::logger::fatal } << "usage: " << argv[0] << " [-j <jobs>] [--compiler <command>] <unix socket path | unix:<path> | tcp:[<host>]:<port>>\n"
+            << "anyone who can connect to the endpoint can use the compiler; tcp endpoints without a host only listen on the loopback interface";
+    }
+
+    // blocked in every thread, so that they are only ever received by the sigwait below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    reaver::despayre::worker_server server{ endpoint, jobs, compiler };
+    std::thread serve{ [&]{ server.run(); } };
+
+    int signal;
+    sigwait(&signals, &signal);
+
+    server.stop();
+    serve.join();
+}
+catch (reaver::exception & ex)
+{
+    ex.print(reaver::logger::default_logger());
+    return 2;
+}
+catch (std::exception & ex)
+{
+    reaver::logger::dlog(reaver::logger::fatal) << ex.what();
+    return 1;
+}